@@ -0,0 +1,77 @@
+#version 430 core
+
+#include "frameData.glsl"
+
+// Same blade shape as grassBlade.vert, but everything that used to come in
+// per object (the model matrix, bend and noise uniforms) now comes from the
+// tile's instance buffer instead, so a whole tile is one draw call.
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec4 colour;
+layout(location = 2) in vec2 texCoord;
+layout(location = 3) in vec3 normal;
+
+// per instance - xyz = world position, w = yaw (radians)
+layout(location = 8) in vec4 bladeTransform;
+// per instance
+layout(location = 9) in float bladeBend;
+// per instance, from a buffer of its own, as it's the only thing the wind changes each frame
+layout(location = 11) in float bladeNoise;
+
+uniform vec4 		objectColour = vec4(1,1,1,1);
+
+uniform bool hasVertexColours = false;
+
+uniform float maxHeight = -1;
+
+out Vertex
+{
+	vec4 colour;
+	vec2 texCoord;
+	vec4 shadowProj;
+	vec3 normal;
+	vec3 worldPos;
+} OUT;
+
+vec3 BendBladeVertex(vec3 pos, float bendAmount, float maxHeight) {
+    // How far up the blade this vertex is
+    float heightFactor = clamp(pos.y / maxHeight, 0.0, 1.0);
+
+    // Compute a smooth parabolic bend amount based only on height
+    float zBend = bendAmount * heightFactor * heightFactor;
+
+    // Output position: same X and Y, new Z
+    return vec3(pos.x, pos.y, zBend);
+}
+
+vec3 RotateY(vec3 v, float c, float s) {
+	return vec3(c * v.x + s * v.z, v.y, -s * v.x + c * v.z);
+}
+
+void main(void)
+{
+	float c = cos(bladeTransform.w);
+	float s = sin(bladeTransform.w);
+
+	float bendAmount = bladeBend;
+
+	vec3 bentPosition = BendBladeVertex(position, bendAmount, maxHeight);
+
+	float h = clamp(position.y/maxHeight, 0.0, 1.0);
+	// dz/dy = 2 * bendAmount * h / maxHeight
+	float slope = 2.0 * bendAmount * h / maxHeight;
+	vec3 bentNormal = normalize(vec3(0.0, -slope, 1.0));
+
+	OUT.worldPos	= RotateY(bentPosition, c, s) + bladeTransform.xyz;
+	OUT.normal		= RotateY(bentNormal, c, s);
+	OUT.shadowProj	= vec4(0.0); // no shadow map lookup, as with the compute path
+	OUT.texCoord	= texCoord;
+
+	OUT.colour		= objectColour;
+	if(hasVertexColours) {
+		OUT.colour		= objectColour * colour;
+	}
+	OUT.colour.x = bladeNoise;
+
+	gl_Position = projMatrix * viewMatrix * vec4(OUT.worldPos, 1.0);
+}
@@ -0,0 +1,12 @@
+// Everything that's the same for every draw in a frame, filled in once per frame by
+// GameTechRenderer (see FrameUniforms) rather than set on every shader that wants it
+layout(std140) uniform FrameData {
+	mat4	viewMatrix;
+	mat4	projMatrix;
+	vec3	cameraPos;
+	vec3	lightPos;
+	float	lightRadius;
+	vec4	lightColour;
+	vec3	windDir;	// x and z direction, then speed
+	float	deltaTime;
+};
@@ -1,26 +1,15 @@
 #version 400 core
 
+#include "frameData.glsl"
+
 uniform vec4 		objectColour;
 uniform sampler2D 	mainTex;
 uniform sampler2DShadow shadowTex;
 
-uniform vec3	lightPos;
-uniform float	lightRadius;
-uniform vec4	lightColour;
-
-uniform vec3	cameraPos;
-
 uniform bool hasTexture;
 
-uniform float windDirX;
-uniform float windDirZ;
-
-uniform vec3 windDir;
-
 uniform bool useWindNoise;
 
-uniform float deltaTime;
-
 in Vertex
 {
 	vec4 colour;
@@ -1,13 +1,8 @@
 #version 430 core
 
-struct BladeIndex {
-    float distance;
-    uint index;
-};
+#include "frameData.glsl"
 
 uniform mat4 modelMatrix 	= mat4(1.0f);
-uniform mat4 viewMatrix 	= mat4(1.0f);
-uniform mat4 projMatrix 	= mat4(1.0f);
 uniform mat4 shadowMatrix 	= mat4(1.0f);
 
 layout(location = 0) in vec3 position;
@@ -15,6 +10,9 @@ layout(location = 1) in vec4 colour;
 layout(location = 2) in vec2 texCoord;
 layout(location = 3) in vec3 normal;
 
+// which blade this instance is, straight out of the sorted indices bladeCull.comp left behind
+layout(location = 10) in uint bladeIndex;
+
 layout(std430, binding = 0) buffer Positions {
 	vec4 positions[];
 };
@@ -27,10 +25,6 @@ layout(std430, binding = 2) buffer UV {
 	vec2 uvs[];
 };
 
-layout (std430, binding = 4) readonly buffer Sorted {
-	BladeIndex sorted[];
-};
-
 uniform vec4 		objectColour = vec4(1,1,1,1);
 
 uniform bool hasVertexColours = false;
@@ -39,14 +33,8 @@ uniform float maxHeight;
 
 uniform sampler2D perlinWindTex;
 
-uniform vec3 windDir;
-
 uniform bool useWindNoise;
 
-uniform float deltaTime;
-
-uniform bool useFront2Back;
-
 out Vertex
 {
 	vec4 colour;
@@ -100,11 +88,7 @@ vec3 BezierBladeBend(vec3 P0, vec3 P1, vec3 P2, float t){
 
 void main(void)
 {
-	// Get the instance index
-	uint sortedIdx = uint(gl_InstanceID);
-	uint bladeID = gl_InstanceID.x;
-	if (useFront2Back)
-		bladeID = sorted[sortedIdx].index;
+	uint bladeID = bladeIndex;
 
 	mat4 mvp 		  = (projMatrix * viewMatrix * modelMatrix);
 	mat3 normalMatrix = transpose ( inverse ( mat3 ( modelMatrix )));
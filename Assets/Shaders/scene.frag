@@ -1,15 +1,11 @@
 #version 400 core
 
+#include "frameData.glsl"
+
 uniform vec4 		objectColour;
 uniform sampler2D 	mainTex;
 uniform sampler2DShadow shadowTex;
 
-uniform vec3	lightPos;
-uniform float	lightRadius;
-uniform vec4	lightColour;
-
-uniform vec3	cameraPos;
-
 uniform bool hasTexture;
 
 in Vertex
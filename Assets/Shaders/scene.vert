@@ -1,8 +1,8 @@
-#version 400 core
+#version 430 core
+
+#include "frameData.glsl"
 
 uniform mat4 modelMatrix 	= mat4(1.0f);
-uniform mat4 viewMatrix 	= mat4(1.0f);
-uniform mat4 projMatrix 	= mat4(1.0f);
 uniform mat4 shadowMatrix 	= mat4(1.0f);
 
 layout(location = 0) in vec3 position;
@@ -14,6 +14,19 @@ uniform vec4 		objectColour = vec4(1,1,1,1);
 
 uniform bool hasVertexColours = false;
 
+struct InstanceData {
+	mat4 modelMatrix;
+	vec4 colour;
+};
+
+// every object in the scene, in the order GameTechRenderer sorted them into
+layout(std430, binding = 8) buffer Instances {
+	InstanceData instances[];
+};
+
+// where this draw's run of objects starts in instances, or -1 to use the per object uniforms
+uniform int instanceOffset = -1;
+
 out Vertex
 {
 	vec4 colour;
@@ -25,18 +38,29 @@ out Vertex
 
 void main(void)
 {
-	mat4 mvp 		  = (projMatrix * viewMatrix * modelMatrix);
-	mat3 normalMatrix = transpose ( inverse ( mat3 ( modelMatrix )));
+	mat4 model		= modelMatrix;
+	mat4 shadowMat	= shadowMatrix;
+	vec4 objColour	= objectColour;
+
+	if (instanceOffset >= 0) {
+		InstanceData instance = instances[instanceOffset + gl_InstanceID];
+		model		= instance.modelMatrix;
+		shadowMat	= shadowMatrix * model; // instanced draws only get the light's matrix
+		objColour	= instance.colour;
+	}
+
+	mat4 mvp 		  = (projMatrix * viewMatrix * model);
+	mat3 normalMatrix = transpose ( inverse ( mat3 ( model )));
 
-	OUT.shadowProj 	=  shadowMatrix * vec4 ( position,1);
-	OUT.worldPos 	= ( modelMatrix * vec4 ( position ,1)). xyz ;
+	OUT.shadowProj 	=  shadowMat * vec4 ( position,1);
+	OUT.worldPos 	= ( model * vec4 ( position ,1)). xyz ;
 	OUT.normal 		= normalize ( normalMatrix * normalize ( normal ));
 	
 	OUT.texCoord	= texCoord;
-	OUT.colour		= objectColour;
+	OUT.colour		= objColour;
 
 	if(hasVertexColours) {
-		OUT.colour		= objectColour * colour;
+		OUT.colour		= objColour * colour;
 	}
 	gl_Position		= mvp * vec4(position, 1.0);
 }
\ No newline at end of file
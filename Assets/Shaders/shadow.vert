@@ -1,6 +1,20 @@
-#version 400 core
+#version 430 core
 
 uniform mat4 mvpMatrix 		= mat4(1.0f);
+uniform mat4 viewProjMatrix	= mat4(1.0f);
+
+struct InstanceData {
+	mat4 modelMatrix;
+	vec4 colour;
+};
+
+// the same buffer scene.vert reads from
+layout(std430, binding = 8) buffer Instances {
+	InstanceData instances[];
+};
+
+// where this draw's run of objects starts in instances, or -1 to just use mvpMatrix
+uniform int instanceOffset = -1;
 
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec4 colour;
@@ -8,5 +22,10 @@ layout(location = 2) in vec2 texCoord;
 
 void main(void)
 {
-	gl_Position		= mvpMatrix * vec4(position, 1.0);
+	if (instanceOffset >= 0) {
+		gl_Position	= viewProjMatrix * instances[instanceOffset + gl_InstanceID].modelMatrix * vec4(position, 1.0);
+	}
+	else {
+		gl_Position	= mvpMatrix * vec4(position, 1.0);
+	}
 }
\ No newline at end of file
@@ -1,8 +1,8 @@
 #version 330 core
 
+#include "frameData.glsl"
+
 uniform mat4 modelMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projMatrix;
 
 in  vec3 position;
 
@@ -0,0 +1,221 @@
+/*
+Micro-benchmark for the batched collision tests.
+
+Builds a set of random sphere/sphere, AABB/AABB and AABB/sphere pairs from a
+fixed seed, and times testing all of them through:
+
+	perPair		- CollisionDetection::ObjectIntersection, one pair at a time
+	scalar		- ObjectPairBatch, using the scalar batch tests
+	simd		- ObjectPairBatch, using the SSE / AVX2 batch tests
+
+The batched timings include sorting the pairs into the batch and reading the
+contacts back out, as the narrowphase has to do both. The kernel timings are
+just the tests themselves. Every batched contact is also checked against the
+per-pair one, and any that differ are counted as mismatches.
+
+Usage:
+	CollisionKernelBenchmark [--pairs N] [--repeats N] [--seed N] [--out file.json]
+*/
+#include <iostream>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstring>
+
+#include "GameObject.h"
+#include "CollisionDetection.h"
+#include "BatchCollision.h"
+#include "GameTimer.h"
+
+using namespace NCL;
+using namespace CSC8503;
+
+struct KernelSettings {
+	int			pairCount	= 100000;
+	int			repeats		= 20;
+	uint32_t	seed		= 8498;
+	std::string	outFile;
+};
+
+struct KernelTimings {
+	double perPairMS		= 0.0;
+	double scalarMS			= 0.0;
+	double simdMS			= 0.0;
+	double scalarKernelMS	= 0.0;
+	double simdKernelMS		= 0.0;
+	int hits				= 0;
+	int mismatches			= 0;
+};
+
+static bool ParseArgs(int argc, char** argv, KernelSettings& settings) {
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (i + 1 >= argc) {
+			std::cerr << "Missing value for " << arg << "\n";
+			return false;
+		}
+		std::string value = argv[++i];
+
+		if (arg == "--pairs")			{ settings.pairCount	= std::stoi(value); }
+		else if (arg == "--repeats")	{ settings.repeats		= std::stoi(value); }
+		else if (arg == "--seed")		{ settings.seed			= (uint32_t)std::stoul(value); }
+		else if (arg == "--out")		{ settings.outFile		= value; }
+		else {
+			std::cerr << "Unknown argument " << arg << "\n";
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+Objects are scattered through a box small enough that roughly half of the
+pairs end up overlapping, so both sides of every test get exercised.
+*/
+static GameObject* MakeObject(std::mt19937& gen, VolumeType type) {
+	std::uniform_real_distribution<float> posDis(-2.0f, 2.0f);
+	std::uniform_real_distribution<float> sizeDis(0.5f, 1.5f);
+
+	GameObject* object = new GameObject();
+	float size = sizeDis(gen);
+	if (type == VolumeType::Sphere) {
+		object->SetBoundingVolume((CollisionVolume*)new SphereVolume(size));
+	}
+	else {
+		object->SetBoundingVolume((CollisionVolume*)new AABBVolume(Vector3(size, size, size)));
+	}
+	object->GetTransform().SetPosition(Vector3(posDis(gen), posDis(gen), posDis(gen)));
+	return object;
+}
+
+static bool SameContact(const CollisionDetection::CollisionInfo& x, const CollisionDetection::CollisionInfo& y) {
+	return x.a == y.a && x.b == y.b && memcmp(&x.point, &y.point, sizeof(x.point)) == 0;
+}
+
+static void RunBatched(ObjectPairBatch& batch, const std::vector<std::pair<GameObject*, GameObject*>>& pairs,
+	std::vector<CollisionDetection::CollisionInfo>& contacts, bool useSIMD) {
+	batch.Clear();
+	for (const auto& p : pairs) {
+		batch.Add(p.first, p.second);
+	}
+	batch.Test(useSIMD);
+	for (int i = 0; i < batch.Size(); ++i) {
+		batch.GetResult(i, contacts[i]);
+	}
+}
+
+static KernelTimings RunBenchmark(const KernelSettings& settings) {
+	std::mt19937 gen(settings.seed);
+
+	const VolumeType pairTypes[3][2] = {
+		{ VolumeType::Sphere,	VolumeType::Sphere },
+		{ VolumeType::AABB,		VolumeType::AABB },
+		{ VolumeType::Sphere,	VolumeType::AABB },
+	};
+	std::vector<GameObject*> objects;
+	std::vector<std::pair<GameObject*, GameObject*>> pairs;
+	for (int i = 0; i < settings.pairCount; ++i) {
+		const VolumeType* types = pairTypes[i % 3];
+		GameObject* a = MakeObject(gen, types[0]);
+		GameObject* b = MakeObject(gen, types[1]);
+		objects.push_back(a);
+		objects.push_back(b);
+		pairs.push_back({ a, b });
+	}
+
+	std::vector<CollisionDetection::CollisionInfo> reference(pairs.size());
+	std::vector<CollisionDetection::CollisionInfo> contacts(pairs.size());
+	std::vector<uint8_t> referenceHits(pairs.size());
+	ObjectPairBatch batch;
+
+	KernelTimings timings;
+	GameTimer timer;
+
+	for (int r = 0; r < settings.repeats; ++r) {
+		timer.Tick();
+		for (size_t i = 0; i < pairs.size(); ++i) {
+			referenceHits[i] = CollisionDetection::ObjectIntersection(pairs[i].first, pairs[i].second, reference[i]);
+		}
+		timer.Tick();
+		timings.perPairMS += timer.GetTimeDeltaMSec();
+
+		RunBatched(batch, pairs, contacts, false);
+		timer.Tick();
+		timings.scalarMS += timer.GetTimeDeltaMSec();
+
+		batch.Test(false);
+		timer.Tick();
+		timings.scalarKernelMS += timer.GetTimeDeltaMSec();
+
+		RunBatched(batch, pairs, contacts, true);
+		timer.Tick();
+		timings.simdMS += timer.GetTimeDeltaMSec();
+
+		batch.Test(true);
+		timer.Tick();
+		timings.simdKernelMS += timer.GetTimeDeltaMSec();
+	}
+
+	//The batch still holds the SIMD results from the last repeat
+	for (int i = 0; i < batch.Size(); ++i) {
+		CollisionDetection::CollisionInfo info;
+		bool hit = batch.GetResult(i, info);
+		timings.hits += hit;
+		if (hit != (bool)referenceHits[i] || (hit && !SameContact(info, reference[i]))) {
+			timings.mismatches++;
+		}
+	}
+
+	for (GameObject* o : objects) {
+		delete o;
+	}
+	return timings;
+}
+
+static void WriteJSON(std::ostream& out, const KernelSettings& settings, const KernelTimings& timings) {
+	auto perPair = [&](double ms) {
+		return ms * 1000000.0 / ((double)settings.pairCount * settings.repeats);
+	};
+	auto entry = [&](const char* name, double ms, bool last = false) {
+		out << "\t\t\"" << name << "\": { \"totalMS\": " << ms << ", \"nsPerPair\": " << perPair(ms) << " }" << (last ? "\n" : ",\n");
+	};
+
+	out << "{\n";
+	out << "\t\"pairs\": "			<< settings.pairCount << ",\n";
+	out << "\t\"repeats\": "		<< settings.repeats << ",\n";
+	out << "\t\"seed\": "			<< settings.seed << ",\n";
+	out << "\t\"instructionSet\": \"" << BatchCollision::GetInstructionSetName() << "\",\n";
+	out << "\t\"lanes\": "			<< BatchCollision::GetLaneCount() << ",\n";
+	out << "\t\"hits\": "			<< timings.hits << ",\n";
+	out << "\t\"mismatches\": "		<< timings.mismatches << ",\n";
+	out << "\t\"timings\": {\n";
+	entry("perPair",		timings.perPairMS);
+	entry("scalar",			timings.scalarMS);
+	entry("simd",			timings.simdMS);
+	entry("scalarKernel",	timings.scalarKernelMS);
+	entry("simdKernel",		timings.simdKernelMS, true);
+	out << "\t}\n";
+	out << "}\n";
+}
+
+int main(int argc, char** argv) {
+	KernelSettings settings;
+	if (!ParseArgs(argc, argv, settings)) {
+		return -1;
+	}
+	KernelTimings timings = RunBenchmark(settings);
+
+	if (settings.outFile.empty()) {
+		WriteJSON(std::cout, settings, timings);
+	}
+	else {
+		std::ofstream file(settings.outFile);
+		if (!file) {
+			std::cerr << "Can't open " << settings.outFile << " for writing!\n";
+			return -1;
+		}
+		WriteJSON(file, settings, timings);
+	}
+	return timings.mismatches == 0 ? 0 : 1;
+}
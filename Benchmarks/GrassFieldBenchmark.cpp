@@ -0,0 +1,188 @@
+/*
+Benchmark for the CPU side of grass field generation.
+
+For each map size, times GrassFieldGenerator building the Voronoi map, the
+tileable wind noise, and a blade layout (a quarter as many blades as there
+are texels), first on the calling thread alone and then spread over the job
+system. Both runs use the same seed, and the results are hashed - if the
+threaded output differs from the single threaded output in any way, it's
+counted as a mismatch.
+
+Usage:
+	GrassFieldBenchmark [--sizes 512,1024,2048] [--threads N] [--repeats N] [--seed N] [--out file.json]
+*/
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "GrassFieldGenerator.h"
+#include "JobSystem.h"
+#include "GameTimer.h"
+
+using namespace NCL;
+using namespace CSC8503;
+
+struct GrassSettings {
+	std::vector<int>	sizes		= { 512, 1024, 2048 };
+	int					threadCount	= 0;
+	int					repeats		= 3;
+	uint32_t			seed		= 8498;
+	std::string			outFile;
+};
+
+struct GrassTimings {
+	double voronoiMS	= 0.0;
+	double windMS		= 0.0;
+	double bladesMS		= 0.0;
+	uint64_t checksum	= 0;
+};
+
+struct GrassResult {
+	int				size = 0;
+	GrassTimings	serial;
+	GrassTimings	threaded;
+};
+
+static bool ParseArgs(int argc, char** argv, GrassSettings& settings) {
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (i + 1 >= argc) {
+			std::cerr << "Missing value for " << arg << "\n";
+			return false;
+		}
+		std::string value = argv[++i];
+
+		if (arg == "--sizes") {
+			settings.sizes.clear();
+			std::stringstream list(value);
+			std::string size;
+			while (std::getline(list, size, ',')) {
+				settings.sizes.push_back(std::stoi(size));
+			}
+		}
+		else if (arg == "--threads")	{ settings.threadCount	= std::stoi(value); }
+		else if (arg == "--repeats")	{ settings.repeats		= std::stoi(value); }
+		else if (arg == "--seed")		{ settings.seed			= (uint32_t)std::stoul(value); }
+		else if (arg == "--out")		{ settings.outFile		= value; }
+		else {
+			std::cerr << "Unknown argument " << arg << "\n";
+			return false;
+		}
+	}
+	return true;
+}
+
+//FNV-1a over the raw bytes, so even a single bit of difference shows up
+static uint64_t Hash(const void* data, size_t bytes, uint64_t hash = 14695981039346656037ull) {
+	const uint8_t* b = (const uint8_t*)data;
+	for (size_t i = 0; i < bytes; ++i) {
+		hash = (hash ^ b[i]) * 1099511628211ull;
+	}
+	return hash;
+}
+
+static GrassTimings RunGenerator(const GrassFieldGenerator& generator, int size, int repeats) {
+	std::vector<float>		voronoi;
+	std::vector<float>		wind;
+	std::vector<GrassBlade>	blades;
+
+	int		bladeCount	= size * size / 4;
+	float	fieldLength	= size / 16.0f;
+
+	GrassTimings timings;
+	GameTimer timer;
+	for (int r = 0; r < repeats; ++r) {
+		timer.Tick();
+		generator.GenerateVoronoiMap(voronoi, size, size);
+		timer.Tick();
+		timings.voronoiMS += timer.GetTimeDeltaMSec();
+
+		generator.GenerateWindNoise(wind, size, size);
+		timer.Tick();
+		timings.windMS += timer.GetTimeDeltaMSec();
+
+		generator.GenerateBlades(blades, bladeCount, fieldLength, fieldLength, Vector3());
+		timer.Tick();
+		timings.bladesMS += timer.GetTimeDeltaMSec();
+	}
+	timings.voronoiMS	/= repeats;
+	timings.windMS		/= repeats;
+	timings.bladesMS	/= repeats;
+
+	//GrassBlade has no padding, so its bytes can be hashed directly
+	timings.checksum = Hash(voronoi.data(), voronoi.size() * sizeof(float));
+	timings.checksum = Hash(wind.data(), wind.size() * sizeof(float), timings.checksum);
+	timings.checksum = Hash(blades.data(), blades.size() * sizeof(GrassBlade), timings.checksum);
+	return timings;
+}
+
+static void WriteTimings(std::ostream& out, const char* name, const GrassTimings& t, bool last) {
+	out << "\t\t\t\"" << name << "\": { \"voronoiMS\": " << t.voronoiMS
+		<< ", \"windMS\": " << t.windMS
+		<< ", \"bladesMS\": " << t.bladesMS
+		<< ", \"totalMS\": " << (t.voronoiMS + t.windMS + t.bladesMS)
+		<< ", \"checksum\": \"" << std::hex << t.checksum << std::dec << "\" }" << (last ? "\n" : ",\n");
+}
+
+static void WriteJSON(std::ostream& out, const GrassSettings& settings, int threadCount, const std::vector<GrassResult>& results, int mismatches) {
+	out << "{\n";
+	out << "\t\"threads\": "	<< threadCount << ",\n";
+	out << "\t\"repeats\": "	<< settings.repeats << ",\n";
+	out << "\t\"seed\": "		<< settings.seed << ",\n";
+	out << "\t\"mismatches\": "	<< mismatches << ",\n";
+	out << "\t\"results\": [\n";
+	for (size_t i = 0; i < results.size(); ++i) {
+		const GrassResult& r = results[i];
+		double serialTotal		= r.serial.voronoiMS + r.serial.windMS + r.serial.bladesMS;
+		double threadedTotal	= r.threaded.voronoiMS + r.threaded.windMS + r.threaded.bladesMS;
+
+		out << "\t\t{\n";
+		out << "\t\t\t\"size\": "		<< r.size << ",\n";
+		out << "\t\t\t\"blades\": "	<< (r.size * r.size / 4) << ",\n";
+		WriteTimings(out, "serial", r.serial, false);
+		WriteTimings(out, "threaded", r.threaded, false);
+		out << "\t\t\t\"speedup\": "	<< (threadedTotal > 0.0 ? serialTotal / threadedTotal : 0.0) << "\n";
+		out << "\t\t}" << (i + 1 < results.size() ? ",\n" : "\n");
+	}
+	out << "\t]\n";
+	out << "}\n";
+}
+
+int main(int argc, char** argv) {
+	GrassSettings settings;
+	if (!ParseArgs(argc, argv, settings)) {
+		return -1;
+	}
+	JobSystem jobs(settings.threadCount);
+
+	GrassFieldGenerator serial(settings.seed);
+	GrassFieldGenerator threaded(settings.seed, &jobs);
+
+	std::vector<GrassResult> results;
+	int mismatches = 0;
+	for (int size : settings.sizes) {
+		GrassResult result;
+		result.size		= size;
+		result.serial	= RunGenerator(serial, size, settings.repeats);
+		result.threaded	= RunGenerator(threaded, size, settings.repeats);
+		if (result.serial.checksum != result.threaded.checksum) {
+			mismatches++;
+		}
+		results.push_back(result);
+	}
+
+	if (settings.outFile.empty()) {
+		WriteJSON(std::cout, settings, jobs.GetThreadCount(), results, mismatches);
+	}
+	else {
+		std::ofstream file(settings.outFile);
+		if (!file) {
+			std::cerr << "Can't open " << settings.outFile << " for writing!\n";
+			return -1;
+		}
+		WriteJSON(file, settings, jobs.GetThreadCount(), results, mismatches);
+	}
+	return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,185 @@
+/*
+Checks and times the bitonic sort bladeSort.comp runs, on the CPU.
+
+For each size, builds both of GrassSort's dispatch schedules - a dispatch
+per stage, and the one with the small stages done in shared memory - and
+runs random blade distances through each with GrassSort::Simulate. Every
+result has to come out in order, with the same blades it went in with, and
+exactly matching what std::sort gives - anything else is counted as a
+failure. Alongside that it reports how many dispatches each schedule takes,
+which is what the local stages are there to cut down.
+
+Usage:
+	GrassSortBenchmark [--sizes 256,4096,32768] [--repeats N] [--seed N] [--out file.json]
+*/
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <random>
+
+#include "GrassSort.h"
+#include "GameTimer.h"
+
+using namespace NCL;
+using namespace CSC8503;
+
+struct SortSettings {
+	std::vector<uint32_t>	sizes	= { 256, 4096, 32768 };
+	int						repeats	= 5;
+	uint32_t				seed	= 8498;
+	std::string				outFile;
+};
+
+struct ScheduleResult {
+	int		dispatches	= 0;
+	double	simulateMS	= 0.0;
+	int		failures	= 0;
+};
+
+struct SortResult {
+	uint32_t		size = 0;
+	ScheduleResult	global;
+	ScheduleResult	local;
+};
+
+static bool ParseArgs(int argc, char** argv, SortSettings& settings) {
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (i + 1 >= argc) {
+			std::cerr << "Missing value for " << arg << "\n";
+			return false;
+		}
+		std::string value = argv[++i];
+
+		if (arg == "--sizes") {
+			settings.sizes.clear();
+			std::stringstream list(value);
+			std::string size;
+			while (std::getline(list, size, ',')) {
+				settings.sizes.push_back((uint32_t)std::stoul(size));
+			}
+		}
+		else if (arg == "--repeats")	{ settings.repeats	= std::stoi(value); }
+		else if (arg == "--seed")		{ settings.seed		= (uint32_t)std::stoul(value); }
+		else if (arg == "--out")		{ settings.outFile	= value; }
+		else {
+			std::cerr << "Unknown argument " << arg << "\n";
+			return false;
+		}
+	}
+	for (uint32_t size : settings.sizes) {
+		if (size == 0 || (size & (size - 1)) != 0) {
+			std::cerr << "Sizes have to be powers of two, " << size << " isn't\n";
+			return false;
+		}
+	}
+	return true;
+}
+
+//Lots of repeated distances, so blades that tie have to survive the sort too
+static std::vector<BladeIndex> RandomBlades(uint32_t count, std::mt19937& rng) {
+	std::uniform_int_distribution<int> distance(0, 4096);
+	std::vector<BladeIndex> blades(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		blades[i] = { distance(rng) * 0.125f, i };
+	}
+	return blades;
+}
+
+static bool SameBlades(std::vector<BladeIndex> sorted, const std::vector<BladeIndex>& original) {
+	std::vector<bool> seen(original.size(), false);
+	for (const BladeIndex& b : sorted) {
+		if (b.index >= original.size() || seen[b.index] || original[b.index].distance != b.distance) {
+			return false;
+		}
+		seen[b.index] = true;
+	}
+	return true;
+}
+
+static ScheduleResult RunSchedule(const std::vector<BladeSortPass>& schedule, uint32_t size, int repeats, uint32_t seed) {
+	ScheduleResult result;
+	result.dispatches = (int)schedule.size();
+
+	std::mt19937 rng(seed);
+	GameTimer timer;
+	for (int r = 0; r < repeats; ++r) {
+		std::vector<BladeIndex> original	= RandomBlades(size, rng);
+		std::vector<BladeIndex> blades		= original;
+
+		timer.Tick();
+		GrassSort::Simulate(blades, schedule);
+		timer.Tick();
+		result.simulateMS += timer.GetTimeDeltaMSec();
+
+		std::vector<BladeIndex> expected = original;
+		std::stable_sort(expected.begin(), expected.end(), [](const BladeIndex& a, const BladeIndex& b) {
+			return a.distance < b.distance;
+		});
+		bool matches = GrassSort::IsSorted(blades) && SameBlades(blades, original);
+		for (uint32_t i = 0; matches && i < size; ++i) {
+			matches = blades[i].distance == expected[i].distance;
+		}
+		result.failures += !matches;
+	}
+	result.simulateMS /= repeats;
+	return result;
+}
+
+static void WriteSchedule(std::ostream& out, const char* name, const ScheduleResult& s, bool last) {
+	out << "\t\t\t\"" << name << "\": { \"dispatches\": " << s.dispatches
+		<< ", \"simulateMS\": " << s.simulateMS
+		<< ", \"failures\": " << s.failures << " }" << (last ? "\n" : ",\n");
+}
+
+static void WriteJSON(std::ostream& out, const SortSettings& settings, const std::vector<SortResult>& results, int failures) {
+	out << "{\n";
+	out << "\t\"repeats\": "	<< settings.repeats << ",\n";
+	out << "\t\"seed\": "		<< settings.seed << ",\n";
+	out << "\t\"localSize\": "	<< GrassSort::localSize << ",\n";
+	out << "\t\"failures\": "	<< failures << ",\n";
+	out << "\t\"results\": [\n";
+	for (size_t i = 0; i < results.size(); ++i) {
+		const SortResult& r = results[i];
+		out << "\t\t{\n";
+		out << "\t\t\t\"size\": " << r.size << ",\n";
+		WriteSchedule(out, "global", r.global, false);
+		WriteSchedule(out, "local", r.local, true);
+		out << "\t\t}" << (i + 1 < results.size() ? ",\n" : "\n");
+	}
+	out << "\t]\n";
+	out << "}\n";
+}
+
+int main(int argc, char** argv) {
+	SortSettings settings;
+	if (!ParseArgs(argc, argv, settings)) {
+		return -1;
+	}
+
+	std::vector<SortResult> results;
+	int failures = 0;
+	for (uint32_t size : settings.sizes) {
+		SortResult result;
+		result.size		= size;
+		result.global	= RunSchedule(GrassSort::BuildSchedule(size, false), size, settings.repeats, settings.seed);
+		result.local	= RunSchedule(GrassSort::BuildSchedule(size, true), size, settings.repeats, settings.seed);
+		failures += result.global.failures + result.local.failures;
+		results.push_back(result);
+	}
+
+	if (settings.outFile.empty()) {
+		WriteJSON(std::cout, settings, results, failures);
+	}
+	else {
+		std::ofstream file(settings.outFile);
+		if (!file) {
+			std::cerr << "Can't open " << settings.outFile << " for writing!\n";
+			return -1;
+		}
+		WriteJSON(file, settings, results, failures);
+	}
+	return failures == 0 ? 0 : 1;
+}
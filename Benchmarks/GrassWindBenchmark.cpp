@@ -0,0 +1,191 @@
+/*
+Times and checks the CPU grass paths' wind.
+
+Lays out a field of blades, then runs the same frames of wind over them
+three ways - the Perlin noise call per blade GrassTile used to make, and
+GrassWind sampling its wind texture, once with every blade sampled every
+frame, and once with the sampling spread over --slices frames.
+
+Every frame of the unsliced run is checked against GrassWind::Sample, the
+plain scalar version of the same sampling - any blade more than 1e-5 off
+counts as a failure. The sliced run is compared against the unsliced one,
+and how far apart they ever got is reported, as that's the price paid for
+doing less work a frame.
+
+Usage:
+	GrassWindBenchmark [--blades N] [--slices N] [--frames N] [--seed N] [--out file.json]
+*/
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cmath>
+
+#include "../FastNoiseLite/Cpp/FastNoiseLite.h"
+#include "GrassWind.h"
+#include "GameTimer.h"
+
+using namespace NCL;
+using namespace CSC8503;
+
+struct WindSettings {
+	int			blades	= 32768;
+	int			slices	= 4;
+	int			frames	= 240;
+	uint32_t	seed	= 8498;
+	std::string	outFile;
+};
+
+struct WindResult {
+	double	perlinMS		= 0.0;	//Per frame
+	double	unslicedMS		= 0.0;
+	double	slicedMS		= 0.0;
+	float	maxSampleError	= 0.0f;	//Unsliced against GrassWind::Sample
+	float	maxSliceError	= 0.0f;	//Sliced against unsliced
+	int		failures		= 0;
+};
+
+static const float	frameTime			= 1.0f / 60.0f;
+static const float	sampleTolerance		= 1e-5f;
+
+static bool ParseArgs(int argc, char** argv, WindSettings& settings) {
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (i + 1 >= argc) {
+			std::cerr << "Missing value for " << arg << "\n";
+			return false;
+		}
+		std::string value = argv[++i];
+
+		if		(arg == "--blades")	{ settings.blades	= std::stoi(value); }
+		else if (arg == "--slices")	{ settings.slices	= std::stoi(value); }
+		else if (arg == "--frames")	{ settings.frames	= std::stoi(value); }
+		else if (arg == "--seed")	{ settings.seed		= (uint32_t)std::stoul(value); }
+		else if (arg == "--out")	{ settings.outFile	= value; }
+		else {
+			std::cerr << "Unknown argument " << arg << "\n";
+			return false;
+		}
+	}
+	if (settings.blades <= 0 || settings.slices <= 0 || settings.frames <= 0) {
+		std::cerr << "Blades, slices and frames all have to be above 0\n";
+		return false;
+	}
+	return true;
+}
+
+static const char* InstructionSet() {
+#if defined(__AVX2__)
+	return "avx2";
+#elif defined(__SSE2__) || defined(_M_X64)
+	return "sse2";
+#else
+	return "scalar";
+#endif
+}
+
+//What GrassTile::UpdateWind used to do every frame
+static double RunPerlin(std::vector<GrassBlade> blades, int frames) {
+	FastNoiseLite noise;
+	noise.SetNoiseType(FastNoiseLite::NoiseType_Perlin);
+	noise.SetFrequency(0.1f);
+
+	GameTimer timer;
+	double totalMS = 0.0;
+	for (int f = 0; f < frames; ++f) {
+		float time = f * frameTime;
+		timer.Tick();
+		for (GrassBlade& blade : blades) {
+			blade.noiseValue = noise.GetNoise(blade.position.x + time * 5.0f, blade.position.z) * 2.0f;
+		}
+		timer.Tick();
+		totalMS += timer.GetTimeDeltaMSec();
+	}
+	return totalMS / frames;
+}
+
+static WindResult RunWind(const std::vector<GrassBlade>& blades, const GrassWindTexture& texture, const WindSettings& settings) {
+	WindResult result;
+
+	GrassWind unsliced;
+	GrassWind sliced;
+	for (GrassWind* wind : { &unsliced, &sliced }) {
+		wind->SetTexture(&texture);
+		wind->SetBlades(blades);
+	}
+	sliced.SetSliceCount(settings.slices);
+
+	GameTimer timer;
+	for (int f = 0; f < settings.frames; ++f) {
+		float time = f * frameTime;
+
+		timer.Tick();
+		unsliced.Update(time, frameTime);
+		timer.Tick();
+		result.unslicedMS += timer.GetTimeDeltaMSec();
+
+		timer.Tick();
+		sliced.Update(time, frameTime);
+		timer.Tick();
+		result.slicedMS += timer.GetTimeDeltaMSec();
+
+		const std::vector<float>& expected	= unsliced.GetNoise();
+		const std::vector<float>& blended	= sliced.GetNoise();
+		bool failed = false;
+		for (size_t i = 0; i < blades.size(); ++i) {
+			float error = std::abs(expected[i] - unsliced.Sample(i, time));
+			result.maxSampleError	= std::max(result.maxSampleError, error);
+			result.maxSliceError	= std::max(result.maxSliceError, std::abs(expected[i] - blended[i]));
+			failed |= error > sampleTolerance;
+		}
+		result.failures += failed;
+	}
+	result.unslicedMS	/= settings.frames;
+	result.slicedMS		/= settings.frames;
+	return result;
+}
+
+static void WriteJSON(std::ostream& out, const WindSettings& settings, const GrassWindTexture& texture, const WindResult& r) {
+	out << "{\n";
+	out << "\t\"blades\": "			<< settings.blades << ",\n";
+	out << "\t\"slices\": "			<< settings.slices << ",\n";
+	out << "\t\"frames\": "			<< settings.frames << ",\n";
+	out << "\t\"seed\": "			<< settings.seed << ",\n";
+	out << "\t\"instructionSet\": \"" << InstructionSet() << "\",\n";
+	out << "\t\"textureSize\": "	<< texture.size << ",\n";
+	out << "\t\"perlinMS\": "		<< r.perlinMS << ",\n";
+	out << "\t\"unslicedMS\": "		<< r.unslicedMS << ",\n";
+	out << "\t\"slicedMS\": "		<< r.slicedMS << ",\n";
+	out << "\t\"maxSampleError\": "	<< r.maxSampleError << ",\n";
+	out << "\t\"maxSliceError\": "	<< r.maxSliceError << ",\n";
+	out << "\t\"failures\": "		<< r.failures << "\n";
+	out << "}\n";
+}
+
+int main(int argc, char** argv) {
+	WindSettings settings;
+	if (!ParseArgs(argc, argv, settings)) {
+		return -1;
+	}
+
+	GrassFieldGenerator generator(settings.seed);
+	std::vector<GrassBlade> blades;
+	generator.GenerateBlades(blades, settings.blades, 128.0f, 128.0f, Vector3());
+	GrassWindTexture texture = GrassWind::BuildTexture(generator);
+
+	WindResult result	= RunWind(blades, texture, settings);
+	result.perlinMS		= RunPerlin(blades, settings.frames);
+
+	if (settings.outFile.empty()) {
+		WriteJSON(std::cout, settings, texture, result);
+	}
+	else {
+		std::ofstream file(settings.outFile);
+		if (!file) {
+			std::cerr << "Can't open " << settings.outFile << " for writing!\n";
+			return -1;
+		}
+		WriteJSON(file, settings, texture, result);
+	}
+	return result.failures == 0 ? 0 : 1;
+}
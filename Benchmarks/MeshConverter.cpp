@@ -0,0 +1,103 @@
+/*
+Converts text .msh meshes into binary .mshb ones, which MshLoader::LoadMesh
+then picks up in their place - see MshLoader.cpp for what's in them.
+
+With no files given, converts every .msh in the mesh folder. A mesh whose
+.mshb is already at least as new as it is skipped, unless --force is set.
+
+Usage:
+	MeshConverter [--dir folder] [--force] [file.msh ...]
+*/
+#include <iostream>
+#include <string>
+#include <vector>
+#include <filesystem>
+
+#include "Mesh.h"
+#include "MshLoader.h"
+#include "Assets.h"
+
+using namespace NCL;
+using namespace Rendering;
+namespace fs = std::filesystem;
+
+//Nothing to upload to, it's just here to hold the data
+class ConvertedMesh : public Mesh {
+public:
+	void UploadToGPU(RendererBase* /*renderer*/) override {}
+};
+
+struct ConvertSettings {
+	std::string					dir		= Assets::MESHDIR;
+	bool						force	= false;
+	std::vector<std::string>	files;
+};
+
+static bool ParseArgs(int argc, char** argv, ConvertSettings& settings) {
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--force") {
+			settings.force = true;
+		}
+		else if (arg == "--dir") {
+			if (i + 1 >= argc) {
+				std::cerr << "Missing value for " << arg << "\n";
+				return false;
+			}
+			settings.dir = argv[++i];
+		}
+		else if (arg.rfind("--", 0) == 0) {
+			std::cerr << "Unknown argument " << arg << "\n";
+			return false;
+		}
+		else {
+			settings.files.push_back(arg);
+		}
+	}
+	return true;
+}
+
+int main(int argc, char** argv) {
+	ConvertSettings settings;
+	if (!ParseArgs(argc, argv, settings)) {
+		return -1;
+	}
+
+	if (settings.files.empty()) {
+		std::error_code error;
+		for (const fs::directory_entry& entry : fs::directory_iterator(settings.dir, error)) {
+			if (entry.is_regular_file() && entry.path().extension() == ".msh") {
+				settings.files.push_back(entry.path().string());
+			}
+		}
+		if (error) {
+			std::cerr << "Can't read " << settings.dir << "\n";
+			return -1;
+		}
+	}
+
+	int converted	= 0;
+	int skipped		= 0;
+	int failed		= 0;
+	for (const std::string& textPath : settings.files) {
+		std::string binaryPath = MshLoader::BinaryMeshPath(textPath);
+
+		std::error_code error;
+		if (!settings.force && fs::exists(binaryPath, error) && fs::last_write_time(binaryPath, error) >= fs::last_write_time(textPath, error)) {
+			skipped++;
+			continue;
+		}
+
+		ConvertedMesh mesh;
+		if (!MshLoader::LoadTextMesh(textPath, mesh) || mesh.GetVertexCount() == 0 || !MshLoader::WriteBinaryMesh(binaryPath, mesh)) {
+			std::cerr << "Couldn't convert " << textPath << "\n";
+			failed++;
+			continue;
+		}
+		std::cout << textPath << " (" << fs::file_size(textPath, error) << " bytes) -> "
+			<< binaryPath << " (" << fs::file_size(binaryPath, error) << " bytes)\n";
+		converted++;
+	}
+	std::cout << converted << " converted, " << skipped << " already up to date, " << failed << " failed\n";
+	return failed == 0 ? 0 : 1;
+}
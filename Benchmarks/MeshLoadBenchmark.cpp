@@ -0,0 +1,222 @@
+/*
+Times loading every .msh in the mesh folder, from the text format and from
+the binary .mshb one.
+
+Each mesh is converted into a .mshb of its own in a scratch folder first,
+so it doesn't matter whether MeshConverter has been run. Then each is
+loaded --repeats times both ways, and the binary load has to come out
+with exactly the same data as the text one did - any mesh that doesn't
+counts as a failure. Both ways get a warm file cache, as every repeat
+after the first reads the same file again, so the difference is down to
+the parsing and copying rather than the disk.
+
+Usage:
+	MeshLoadBenchmark [--dir folder] [--repeats N] [--out file.json]
+*/
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <filesystem>
+
+#include "Mesh.h"
+#include "MshLoader.h"
+#include "Assets.h"
+#include "GameTimer.h"
+
+using namespace NCL;
+using namespace Rendering;
+namespace fs = std::filesystem;
+
+//Nothing to upload to, it's just here to hold the data
+class LoadedMesh : public Mesh {
+public:
+	void UploadToGPU(RendererBase* /*renderer*/) override {}
+};
+
+struct LoadSettings {
+	std::string	dir		= Assets::MESHDIR;
+	int			repeats	= 10;
+	std::string	outFile;
+};
+
+struct MeshResult {
+	std::string	name;
+	size_t		vertices		= 0;
+	size_t		indices			= 0;
+	uintmax_t	textBytes		= 0;
+	uintmax_t	binaryBytes		= 0;
+	double		textMS			= 0.0;	//Per load
+	double		binaryMS		= 0.0;
+	bool		matches			= false;
+};
+
+static bool ParseArgs(int argc, char** argv, LoadSettings& settings) {
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (i + 1 >= argc) {
+			std::cerr << "Missing value for " << arg << "\n";
+			return false;
+		}
+		std::string value = argv[++i];
+
+		if		(arg == "--dir")		{ settings.dir		= value; }
+		else if (arg == "--repeats")	{ settings.repeats	= std::stoi(value); }
+		else if (arg == "--out")		{ settings.outFile	= value; }
+		else {
+			std::cerr << "Unknown argument " << arg << "\n";
+			return false;
+		}
+	}
+	if (settings.repeats <= 0) {
+		std::cerr << "Repeats has to be above 0\n";
+		return false;
+	}
+	return true;
+}
+
+template<typename T>
+static bool SameData(const std::vector<T>& a, const std::vector<T>& b) {
+	return a.size() == b.size() && (a.empty() || memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+}
+
+static bool SameMesh(const Mesh& a, const Mesh& b) {
+	bool subMeshesMatch = a.GetSubMeshCount() == b.GetSubMeshCount();
+	for (size_t i = 0; subMeshesMatch && i < a.GetSubMeshCount(); ++i) {
+		const SubMesh& sa = a.GetSubMeshes()[i];
+		const SubMesh& sb = b.GetSubMeshes()[i];
+		subMeshesMatch = sa.start == sb.start && sa.count == sb.count && sa.base == sb.base;
+	}
+	return subMeshesMatch
+		&& a.GetPrimitiveType()		== b.GetPrimitiveType()
+		&& SameData(a.GetPositionData(),		b.GetPositionData())
+		&& SameData(a.GetColourData(),			b.GetColourData())
+		&& SameData(a.GetNormalData(),			b.GetNormalData())
+		&& SameData(a.GetTangentData(),			b.GetTangentData())
+		&& SameData(a.GetTextureCoordData(),	b.GetTextureCoordData())
+		&& SameData(a.GetIndexData(),			b.GetIndexData())
+		&& SameData(a.GetSkinWeightData(),		b.GetSkinWeightData())
+		&& SameData(a.GetSkinIndexData(),		b.GetSkinIndexData())
+		&& SameData(a.GetJointParents(),		b.GetJointParents())
+		&& SameData(a.GetBindPose(),			b.GetBindPose())
+		&& SameData(a.GetInverseBindPose(),		b.GetInverseBindPose())
+		&& a.GetJointNames()		== b.GetJointNames()
+		&& a.GetSubMeshNames()		== b.GetSubMeshNames();
+}
+
+static bool RunMesh(const fs::path& textPath, const fs::path& scratchDir, int repeats, MeshResult& result) {
+	result.name = textPath.filename().string();
+
+	LoadedMesh textMesh;
+	if (!MshLoader::LoadTextMesh(textPath.string(), textMesh) || textMesh.GetVertexCount() == 0) {
+		return false;
+	}
+	std::string binaryPath = MshLoader::BinaryMeshPath((scratchDir / result.name).string());
+	if (!MshLoader::WriteBinaryMesh(binaryPath, textMesh)) {
+		return false;
+	}
+	result.vertices		= textMesh.GetVertexCount();
+	result.indices		= textMesh.GetIndexCount();
+	result.textBytes	= fs::file_size(textPath);
+	result.binaryBytes	= fs::file_size(binaryPath);
+	result.matches		= true;
+
+	GameTimer timer;
+	for (int r = 0; r < repeats; ++r) {
+		LoadedMesh mesh;
+		timer.Tick();
+		MshLoader::LoadTextMesh(textPath.string(), mesh);
+		timer.Tick();
+		result.textMS += timer.GetTimeDeltaMSec();
+	}
+	for (int r = 0; r < repeats; ++r) {
+		LoadedMesh mesh;
+		timer.Tick();
+		bool loaded = MshLoader::LoadBinaryMesh(binaryPath, mesh);
+		timer.Tick();
+		result.binaryMS += timer.GetTimeDeltaMSec();
+		result.matches &= loaded && SameMesh(textMesh, mesh);
+	}
+	result.textMS	/= repeats;
+	result.binaryMS /= repeats;
+	return true;
+}
+
+static void WriteJSON(std::ostream& out, const LoadSettings& settings, const std::vector<MeshResult>& results, int failures) {
+	double textMS	= 0.0;
+	double binaryMS = 0.0;
+	for (const MeshResult& r : results) {
+		textMS		+= r.textMS;
+		binaryMS	+= r.binaryMS;
+	}
+	out << "{\n";
+	out << "\t\"repeats\": "		<< settings.repeats << ",\n";
+	out << "\t\"meshes\": [\n";
+	for (size_t i = 0; i < results.size(); ++i) {
+		const MeshResult& r = results[i];
+		out << "\t\t{ \"name\": \"" << r.name << "\", \"vertices\": " << r.vertices << ", \"indices\": " << r.indices
+			<< ", \"textBytes\": " << r.textBytes << ", \"binaryBytes\": " << r.binaryBytes
+			<< ", \"textMS\": " << r.textMS << ", \"binaryMS\": " << r.binaryMS
+			<< ", \"matches\": " << (r.matches ? "true" : "false") << " }"
+			<< (i + 1 < results.size() ? ",\n" : "\n");
+	}
+	out << "\t],\n";
+	out << "\t\"totalTextMS\": "	<< textMS << ",\n";
+	out << "\t\"totalBinaryMS\": "	<< binaryMS << ",\n";
+	out << "\t\"speedup\": "		<< (binaryMS > 0.0 ? textMS / binaryMS : 0.0) << ",\n";
+	out << "\t\"failures\": "		<< failures << "\n";
+	out << "}\n";
+}
+
+int main(int argc, char** argv) {
+	LoadSettings settings;
+	if (!ParseArgs(argc, argv, settings)) {
+		return -1;
+	}
+
+	std::vector<fs::path> meshFiles;
+	std::error_code error;
+	for (const fs::directory_entry& entry : fs::directory_iterator(settings.dir, error)) {
+		if (entry.is_regular_file() && entry.path().extension() == ".msh") {
+			meshFiles.push_back(entry.path());
+		}
+	}
+	if (error || meshFiles.empty()) {
+		std::cerr << "No meshes found in " << settings.dir << "\n";
+		return -1;
+	}
+	std::sort(meshFiles.begin(), meshFiles.end());
+
+	fs::path scratchDir = fs::temp_directory_path() / "MeshLoadBenchmarkScratch";
+	if (fs::exists(scratchDir, error) || !fs::create_directories(scratchDir, error)) {
+		std::cerr << "Can't make a scratch folder at " << scratchDir.string() << "\n";
+		return -1;
+	}
+
+	std::vector<MeshResult> results;
+	int failures = 0;
+	for (const fs::path& path : meshFiles) {
+		MeshResult result;
+		if (!RunMesh(path, scratchDir, settings.repeats, result)) {
+			std::cerr << "Skipping " << path.filename().string() << ", it doesn't load as a text mesh\n";
+			continue;
+		}
+		failures += !result.matches;
+		results.push_back(result);
+	}
+	fs::remove_all(scratchDir, error);
+
+	if (settings.outFile.empty()) {
+		WriteJSON(std::cout, settings, results, failures);
+	}
+	else {
+		std::ofstream file(settings.outFile);
+		if (!file) {
+			std::cerr << "Can't open " << settings.outFile << " for writing!\n";
+			return -1;
+		}
+		WriteJSON(file, settings, results, failures);
+	}
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,325 @@
+/*
+Headless physics benchmark.
+
+Builds a GameWorld full of spheres, AABBs, OBBs and capsules from a fixed
+seed, steps the PhysicsSystem a fixed number of ticks without a window, and
+writes the per-phase timings out as JSON. Every physics optimisation should
+be judged against the numbers this produces.
+
+Usage:
+	PhysicsBenchmark [--objects N] [--ticks N] [--seed N] [--shapes sphere,aabb,obb,capsule]
+	                 [--broadphase 0|1] [--container tree|quadtree] [--gravity 0|1] [--threads N]
+	                 [--bodystore 0|1] [--sleep 0|1] [--batched 0|1] [--min-sleep-ratio R] [--out file.json]
+
+The output includes a checksum of every object's final position and orientation,
+so runs with different thread counts can be checked against each other.
+
+With --min-sleep-ratio, the run fails if less than that fraction of the
+non-static bodies are asleep by the end of it - so with sleeping on, this:
+
+	PhysicsBenchmark --shapes sphere,aabb --ticks 1500 --sleep 1 --min-sleep-ratio 0.9
+
+checks that bodies that have come to rest actually go to sleep. OBBs and
+capsules are left out of it, as nothing stops them falling through the
+floor's AABB, so they never come to rest.
+*/
+#include <iostream>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "GameWorld.h"
+#include "GameObject.h"
+#include "PhysicsSystem.h"
+#include "PhysicsObject.h"
+#include "CollisionDetection.h"
+#include "GameTimer.h"
+
+using namespace NCL;
+using namespace CSC8503;
+
+struct BenchmarkSettings {
+	int			objectCount		= 1000;
+	int			tickCount		= 600;
+	uint32_t	seed			= 8498;
+	bool		useBroadPhase	= true;
+	bool		useQuadTree		= false;
+	bool		useGravity		= true;
+	int			threadCount		= 1;
+	bool		useBodyStore	= false;
+	bool		useSleeping		= false;
+	bool		useBatched		= false;
+	float		minSleepRatio	= 0.0f;
+	std::vector<VolumeType> shapes = { VolumeType::Sphere, VolumeType::AABB, VolumeType::OBB, VolumeType::Capsule };
+	std::string	outFile;
+};
+
+static bool ParseShapes(const std::string& list, std::vector<VolumeType>& shapes) {
+	shapes.clear();
+	size_t start = 0;
+	while (start <= list.size()) {
+		size_t end = list.find(',', start);
+		if (end == std::string::npos) {
+			end = list.size();
+		}
+		std::string name = list.substr(start, end - start);
+		if (name == "sphere")		{ shapes.push_back(VolumeType::Sphere); }
+		else if (name == "aabb")	{ shapes.push_back(VolumeType::AABB); }
+		else if (name == "obb")		{ shapes.push_back(VolumeType::OBB); }
+		else if (name == "capsule")	{ shapes.push_back(VolumeType::Capsule); }
+		else {
+			std::cerr << "Unknown shape type " << name << "\n";
+			return false;
+		}
+		start = end + 1;
+	}
+	return !shapes.empty();
+}
+
+static bool ParseArgs(int argc, char** argv, BenchmarkSettings& settings) {
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (i + 1 >= argc) {
+			std::cerr << "Missing value for " << arg << "\n";
+			return false;
+		}
+		std::string value = argv[++i];
+
+		if (arg == "--objects")			{ settings.objectCount	= std::stoi(value); }
+		else if (arg == "--ticks")		{ settings.tickCount	= std::stoi(value); }
+		else if (arg == "--seed")		{ settings.seed			= (uint32_t)std::stoul(value); }
+		else if (arg == "--broadphase")	{ settings.useBroadPhase = value != "0"; }
+		else if (arg == "--container")	{ settings.useQuadTree	= value == "quadtree"; }
+		else if (arg == "--gravity")	{ settings.useGravity	= value != "0"; }
+		else if (arg == "--threads")	{ settings.threadCount	= std::stoi(value); }
+		else if (arg == "--bodystore")	{ settings.useBodyStore	= value != "0"; }
+		else if (arg == "--sleep")		{ settings.useSleeping	= value != "0"; }
+		else if (arg == "--batched")	{ settings.useBatched	= value != "0"; }
+		else if (arg == "--min-sleep-ratio") { settings.minSleepRatio = std::stof(value); }
+		else if (arg == "--out")		{ settings.outFile		= value; }
+		else if (arg == "--shapes") {
+			if (!ParseShapes(value, settings.shapes)) {
+				return false;
+			}
+		}
+		else {
+			std::cerr << "Unknown argument " << arg << "\n";
+			return false;
+		}
+	}
+	return true;
+}
+
+static const char* ShapeName(VolumeType type) {
+	switch (type) {
+		case VolumeType::Sphere:	return "sphere";
+		case VolumeType::AABB:		return "aabb";
+		case VolumeType::OBB:		return "obb";
+		case VolumeType::Capsule:	return "capsule";
+		default:					return "invalid";
+	}
+}
+
+static void AddFloor(GameWorld& world) {
+	GameObject* floor = new GameObject("Floor");
+	floor->SetCollisionLayer(CollisionLayer::Terrain);
+
+	Vector3 floorSize = Vector3(512, 2, 512);
+	floor->SetBoundingVolume((CollisionVolume*)new AABBVolume(floorSize));
+	floor->GetTransform()
+		.SetScale(floorSize * 2.0f)
+		.SetPosition(Vector3(0, -2, 0));
+
+	floor->SetPhysicsObject(new PhysicsObject(&floor->GetTransform(), floor->GetBoundingVolume()));
+	floor->GetPhysicsObject()->SetInverseMass(0);
+	floor->GetPhysicsObject()->InitCubeInertia();
+
+	world.AddGameObject(floor);
+}
+
+static void PopulateWorld(GameWorld& world, const BenchmarkSettings& settings) {
+	std::mt19937 gen(settings.seed);
+
+	//Keep the density roughly constant as the object count grows, while staying
+	//inside the broadphase QuadTree's 1024x1024 bounds
+	float extent = std::min(500.0f, 4.0f * std::sqrt((float)settings.objectCount));
+
+	std::uniform_real_distribution<float> posDis(-extent, extent);
+	std::uniform_real_distribution<float> heightDis(1.0f, 20.0f);
+	std::uniform_real_distribution<float> sizeDis(0.5f, 1.5f);
+	std::uniform_real_distribution<float> angleDis(-180.0f, 180.0f);
+	std::uniform_real_distribution<float> velDis(-2.0f, 2.0f);
+
+	AddFloor(world);
+
+	for (int i = 0; i < settings.objectCount; ++i) {
+		VolumeType type = settings.shapes[i % settings.shapes.size()];
+
+		GameObject* object = new GameObject();
+		float size = sizeDis(gen);
+
+		Vector3 position(posDis(gen), heightDis(gen), posDis(gen));
+		Quaternion orientation = Quaternion::EulerAnglesToQuaternion(0.0f, angleDis(gen), 0.0f);
+
+		switch (type) {
+			case VolumeType::Sphere:
+				object->SetBoundingVolume((CollisionVolume*)new SphereVolume(size));
+				object->GetTransform().SetScale(Vector3(size, size, size));
+				break;
+			case VolumeType::AABB:
+				object->SetBoundingVolume((CollisionVolume*)new AABBVolume(Vector3(size, size, size)));
+				object->GetTransform().SetScale(Vector3(size, size, size) * 2.0f);
+				break;
+			case VolumeType::OBB:
+				object->SetBoundingVolume((CollisionVolume*)new OBBVolume(Vector3(size, size, size)));
+				object->GetTransform().SetScale(Vector3(size, size, size) * 2.0f);
+				object->GetTransform().SetOrientation(orientation);
+				break;
+			case VolumeType::Capsule:
+				object->SetBoundingVolume((CollisionVolume*)new CapsuleVolume(size * 2.0f, size));
+				object->GetTransform().SetScale(Vector3(size * 2.0f, size * 2.0f, size * 2.0f));
+				break;
+			default:
+				break;
+		}
+		object->GetTransform().SetPosition(position);
+
+		object->SetPhysicsObject(new PhysicsObject(&object->GetTransform(), object->GetBoundingVolume()));
+		object->GetPhysicsObject()->SetInverseMass(1.0f / size);
+		if (type == VolumeType::Sphere) {
+			object->GetPhysicsObject()->InitSphereInertia();
+		}
+		else {
+			object->GetPhysicsObject()->InitCubeInertia();
+		}
+		object->GetPhysicsObject()->SetLinearVelocity(Vector3(velDis(gen), 0.0f, velDis(gen)));
+
+		world.AddGameObject(object);
+	}
+}
+
+//FNV-1a over the raw bits of every object's transform
+static uint64_t WorldChecksum(GameWorld& world) {
+	uint64_t hash = 14695981039346656037ull;
+	auto addBytes = [&](const void* data, size_t size) {
+		const unsigned char* bytes = (const unsigned char*)data;
+		for (size_t i = 0; i < size; ++i) {
+			hash = (hash ^ bytes[i]) * 1099511628211ull;
+		}
+	};
+	world.OperateOnContents([&](GameObject* o) {
+		Vector3		position	= o->GetTransform().GetPosition();
+		Quaternion	orientation = o->GetTransform().GetOrientation();
+		addBytes(&position, sizeof(position));
+		addBytes(&orientation, sizeof(orientation));
+	});
+	return hash;
+}
+
+static float SleepRatio(const PhysicsBodyCounts& counts) {
+	int moving = counts.awake + counts.asleep;
+	return moving > 0 ? counts.asleep / (float)moving : 0.0f;
+}
+
+static void WriteJSON(std::ostream& out, const BenchmarkSettings& settings, const PhysicsSystem& physics, double setupMS, double totalMS, uint64_t checksum) {
+	const PhysicsPhaseTimings&	timings = physics.GetPhaseTimings();
+	const PhysicsBodyCounts&	counts	= physics.GetBodyCounts();
+
+	auto perStep = [&](double ms) {
+		return timings.fixedSteps > 0 ? ms / timings.fixedSteps : 0.0;
+	};
+	auto phase = [&](const char* name, double ms, bool last = false) {
+		out << "\t\t\"" << name << "\": { \"totalMS\": " << ms << ", \"perStepMS\": " << perStep(ms) << " }" << (last ? "\n" : ",\n");
+	};
+
+	out << "{\n";
+	out << "\t\"objects\": "	<< settings.objectCount << ",\n";
+	out << "\t\"ticks\": "		<< settings.tickCount << ",\n";
+	out << "\t\"fixedSteps\": "	<< timings.fixedSteps << ",\n";
+	out << "\t\"seed\": "		<< settings.seed << ",\n";
+	out << "\t\"broadphase\": "	<< (settings.useBroadPhase ? "true" : "false") << ",\n";
+	out << "\t\"container\": \""	<< (settings.useQuadTree ? "quadtree" : "tree") << "\",\n";
+	out << "\t\"gravity\": "	<< (settings.useGravity ? "true" : "false") << ",\n";
+	out << "\t\"threads\": "	<< settings.threadCount << ",\n";
+	out << "\t\"bodyStore\": "	<< (settings.useBodyStore ? "true" : "false") << ",\n";
+	out << "\t\"sleeping\": "	<< (settings.useSleeping ? "true" : "false") << ",\n";
+	out << "\t\"batched\": "	<< (physics.IsUsingBatchedNarrowPhase() ? "true" : "false") << ",\n"; //Needs USE_BATCHED_NARROWPHASE, so may not match --batched
+	out << "\t\"shapes\": [";
+	for (size_t i = 0; i < settings.shapes.size(); ++i) {
+		out << (i ? ", " : "") << "\"" << ShapeName(settings.shapes[i]) << "\"";
+	}
+	out << "],\n";
+	out << "\t\"setupMS\": " << setupMS << ",\n";
+	out << "\t\"totalMS\": " << totalMS << ",\n";
+	out << "\t\"checksum\": \"" << std::hex << checksum << std::dec << "\",\n";
+	out << "\t\"bodies\": { \"awake\": " << counts.awake << ", \"asleep\": " << counts.asleep << ", \"static\": " << counts.statics << " },\n";
+	out << "\t\"sleepRatio\": " << SleepRatio(counts) << ",\n";
+	out << "\t\"phases\": {\n";
+	phase("IntegrateAccel",			timings.integrateAccel);
+	phase("BroadPhase",				timings.broadPhase);
+	phase("NarrowPhase",			timings.narrowPhase);
+	phase("UpdateConstraints",		timings.updateConstraints);
+	phase("IntegrateVelocity",		timings.integrateVelocity);
+	phase("UpdateCollisionList",	timings.updateCollisionList, true);
+	out << "\t}\n";
+	out << "}\n";
+}
+
+int main(int argc, char** argv) {
+	BenchmarkSettings settings;
+	if (!ParseArgs(argc, argv, settings)) {
+		return -1;
+	}
+
+	GameTimer timer;
+
+	GameWorld world;
+	PhysicsSystem physics(world);
+
+	physics.UseAdaptiveTimestep(false);
+	physics.UseBroadPhase(settings.useBroadPhase);
+	physics.UseSimpleContainer(settings.useQuadTree);
+	physics.UseGravity(settings.useGravity);
+	physics.SetThreadCount(settings.threadCount);
+	physics.UseBodyStore(settings.useBodyStore);
+	physics.UseSleeping(settings.useSleeping);
+	physics.UseBatchedNarrowPhase(settings.useBatched);
+
+	PopulateWorld(world, settings);
+
+	timer.Tick();
+	double setupMS = timer.GetTimeDeltaMSec();
+
+	//One tick per call at the fixed rate, so every run does the same work
+	const float tickDT = 1.0f / 120.0f;
+	physics.ResetPhaseTimings();
+	for (int i = 0; i < settings.tickCount; ++i) {
+		physics.Update(tickDT);
+	}
+
+	timer.Tick();
+	double totalMS = timer.GetTimeDeltaMSec();
+	uint64_t checksum = WorldChecksum(world);
+
+	if (settings.outFile.empty()) {
+		WriteJSON(std::cout, settings, physics, setupMS, totalMS, checksum);
+	}
+	else {
+		std::ofstream file(settings.outFile);
+		if (!file) {
+			std::cerr << "Can't open " << settings.outFile << " for writing!\n";
+			return -1;
+		}
+		WriteJSON(file, settings, physics, setupMS, totalMS, checksum);
+	}
+
+	float sleepRatio = SleepRatio(physics.GetBodyCounts());
+	world.ClearAndErase();
+
+	if (sleepRatio < settings.minSleepRatio) {
+		std::cerr << "Only " << sleepRatio << " of the bodies went to sleep, expected at least " << settings.minSleepRatio << "\n";
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include "glad\gl.h"
+
+namespace NCL {
+	namespace Rendering {
+		/*
+		A few query objects for one query target (GL_SAMPLES_PASSED,
+		GL_TIME_ELAPSED etc), used round robin, so a result is only ever asked
+		for a few frames after it was queried - by which point the GPU has
+		nearly always finished with it, and reading it doesn't stall.
+
+		If the oldest query still isn't back when its turn comes round again,
+		that frame just doesn't get queried, rather than waiting on it. Only a
+		frame whose Begin read a result back has one - the rest, and every
+		frame while the ring is disabled, get 0, so that a sum over several
+		rings never counts the same old result twice.
+
+		The query objects are made the first time they're needed, so this
+		can be set up before there's a GL context.
+		*/
+		class GPUQueryRing {
+		public:
+			GPUQueryRing(GLenum target, int size = 3) : target(target) {
+				queries.resize(std::max(size, 1), 0);
+				pending.resize(queries.size(), false);
+				stale.resize(queries.size(), false);
+			}
+
+			~GPUQueryRing() {
+				if (queries[0]) {
+					glDeleteQueries((GLsizei)queries.size(), queries.data());
+				}
+			}
+
+			GPUQueryRing(const GPUQueryRing&) = delete;
+			GPUQueryRing& operator=(const GPUQueryRing&) = delete;
+
+			void Begin() {
+				active		= false;
+				hasResult	= false;
+				if (!enabled) {
+					return;
+				}
+				if (!queries[0]) {
+					glGenQueries((GLsizei)queries.size(), queries.data());
+				}
+				GLuint query = queries[next];
+				if (pending[next]) {
+					GLuint available = 0;
+					glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+					if (!available) {
+						return;
+					}
+					glGetQueryObjectui64v(query, GL_QUERY_RESULT, &result);
+					pending[next]	= false;
+					hasResult		= !stale[next];
+					stale[next]		= false;
+				}
+				glBeginQuery(target, query);
+				active = true;
+			}
+
+			void End() {
+				if (!active) {
+					return;
+				}
+				glEndQuery(target);
+				pending[next] = true;
+				next = (next + 1) % queries.size();
+				active = false;
+			}
+
+			//What came back during this frame's Begin, from a query a few frames old, or 0 if nothing did
+			GLuint64 GetResult() const {
+				return hasResult ? result : 0;
+			}
+
+			bool HasResult() const {
+				return hasResult;
+			}
+
+			/*
+			Throws away anything measured so far, for when whatever was being
+			measured has changed. Queries still in flight aren't waited on -
+			their results get read back as normal, then ignored.
+			*/
+			void Reset() {
+				for (size_t i = 0; i < queries.size(); ++i) {
+					stale[i] = pending[i];
+				}
+				hasResult = false;
+			}
+
+			//A disabled ring never begins another query, and anything already in flight is just left
+			void SetEnabled(bool state) {
+				enabled		= state;
+				hasResult	= hasResult && enabled;
+			}
+
+			bool IsEnabled() const {
+				return enabled;
+			}
+
+		protected:
+			GLenum				target;
+			std::vector<GLuint>	queries;
+			std::vector<bool>	pending;
+			std::vector<bool>	stale;		//Pending, but from before the last Reset
+			size_t				next		= 0;
+			bool				active		= false;
+			bool				enabled		= true;
+			bool				hasResult	= false;
+			GLuint64			result		= 0;
+		};
+	}
+}
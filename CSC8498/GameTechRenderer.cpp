@@ -4,7 +4,10 @@
 #include "Camera.h"
 #include "TextureLoader.h"
 #include "MshLoader.h"
+#include "Frustum.h"
+#include "Profiler.h"
 #include <random>
+#include <algorithm>
 #include "../CSC8498/GrassTile.h"
 
 using namespace NCL;
@@ -19,6 +22,17 @@ GameTechRenderer::GameTechRenderer(GameWorld& world) : OGLRenderer(*Window::GetW
 	glEnable(GL_DEPTH_TEST);
 	glDepthFunc(GL_LEQUAL);
 
+	//Has to be set before any shader using it is loaded, it's applied as they link
+	OGLShader::SetUniformBlockBinding("FrameData", FrameDataBinding);
+
+	glGenBuffers(1, &frameUBO);
+	glBindBuffer(GL_UNIFORM_BUFFER, frameUBO);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, FrameDataBinding, frameUBO);
+
+	glGenBuffers(1, &sceneInstanceSSBO);
+
 	debugShader  = new OGLShader("debug.vert", "debug.frag");
 	shadowShader = new OGLShader("shadow.vert", "shadow.frag");
 
@@ -81,6 +95,8 @@ GameTechRenderer::GameTechRenderer(GameWorld& world) : OGLRenderer(*Window::GetW
 GameTechRenderer::~GameTechRenderer()	{
 	glDeleteTextures(1, &shadowTex);
 	glDeleteFramebuffers(1, &shadowFBO);
+	glDeleteBuffers(1, &frameUBO);
+	glDeleteBuffers(1, &sceneInstanceSSBO);
 }
 
 void GameTechRenderer::LoadSkybox() {
@@ -124,14 +140,17 @@ void GameTechRenderer::LoadSkybox() {
 }
 
 void GameTechRenderer::RenderFrame(float dt) {
+	PROFILE_SCOPE("Render::Frame");
 	glEnable(GL_CULL_FACE);
 	glClearColor(1, 1, 1, 1);
+	UpdateFrameUniforms(dt);
+	UpdateShadowMatrices();
 	BuildObjectList();
 	SortObjectList();
 	RenderShadowMap();
 	RenderSkybox();
 	RenderCamera();
-	if (grassTiles.size() > 0) {
+	if (grassTiles.size() > 0 || grassField) {
 		glDisable(GL_CULL_FACE);
 		RenderGrassTiles(dt);
 		glEnable(GL_CULL_FACE);
@@ -151,26 +170,191 @@ void GameTechRenderer::RenderFrame(float dt) {
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 }
 
+void GameTechRenderer::UpdateFrameUniforms(float dt) {
+	PROFILE_SCOPE("Render::UpdateFrameUniforms");
+	FrameUniforms frame;
+	frame.viewMatrix	= gameWorld.GetMainCamera().BuildViewMatrix();
+	frame.projMatrix	= gameWorld.GetMainCamera().BuildProjectionMatrix(hostWindow.GetScreenAspect());
+	frame.cameraPos		= gameWorld.GetMainCamera().GetPosition();
+	frame.padding		= 0.0f;
+	frame.lightPos		= lightPosition;
+	frame.lightRadius	= lightRadius;
+	frame.lightColour	= lightColour;
+	frame.windDir		= Vector3(windDirection.x, windDirection.y, windSpeed);
+	frame.deltaTime		= dt;
+
+	glBindBuffer(GL_UNIFORM_BUFFER, frameUBO);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &frame);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void GameTechRenderer::UpdateShadowMatrices() {
+	PROFILE_SCOPE("Render::UpdateShadowMatrices");
+	Matrix4 shadowViewMatrix = Matrix::View(lightPosition, Vector3(0, 0, 0), Vector3(0,1,0));
+	Matrix4 shadowProjMatrix = Matrix::Perspective(100.0f, 500.0f, 1.0f, 45.0f);
+
+	shadowViewProj	= shadowProjMatrix * shadowViewMatrix;
+	shadowMatrix	= biasMatrix * shadowViewProj; //we'll use this one later on
+}
+
+//A sphere around the mesh's bounds, once the model matrix has moved and scaled them
+static void WorldBoundingSphere(const Mesh& mesh, const Matrix4& model, Vector3& centre, float& radius) {
+	Vector3 localCentre = (mesh.GetBoundsMin() + mesh.GetBoundsMax()) * 0.5f;
+	float	localRadius = Vector::Length(mesh.GetBoundsMax() - mesh.GetBoundsMin()) * 0.5f;
+
+	float maxScale = 0.0f;
+	for (int i = 0; i < 3; ++i) {
+		maxScale = std::max(maxScale, Vector::Length(Vector3(model.GetColumn(i))));
+	}
+	centre = Vector3(model * Vector4(localCentre, 1.0f));
+	radius = localRadius * maxScale;
+}
+
+/*
+Goes through every object in the world, split across the job system's
+threads. Each thread culls its share against both the camera's and the
+light's frustum, and writes whatever is left into its own packet lists -
+nothing in here touches GL, or anything another thread writes to.
+*/
 void GameTechRenderer::BuildObjectList() {
-	activeObjects.clear();
-
-	gameWorld.OperateOnContents(
-		[&](GameObject* o) {
-			if (o->IsActive()) {
-				const RenderObject* g = o->GetRenderObject();
-				if (g) {
-					activeObjects.emplace_back(g);
-				}
+	PROFILE_SCOPE("Render::BuildObjectList");
+	GameObjectIterator first;
+	GameObjectIterator last;
+	gameWorld.GetObjectIterators(first, last);
+
+	Matrix4 viewMatrix = gameWorld.GetMainCamera().BuildViewMatrix();
+	Matrix4 projMatrix = gameWorld.GetMainCamera().BuildProjectionMatrix(hostWindow.GetScreenAspect());
+
+	Frustum cameraFrustum = Frustum::FromViewProjMatrix(projMatrix * viewMatrix);
+	Frustum shadowFrustum = Frustum::FromViewProjMatrix(shadowViewProj);
+
+	threadPackets.resize(jobSystem ? jobSystem->GetThreadCount() : 1);
+	for (ThreadPackets& packets : threadPackets) {
+		packets.camera.clear();
+		packets.shadow.clear();
+		packets.objects = 0;
+	}
+
+	auto extract = [&](int begin, int end, int threadIndex) {
+		PROFILE_SCOPE("Render::ExtractObjects");
+		ThreadPackets& packets = threadPackets[threadIndex];
+		for (int i = begin; i < end; ++i) {
+			const GameObject* o = *(first + i);
+			const RenderObject* r = o->IsActive() ? o->GetRenderObject() : nullptr;
+			if (!r) {
+				continue;
+			}
+			packets.objects++;
+
+			SceneDrawItem item;
+			item.object			= r;
+			item.shader			= (OGLShader*)r->GetShader();
+			item.texture		= (OGLTexture*)r->GetDefaultTexture();
+			item.mesh			= (OGLMesh*)r->GetMesh();
+			item.modelMatrix	= r->GetTransform()->GetMatrix();
+			item.order			= (uint32_t)i;
+
+			Vector3 centre;
+			float	radius;
+			WorldBoundingSphere(*item.mesh, item.modelMatrix, centre, radius);
+
+			if (cameraFrustum.SphereInsideFrustum(centre, radius)) {
+				packets.camera.push_back(item);
+			}
+			if (shadowFrustum.SphereInsideFrustum(centre, radius)) {
+				item.mvpMatrix = shadowViewProj * item.modelMatrix;
+				packets.shadow.push_back(item);
 			}
 		}
-	);
+	};
+	if (jobSystem) {
+		jobSystem->ParallelFor((int)(last - first), ObjectBatchSize, extract);
+	}
+	else {
+		extract(0, (int)(last - first), 0);
+	}
 }
 
+/*
+Merges what each thread found into the queues the two passes draw from,
+and uploads every queued object's model matrix and colour for the
+instanced draws to read.
+
+The camera queue is sorted by shader, then texture, then mesh, and the
+shadow queue (which only ever uses one shader) just by mesh, so that
+everything that can be drawn together ends up next to each other.
+*/
 void GameTechRenderer::SortObjectList() {
+	PROFILE_SCOPE("Render::SortObjectList");
+	cameraQueue.clear();
+	shadowQueue.clear();
+	sceneStats = SceneRenderStats();
+
+	for (const ThreadPackets& packets : threadPackets) {
+		cameraQueue.insert(cameraQueue.end(), packets.camera.begin(), packets.camera.end());
+		shadowQueue.insert(shadowQueue.end(), packets.shadow.begin(), packets.shadow.end());
+		sceneStats.objects += packets.objects;
+	}
+	sceneStats.cameraCulled = sceneStats.objects - (int)cameraQueue.size();
+	sceneStats.shadowCulled = sceneStats.objects - (int)shadowQueue.size();
 
+	bool batch = batchScene;
+	std::sort(cameraQueue.begin(), cameraQueue.end(), [batch](const SceneDrawItem& a, const SceneDrawItem& b) {
+		if (batch && a.shader != b.shader) {
+			return (uintptr_t)a.shader < (uintptr_t)b.shader;
+		}
+		if (batch && a.texture != b.texture) {
+			return (uintptr_t)a.texture < (uintptr_t)b.texture;
+		}
+		if (batch && a.mesh != b.mesh) {
+			return (uintptr_t)a.mesh < (uintptr_t)b.mesh;
+		}
+		return a.order < b.order;
+	});
+	std::sort(shadowQueue.begin(), shadowQueue.end(), [batch](const SceneDrawItem& a, const SceneDrawItem& b) {
+		if (batch && a.mesh != b.mesh) {
+			return (uintptr_t)a.mesh < (uintptr_t)b.mesh;
+		}
+		return a.order < b.order;
+	});
+
+	sceneInstances.clear();
+	for (const SceneDrawItem& item : cameraQueue) {
+		sceneInstances.push_back({ item.modelMatrix, item.object->GetColour() });
+	}
+	for (const SceneDrawItem& item : shadowQueue) {
+		sceneInstances.push_back({ item.modelMatrix, item.object->GetColour() });
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, sceneInstanceSSBO);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sceneInstances.size() * sizeof(SceneInstance), sceneInstances.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+//How many objects from start on can go in the same draw - the shadow pass only cares about the mesh
+size_t GameTechRenderer::RunLength(const vector<SceneDrawItem>& queue, size_t start, bool meshOnly) {
+	const SceneDrawItem& first = queue[start];
+	size_t end = start + 1;
+	while (end < queue.size()) {
+		const SceneDrawItem& next = queue[end];
+		if (next.mesh != first.mesh || (!meshOnly && (next.shader != first.shader || next.texture != first.texture))) {
+			break;
+		}
+		++end;
+	}
+	return end - start;
+}
+
+void GameTechRenderer::DrawSceneMesh(const OGLMesh& mesh, int instanceCount) {
+	size_t layerCount = mesh.GetSubMeshCount();
+	for (size_t i = 0; i < layerCount; ++i) {
+		DrawBoundMesh((uint32_t)i, instanceCount);
+	}
+	sceneStats.drawCalls		+= (int)layerCount;
+	sceneStats.instancedDraws	+= instanceCount > 1 ? (int)layerCount : 0;
 }
 
 void GameTechRenderer::RenderShadowMap() {
+	PROFILE_SCOPE("Render::ShadowMap");
 	glBindFramebuffer(GL_FRAMEBUFFER, shadowFBO);
 	glClear(GL_DEPTH_BUFFER_BIT);
 	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
@@ -179,24 +363,37 @@ void GameTechRenderer::RenderShadowMap() {
 	glCullFace(GL_FRONT);
 
 	UseShader(*shadowShader);
-	int mvpLocation = glGetUniformLocation(shadowShader->GetProgramID(), "mvpMatrix");
-
-	Matrix4 shadowViewMatrix = Matrix::View(lightPosition, Vector3(0, 0, 0), Vector3(0,1,0));
-	Matrix4 shadowProjMatrix = Matrix::Perspective(100.0f, 500.0f, 1.0f, 45.0f);
-
-	Matrix4 mvMatrix = shadowProjMatrix * shadowViewMatrix;
-
-	shadowMatrix = biasMatrix * mvMatrix; //we'll use this one later on
-
-	for (const auto&i : activeObjects) {
-		Matrix4 modelMatrix = (*i).GetTransform()->GetMatrix();
-		Matrix4 mvpMatrix	= mvMatrix * modelMatrix;
-		glUniformMatrix4fv(mvpLocation, 1, false, (float*)&mvpMatrix);
-		BindMesh((OGLMesh&)*(*i).GetMesh());
-		size_t layerCount = (*i).GetMesh()->GetSubMeshCount();
-		for (size_t i = 0; i < layerCount; ++i) {
-			DrawBoundMesh((uint32_t)i);
+	sceneStats.shaderChanges++;
+	int mvpLocation			= shadowShader->GetUniformLocation("mvpMatrix");
+	int viewProjLocation	= shadowShader->GetUniformLocation("viewProjMatrix");
+	int instanceLocation	= shadowShader->GetUniformLocation("instanceOffset");
+
+	bool instanced = batchScene && instanceLocation >= 0;
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SceneInstanceBinding, sceneInstanceSSBO);
+	glUniformMatrix4fv(viewProjLocation, 1, false, (float*)&shadowViewProj);
+	glUniform1i(instanceLocation, -1);
+
+	//The shadow queue's instances come after the camera queue's
+	size_t firstInstance = cameraQueue.size();
+
+	const OGLMesh* activeMesh = nullptr;
+	for (size_t i = 0; i < shadowQueue.size();) {
+		const SceneDrawItem& item = shadowQueue[i];
+		size_t count = instanced ? RunLength(shadowQueue, i, true) : 1;
+
+		if (item.mesh != activeMesh || !batchScene) {
+			BindMesh(*item.mesh);
+			sceneStats.meshChanges++;
+			activeMesh = item.mesh;
 		}
+		if (instanced) {
+			glUniform1i(instanceLocation, (int)(firstInstance + i));
+		}
+		else {
+			glUniformMatrix4fv(mvpLocation, 1, false, (float*)&item.mvpMatrix);
+		}
+		DrawSceneMesh(*item.mesh, (int)count);
+		i += count;
 	}
 
 	glViewport(0, 0, windowSize.x, windowSize.y);
@@ -207,21 +404,14 @@ void GameTechRenderer::RenderShadowMap() {
 }
 
 void GameTechRenderer::RenderSkybox() {
+	PROFILE_SCOPE("Render::Skybox");
 	glDisable(GL_CULL_FACE);
 	glDisable(GL_BLEND);
 	glDisable(GL_DEPTH_TEST);
 
-	Matrix4 viewMatrix = gameWorld.GetMainCamera().BuildViewMatrix();
-	Matrix4 projMatrix = gameWorld.GetMainCamera().BuildProjectionMatrix(hostWindow.GetScreenAspect());
-
 	UseShader(*skyboxShader);
 
-	int projLocation = glGetUniformLocation(skyboxShader->GetProgramID(), "projMatrix");
-	int viewLocation = glGetUniformLocation(skyboxShader->GetProgramID(), "viewMatrix");
-	int texLocation  = glGetUniformLocation(skyboxShader->GetProgramID(), "cubeTex");
-
-	glUniformMatrix4fv(projLocation, 1, false, (float*)&projMatrix);
-	glUniformMatrix4fv(viewLocation, 1, false, (float*)&viewMatrix);
+	int texLocation = skyboxShader->GetUniformLocation("cubeTex");
 
 	glUniform1i(texLocation, 0);
 	glActiveTexture(GL_TEXTURE0);
@@ -236,24 +426,19 @@ void GameTechRenderer::RenderSkybox() {
 }
 
 void GameTechRenderer::RenderCamera() {
+	PROFILE_SCOPE("Render::Camera");
 	glDisable(GL_CULL_FACE);
-	Matrix4 viewMatrix = gameWorld.GetMainCamera().BuildViewMatrix();
-	Matrix4 projMatrix = gameWorld.GetMainCamera().BuildProjectionMatrix(hostWindow.GetScreenAspect());
 
-	OGLShader* activeShader = nullptr;
-	int projLocation	= 0;
-	int viewLocation	= 0;
+	OGLShader*	activeShader	= nullptr;
+	OGLTexture*	activeTexture	= nullptr;
+	OGLMesh*	activeMesh		= nullptr;
+
 	int modelLocation	= 0;
 	int colourLocation  = 0;
 	int hasVColLocation = 0;
 	int hasTexLocation  = 0;
 	int shadowLocation  = 0;
-
-	int lightPosLocation	= 0;
-	int lightColourLocation = 0;
-	int lightRadiusLocation = 0;
-
-	int cameraLocation = 0;
+	int instanceLocation = 0;
 
 	int TileXLenLocation = 0;
 	int TileZLenLocation = 0;
@@ -268,97 +453,112 @@ void GameTechRenderer::RenderCamera() {
 	glActiveTexture(GL_TEXTURE0 + 1);
 	glBindTexture(GL_TEXTURE_2D, shadowTex);
 
-	for (const auto&i : activeObjects) {
-		OGLShader* shader = (OGLShader*)(*i).GetShader();
-		UseShader(*shader);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SceneInstanceBinding, sceneInstanceSSBO);
 
-		if ((*i).GetDefaultTexture()) {
-			BindTextureToShader(*(OGLTexture*)(*i).GetDefaultTexture(), "mainTex", 0);
-		}
+	for (size_t i = 0; i < cameraQueue.size();) {
+		const SceneDrawItem& item = cameraQueue[i];
+		OGLShader* shader = item.shader;
 
-		if (activeShader != shader) {
-			projLocation	= glGetUniformLocation(shader->GetProgramID(), "projMatrix");
-			viewLocation	= glGetUniformLocation(shader->GetProgramID(), "viewMatrix");
-			modelLocation	= glGetUniformLocation(shader->GetProgramID(), "modelMatrix");
-			shadowLocation  = glGetUniformLocation(shader->GetProgramID(), "shadowMatrix");
-			colourLocation  = glGetUniformLocation(shader->GetProgramID(), "objectColour");
-			hasVColLocation = glGetUniformLocation(shader->GetProgramID(), "hasVertexColours");
-			hasTexLocation  = glGetUniformLocation(shader->GetProgramID(), "hasTexture");
+		//Without batching, every object sets everything, just like they all used to
+		bool newShader = shader != activeShader;
+		bool forceState = newShader || !batchScene;
 
-			lightPosLocation	= glGetUniformLocation(shader->GetProgramID(), "lightPos");
-			lightColourLocation = glGetUniformLocation(shader->GetProgramID(), "lightColour");
-			lightRadiusLocation = glGetUniformLocation(shader->GetProgramID(), "lightRadius");
+		if (forceState) {
+			UseShader(*shader);
+			sceneStats.shaderChanges++;
+		}
 
-			cameraLocation = glGetUniformLocation(shader->GetProgramID(), "cameraPos");
+		if (newShader) {
+			//Camera, light and the rest of the per frame data all come from the FrameData block
+			modelLocation	= shader->GetUniformLocation("modelMatrix");
+			shadowLocation  = shader->GetUniformLocation("shadowMatrix");
+			colourLocation  = shader->GetUniformLocation("objectColour");
+			hasVColLocation = shader->GetUniformLocation("hasVertexColours");
+			hasTexLocation  = shader->GetUniformLocation("hasTexture");
+			instanceLocation = shader->GetUniformLocation("instanceOffset");
 
 			//NOTE: In order to find the locations of uniforms they must actually be used
 			// Unused uniforms will be unoptimised out.
-			TileXLenLocation = glGetUniformLocation(shader->GetProgramID(), "xLen");
-			TileZLenLocation = glGetUniformLocation(shader->GetProgramID(), "zLen");
-
-			MaxBladesLocation = glGetUniformLocation(shader->GetProgramID(), "MAX_BLADES");
+			TileXLenLocation = shader->GetUniformLocation("xLen");
+			TileZLenLocation = shader->GetUniformLocation("zLen");
 
-			bendAmountLocation = glGetUniformLocation(shader->GetProgramID(), "bendAmount");
-			maxHeightLocation = glGetUniformLocation(shader->GetProgramID(), "maxHeight");
-			noiseAmountLocation = glGetUniformLocation(shader->GetProgramID(), "noiseAmount");
+			MaxBladesLocation = shader->GetUniformLocation("MAX_BLADES");
 
+			bendAmountLocation = shader->GetUniformLocation("bendAmount");
+			maxHeightLocation = shader->GetUniformLocation("maxHeight");
+			noiseAmountLocation = shader->GetUniformLocation("noiseAmount");
 
-			Vector3 camPos = gameWorld.GetMainCamera().GetPosition();
-			glUniform3fv(cameraLocation, 1, &camPos.x);
-
-			glUniformMatrix4fv(projLocation, 1, false, (float*)&projMatrix);
-			glUniformMatrix4fv(viewLocation, 1, false, (float*)&viewMatrix);
-
-			glUniform3fv(lightPosLocation	, 1, (float*)&lightPosition);
-			glUniform4fv(lightColourLocation, 1, (float*)&lightColour);
-			glUniform1f(lightRadiusLocation , lightRadius);
-
-			int shadowTexLocation = glGetUniformLocation(shader->GetProgramID(), "shadowTex");
+			int shadowTexLocation = shader->GetUniformLocation("shadowTex");
 			glUniform1i(shadowTexLocation, 1);
 
 
 			// Custom uniforms for grass tiles
 			if (TileXLenLocation >= 0 && TileZLenLocation >= 0 && MaxBladesLocation >= 0) {
-				glUniform1f(TileXLenLocation, *(*i).GetXLen());
-				glUniform1f(TileZLenLocation, *(*i).GetZLen());
-				glUniform1i(MaxBladesLocation, *(*i).GetMaxBlades());
+				glUniform1f(TileXLenLocation, *(*item.object).GetXLen());
+				glUniform1f(TileZLenLocation, *(*item.object).GetZLen());
+				glUniform1i(MaxBladesLocation, *(*item.object).GetMaxBlades());
+			}
+
+			//Instanced draws only get the light's matrix, the shader adds each instance's model matrix itself
+			glUniform1i(instanceLocation, -1);
+			if (batchScene && instanceLocation >= 0) {
+				glUniformMatrix4fv(shadowLocation, 1, false, (float*)&shadowMatrix);
 			}
 
 			activeShader = shader;
 		}
 
-		Matrix4 modelMatrix = (*i).GetTransform()->GetMatrix();
-		glUniformMatrix4fv(modelLocation, 1, false, (float*)&modelMatrix);			
-		
-		Matrix4 fullShadowMat = shadowMatrix * modelMatrix;
-		glUniformMatrix4fv(shadowLocation, 1, false, (float*)&fullShadowMat);
+		if (forceState || item.texture != activeTexture) {
+			if (item.texture) {
+				BindTextureToShader(*item.texture, "mainTex", 0);
+			}
+			glUniform1i(hasTexLocation, item.texture ? 1:0);
+			sceneStats.textureChanges++;
+			activeTexture = item.texture;
+		}
 
-		Vector4 colour = i->GetColour();
-		glUniform4fv(colourLocation, 1, &colour.x);
+		if (forceState || item.mesh != activeMesh) {
+			BindMesh(*item.mesh);
+			glUniform1i(hasVColLocation, !item.mesh->GetColourData().empty());
+			sceneStats.meshChanges++;
+			activeMesh = item.mesh;
+		}
 
-		glUniform1i(hasVColLocation, !(*i).GetMesh()->GetColourData().empty());
+		bool instanced = batchScene && instanceLocation >= 0;
+		size_t count = instanced ? RunLength(cameraQueue, i, false) : 1;
 
-		glUniform1i(hasTexLocation, (OGLTexture*)(*i).GetDefaultTexture() ? 1:0);
+		if (instanced) {
+			glUniform1i(instanceLocation, (int)i);
+		}
+		else {
+			glUniformMatrix4fv(modelLocation, 1, false, (float*)&item.modelMatrix);
 
+			Matrix4 fullShadowMat = shadowMatrix * item.modelMatrix;
+			glUniformMatrix4fv(shadowLocation, 1, false, (float*)&fullShadowMat);
 
-		if (bendAmountLocation >= 0 && maxHeightLocation >= 0 && noiseAmountLocation >= 0) {
-			glUniform1f(bendAmountLocation, (*i).GetGrassBlade()->bendAmount);
-			glUniform1f(maxHeightLocation, (*i).GetMaxHeight());
-			glUniform1f(noiseAmountLocation, (*i).GetGrassBlade()->noiseValue);
-		}
+			Vector4 colour = item.object->GetColour();
+			glUniform4fv(colourLocation, 1, &colour.x);
 
-		BindMesh((OGLMesh&)*(*i).GetMesh());
-		size_t layerCount = (*i).GetMesh()->GetSubMeshCount();
-		for (size_t i = 0; i < layerCount; ++i) {
-			DrawBoundMesh((uint32_t)i);
+			if (bendAmountLocation >= 0 && maxHeightLocation >= 0 && noiseAmountLocation >= 0) {
+				glUniform1f(bendAmountLocation, (*item.object).GetGrassBlade()->bendAmount);
+				glUniform1f(maxHeightLocation, (*item.object).GetMaxHeight());
+				glUniform1f(noiseAmountLocation, (*item.object).GetGrassBlade()->noiseValue);
+			}
 		}
+
+		DrawSceneMesh(*item.mesh, (int)count);
+		i += count;
 	}
 	glEnable(GL_CULL_FACE);
 }
 
 void GameTechRenderer::RenderGrassTiles(float dt) {
+	PROFILE_SCOPE("Render::GrassTiles");
 	for (GrassTile* tile : grassTiles) {
-		tile->DrawTile(&shadowTex, &lightPosition, &lightRadius, &lightColour, dt);
+		tile->DrawTile(&shadowTex);
+	}
+	if (grassField) {
+		grassField->Draw(&shadowTex, dt);
 	}
 }
 
@@ -382,8 +582,8 @@ void GameTechRenderer::NewRenderLines() {
 	Matrix4 viewProj  = projMatrix * viewMatrix;
 
 	UseShader(*debugShader);
-	int matSlot = glGetUniformLocation(debugShader->GetProgramID(), "viewProjMatrix");
-	GLuint texSlot = glGetUniformLocation(debugShader->GetProgramID(), "useTexture");
+	int matSlot = debugShader->GetUniformLocation("viewProjMatrix");
+	GLuint texSlot = debugShader->GetUniformLocation("useTexture");
 	glUniform1i(texSlot, 0);
 
 	glUniformMatrix4fv(matSlot, 1, false, (float*)viewProj.array);
@@ -424,10 +624,10 @@ void GameTechRenderer::NewRenderText() {
 
 	Matrix4 proj = Matrix::Orthographic(0.0f, 100.0f, 100.0f, 0.0f, -1.0f, 1.0f);
 
-	int matSlot = glGetUniformLocation(debugShader->GetProgramID(), "viewProjMatrix");
+	int matSlot = debugShader->GetUniformLocation("viewProjMatrix");
 	glUniformMatrix4fv(matSlot, 1, false, (float*)proj.array);
 
-	GLuint texSlot = glGetUniformLocation(debugShader->GetProgramID(), "useTexture");
+	GLuint texSlot = debugShader->GetUniformLocation("useTexture");
 	glUniform1i(texSlot, 1);
 
 	debugTextPos.clear();
@@ -466,16 +666,16 @@ void GameTechRenderer::NewRenderTextures() {
 
 	Matrix4 proj = Matrix::Orthographic(0.0f, 100.0f, 100.0f, 0.0f, -1.0f, 1.0f);
 
-	int matSlot = glGetUniformLocation(debugShader->GetProgramID(), "viewProjMatrix");
+	int matSlot = debugShader->GetUniformLocation("viewProjMatrix");
 	glUniformMatrix4fv(matSlot, 1, false, (float*)proj.array);
 
-	GLuint texSlot = glGetUniformLocation(debugShader->GetProgramID(), "useTexture");
+	GLuint texSlot = debugShader->GetUniformLocation("useTexture");
 	glUniform1i(texSlot, 2);
 
-	GLuint useColourSlot = glGetUniformLocation(debugShader->GetProgramID(), "useColour");
+	GLuint useColourSlot = debugShader->GetUniformLocation("useColour");
 	glUniform1i(useColourSlot, 1);
 
-	GLuint colourSlot = glGetUniformLocation(debugShader->GetProgramID(), "texColour");
+	GLuint colourSlot = debugShader->GetUniformLocation("texColour");
 
 	BindMesh(*debugTexMesh);
 
@@ -5,12 +5,66 @@
 #include "OGLMesh.h"
 
 #include "GameWorld.h"
+#include "JobSystem.h"
 #include "GrassTile.h"
+#include "GrassField.h"
 
 namespace NCL {
 	namespace CSC8503 {
 		class RenderObject;
 
+		/*
+		Matches the FrameData block in frameData.glsl (std140), so it can be
+		copied straight into the uniform buffer - each vec3 is padded out to
+		16 bytes by whatever comes after it.
+		*/
+		struct FrameUniforms {
+			Matrix4	viewMatrix;
+			Matrix4	projMatrix;
+			Vector3	cameraPos;
+			float	padding;
+			Vector3	lightPos;
+			float	lightRadius;
+			Vector4	lightColour;
+			Vector3	windDir;	//x and z direction, then speed
+			float	deltaTime;
+		};
+		static_assert(sizeof(FrameUniforms) == 192, "FrameUniforms has to match the std140 layout of FrameData");
+
+		//One object's worth of the scene, with everything the passes need looked up once a frame
+		struct SceneDrawItem {
+			const RenderObject*	object;
+			OGLShader*			shader;
+			OGLTexture*			texture;
+			OGLMesh*			mesh;
+			Matrix4				modelMatrix;
+			Matrix4				mvpMatrix;	//Only worked out for the shadow pass, scene.vert does its own
+			uint32_t			order;		//Where the object is in the world, so sorting is repeatable
+		};
+
+		//Matches InstanceData in scene.vert and shadow.vert (std430)
+		struct SceneInstance {
+			Matrix4	modelMatrix;
+			Vector4	colour;
+		};
+		static_assert(sizeof(SceneInstance) == 80, "SceneInstance has to match the std430 layout of InstanceData");
+
+		//What drawing the scene (not the grass or debug) cost, across both the shadow and camera passes
+		struct SceneRenderStats {
+			int objects			= 0;
+			int cameraCulled	= 0;	//Objects outside the camera's frustum
+			int shadowCulled	= 0;	//Objects outside the light's frustum, so not in the shadow map
+			int drawCalls		= 0;
+			int instancedDraws	= 0;	//Draw calls that covered more than one object
+			int shaderChanges	= 0;
+			int textureChanges	= 0;
+			int meshChanges		= 0;
+
+			int StateChanges() const {
+				return shaderChanges + textureChanges + meshChanges;
+			}
+		};
+
 		class GameTechRenderer : public OGLRenderer	{
 		public:
 			GameTechRenderer(GameWorld& world);
@@ -37,30 +91,91 @@ namespace NCL {
 				grassTiles.push_back(tile);
 			}
 
+			void SetGrassField(GrassField* field) {
+				grassField = field;
+			}
+
+			/*
+			With batching on, the scene is sorted by shader, then texture, then
+			mesh, state is only changed when it actually differs from the last
+			object's, and runs of objects sharing all three are drawn instanced,
+			if their shader reads instanceOffset. Turning it off draws everything
+			one at a time in world order, setting everything for every object,
+			to compare against.
+			*/
+			void SetSceneBatching(bool state) {
+				batchScene = state;
+			}
+
+			bool GetSceneBatching() const {
+				return batchScene;
+			}
+
+			const SceneRenderStats& GetSceneStats() const {
+				return sceneStats;
+			}
+
+			//Without one, the object list is built on the render thread
+			void SetJobSystem(JobSystem* jobs) {
+				jobSystem = jobs;
+			}
+
+			void SetWind(float dirX, float dirZ, float speed) {
+				windDirection	= Vector2(dirX, dirZ);
+				windSpeed		= speed;
+			}
+
 		protected:
 			void NewRenderLines();
 			void NewRenderText();
 			void NewRenderTextures();
 
 			void RenderFrame(float dt)	override;
+			void UpdateFrameUniforms(float dt);
 			void RenderGrassTiles(float dt);
 
 			OGLShader*		defaultShader;
 
 			GameWorld&	gameWorld;
 
+			void UpdateShadowMatrices();
 			void BuildObjectList();
 			void SortObjectList();
 			void RenderShadowMap();
 			void RenderCamera(); 
 			void RenderSkybox();
 
+			static size_t RunLength(const vector<SceneDrawItem>& queue, size_t start, bool meshOnly);
+			void	DrawSceneMesh(const OGLMesh& mesh, int instanceCount);
+
 			void LoadSkybox();
 
 			void SetDebugStringBufferSizes(size_t newVertCount);
 			void SetDebugLineBufferSizes(size_t newVertCount);
 
-			vector<const RenderObject*> activeObjects;
+			/*
+			What each thread BuildObjectList runs on writes out, so threads never
+			share anything they write to - aligned so that their vectors don't
+			share a cache line either.
+			*/
+			struct alignas(64) ThreadPackets {
+				vector<SceneDrawItem>	camera;
+				vector<SceneDrawItem>	shadow;
+				int						objects = 0;
+			};
+			static const int ObjectBatchSize = 64;
+
+			JobSystem*				jobSystem = nullptr;
+			vector<ThreadPackets>	threadPackets;
+			vector<SceneDrawItem>	cameraQueue;
+			vector<SceneDrawItem>	shadowQueue;
+			vector<SceneInstance>	sceneInstances;	//The camera queue's, then the shadow queue's
+
+			//Has to match the Instances binding in scene.vert and shadow.vert - the grass has 0 to 7
+			static const GLuint SceneInstanceBinding = 8;
+			GLuint				sceneInstanceSSBO;
+			bool				batchScene = true;
+			SceneRenderStats	sceneStats;
 
 			OGLShader*  debugShader;
 			OGLShader*  skyboxShader;
@@ -73,11 +188,19 @@ namespace NCL {
 			GLuint		shadowTex;
 			GLuint		shadowFBO;
 			Matrix4     shadowMatrix;
+			Matrix4		shadowViewProj;
 
 			Vector4		lightColour;
 			float		lightRadius;
 			Vector3		lightPosition;
 
+			Vector2		windDirection	= Vector2(1.0f, -0.75f);
+			float		windSpeed		= 0.3f;
+
+			//Bound to FrameDataBinding for the whole time, every shader including frameData.glsl reads from it
+			static const GLuint FrameDataBinding = 0;
+			GLuint		frameUBO;
+
 			//Debug data storage things
 			vector<Vector3> debugLineData;
 
@@ -95,6 +218,7 @@ namespace NCL {
 			GLuint textTexVBO;
 			size_t textCount;
 			vector<GrassTile*> grassTiles;
+			GrassField* grassField = nullptr;
 		};
 	}
 }
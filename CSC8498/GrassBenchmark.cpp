@@ -0,0 +1,350 @@
+#include "GrassBenchmark.h"
+#include "PerfLog.h"
+#include "Assets.h"
+#include <iomanip>
+
+using namespace NCL;
+using namespace CSC8503;
+
+namespace {
+	//Shortest way round from a to b, in degrees
+	float AngleDifference(float a, float b) {
+		float diff = std::fmod(b - a, 360.0f);
+		if (diff > 180.0f) {
+			diff -= 360.0f;
+		}
+		else if (diff < -180.0f) {
+			diff += 360.0f;
+		}
+		return diff;
+	}
+
+	bool ParseBool(const std::string& value, bool& out) {
+		if (value == "on" || value == "true" || value == "1") {
+			out = true;
+			return true;
+		}
+		if (value == "off" || value == "false" || value == "0") {
+			out = false;
+			return true;
+		}
+		return false;
+	}
+
+	bool ParseSetting(const std::string& key, const std::string& value, GrassScenario& s, std::string& pathFile) {
+		try {
+			if (key == "name") {
+				s.name = value;
+			}
+			else if (key == "mode") {
+				if		(value == "compute")	{ s.mode = GrassMode::Compute; }
+				else if (value == "cpu")		{ s.mode = GrassMode::CPUInstanced; }
+				else {
+					return false;
+				}
+			}
+			else if (key == "ordering") {
+				if		(value == "bitonic")		{ s.ordering = GrassOrdering::Bitonic; }
+				else if (value == "bitonic-local")	{ s.ordering = GrassOrdering::BitonicLocal; }
+				else if (value == "cells")			{ s.ordering = GrassOrdering::CellBuckets; }
+				else {
+					return false;
+				}
+			}
+			else if (key == "radius")	{ s.loadRadius	= std::stoi(value); }
+			else if (key == "blades")	{ s.bladesPerTile = std::stoi(value); }
+			else if (key == "slices")	{ s.windSlices	= std::stoi(value); }
+			else if (key == "seed")		{ s.seed		= (uint32_t)std::stoul(value); }
+			else if (key == "warmup")	{ s.warmup		= std::stof(value); }
+			else if (key == "duration")	{ s.duration	= std::stof(value); }
+			else if (key == "voronoi")	{ return ParseBool(value, s.voronoi); }
+			else if (key == "wind")		{ return ParseBool(value, s.wind); }
+			else if (key == "path")		{ pathFile		= value; }
+			else {
+				return false;
+			}
+		}
+		catch (const std::exception&) {
+			return false;
+		}
+		return true;
+	}
+
+	//Tries the name as it is, then in the asset data folder
+	bool OpenInput(const std::string& filename, std::ifstream& file) {
+		file.open(filename);
+		if (!file) {
+			file.clear();
+			file.open(Assets::DATADIR + filename);
+		}
+		return (bool)file;
+	}
+}
+
+bool CameraPath::Load(const std::string& filename) {
+	std::ifstream file;
+	if (!OpenInput(filename, file)) {
+		std::cout << __FUNCTION__ << ": Can't open camera path " << filename << "!" << std::endl;
+		return false;
+	}
+	keys.clear();
+	std::string line;
+	while (std::getline(file, line)) {
+		line = line.substr(0, line.find('#'));
+		std::istringstream values(line);
+		CameraKey key;
+		if (values >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.pitch >> key.yaw) {
+			keys.push_back(key);
+		}
+	}
+	return !keys.empty();
+}
+
+bool CameraPath::Save(const std::string& filename) const {
+	std::ofstream file(filename);
+	if (!file) {
+		std::cout << __FUNCTION__ << ": Can't open " << filename << " for writing!" << std::endl;
+		return false;
+	}
+	file << "# time x y z pitch yaw\n";
+	for (const CameraKey& k : keys) {
+		file << k.time << " " << k.position.x << " " << k.position.y << " " << k.position.z << " " << k.pitch << " " << k.yaw << "\n";
+	}
+	return true;
+}
+
+void CameraPath::AddKey(float time, const Camera& camera) {
+	keys.push_back({ time, camera.GetPosition(), camera.GetPitch(), camera.GetYaw() });
+}
+
+void CameraPath::Apply(float time, Camera& camera) const {
+	if (keys.empty()) {
+		return;
+	}
+	float duration = GetDuration();
+	if (time > duration && duration > 0.0f) {
+		time = std::fmod(time, duration);
+	}
+	auto next = std::upper_bound(keys.begin(), keys.end(), time, [](float t, const CameraKey& k) {
+		return t < k.time;
+	});
+	if (next == keys.begin() || next == keys.end()) {
+		const CameraKey& k = (next == keys.end()) ? keys.back() : keys.front();
+		camera.SetPosition(k.position).SetPitch(k.pitch).SetYaw(k.yaw);
+		return;
+	}
+	const CameraKey& a = *(next - 1);
+	const CameraKey& b = *next;
+	float t = (b.time > a.time) ? (time - a.time) / (b.time - a.time) : 1.0f;
+
+	float yaw = a.yaw + AngleDifference(a.yaw, b.yaw) * t;
+	if (yaw < 0.0f) {
+		yaw += 360.0f;
+	}
+	camera.SetPosition(a.position + (b.position - a.position) * t)
+		.SetPitch(a.pitch + (b.pitch - a.pitch) * t)
+		.SetYaw(yaw);
+}
+
+CameraPath CameraPath::Orbit(const Vector3& centre, float radius, float height, float duration) {
+	CameraPath path;
+	const int	keyCount	= 72;
+	float		pitch		= -Maths::RadiansToDegrees(std::atan2(height, radius));
+	for (int i = 0; i <= keyCount; ++i) {
+		float t		= i / (float)keyCount;
+		float angle = t * 360.0f;
+		float rads	= Maths::DegreesToRadians(angle);
+		Vector3 position = centre + Vector3(std::sin(rads) * radius, height, std::cos(rads) * radius);
+		path.keys.push_back({ t * duration, position, pitch, angle });
+	}
+	return path;
+}
+
+GrassBenchmark::GrassBenchmark(const std::vector<GrassScenario>& scenarios, const CameraPath& path) : scenarios(scenarios), path(path) {
+}
+
+bool GrassBenchmark::LoadScenarios(const std::string& filename, std::vector<GrassScenario>& scenarios, std::string& pathFile) {
+	std::ifstream file;
+	if (!OpenInput(filename, file)) {
+		std::cout << __FUNCTION__ << ": Can't open " << filename << "!" << std::endl;
+		return false;
+	}
+	GrassScenario defaults;
+	std::string line;
+	for (int lineNumber = 1; std::getline(file, line); ++lineNumber) {
+		line = line.substr(0, line.find('#'));
+		std::istringstream settings(line);
+
+		GrassScenario s = defaults;
+		s.name.clear();
+		bool anySettings = false;
+		std::string setting;
+		while (settings >> setting) {
+			size_t split = setting.find('=');
+			std::string key		= setting.substr(0, split);
+			std::string value	= split == std::string::npos ? "" : setting.substr(split + 1);
+			if (!ParseSetting(key, value, s, pathFile)) {
+				std::cout << filename << "(" << lineNumber << "): don't know what to do with " << setting << std::endl;
+				return false;
+			}
+			anySettings = true;
+		}
+		if (s.bladesPerTile <= 0 || (s.bladesPerTile & (s.bladesPerTile - 1)) != 0) {
+			std::cout << filename << "(" << lineNumber << "): blades has to be a power of two" << std::endl;
+			return false;
+		}
+		if (!anySettings) {
+			continue;
+		}
+		if (s.name.empty()) {
+			defaults = s;
+		}
+		else {
+			scenarios.push_back(s);
+		}
+	}
+	return !scenarios.empty();
+}
+
+bool GrassBenchmark::NextScenario() {
+	if (current + 1 >= (int)scenarios.size()) {
+		return false;
+	}
+	current++;
+	step	= 0;
+	time	= 0.0f;
+	frames.clear();
+	return true;
+}
+
+bool GrassBenchmark::Step(Camera& camera, float lastFrameTime, const GrassLODStats& lastGrassStats) {
+	const GrassScenario& scenario = GetScenario();
+
+	//The frame that's just finished was drawn at the last step's time
+	if (step > 0 && time >= scenario.warmup) {
+		FrameRecord r;
+		r.frameTime		= lastFrameTime;
+		r.grassCPUMS	= lastGrassStats.drawMS;
+		r.windMS		= lastGrassStats.windMS;
+		r.orderingGPUMS = lastGrassStats.orderingMS;
+		r.samplesPassed = lastGrassStats.samplesPassed;
+		r.instances		= lastGrassStats.TotalInstances();
+		r.tiles			= 0;
+		for (int tiles : lastGrassStats.tiles) {
+			r.tiles += tiles;
+		}
+		frames.push_back(r);
+	}
+
+	time = step * stepTime;
+	step++;
+	if (time > scenario.warmup + scenario.duration) {
+		FinishScenario();
+		return false;
+	}
+	path.Apply(time, camera);
+	return true;
+}
+
+void GrassBenchmark::FinishScenario() {
+	GrassScenarioResult r;
+	r.scenario	= GetScenario();
+	r.frames	= (int)frames.size();
+
+	std::vector<float> frameMS;
+	double total = 0.0;
+	for (const FrameRecord& f : frames) {
+		frameMS.push_back(f.frameTime * 1000.0f);
+		total += f.frameTime * 1000.0f;
+		r.over60		+= f.frameTime > PerfLogWriter::hz60Budget;
+		r.over120		+= f.frameTime > PerfLogWriter::hz120Budget;
+		r.grassCPUMS	+= f.grassCPUMS;
+		r.windMS		+= f.windMS;
+		r.orderingGPUMS += f.orderingGPUMS;
+		r.samplesPassed += (double)f.samplesPassed;
+		r.instances		+= f.instances;
+		r.tiles			+= f.tiles;
+	}
+	if (!frames.empty()) {
+		std::sort(frameMS.begin(), frameMS.end());
+		float count = (float)frames.size();
+		r.meanMS		= (float)(total / count);
+		r.p50MS			= PerfLogWriter::Percentile(frameMS, 0.5);
+		r.p90MS			= PerfLogWriter::Percentile(frameMS, 0.9);
+		r.p99MS			= PerfLogWriter::Percentile(frameMS, 0.99);
+		r.maxMS			= frameMS.back();
+		r.grassCPUMS	/= count;
+		r.windMS		/= count;
+		r.orderingGPUMS /= count;
+		r.samplesPassed /= count;
+		r.instances		/= count;
+		r.tiles			/= count;
+	}
+	results.push_back(r);
+
+	std::cout << "Grass benchmark: finished " << r.scenario.name << ", " << r.frames << " frames, "
+		<< r.meanMS << "ms mean, " << r.p99MS << "ms p99" << std::endl;
+}
+
+void GrassBenchmark::PrintTable(std::ostream& out) const {
+	out << std::left << std::setw(24) << "Scenario" << std::right
+		<< std::setw(9) << "Mode" << std::setw(8) << "Tiles" << std::setw(10) << "Blades"
+		<< std::setw(8) << "Frames" << std::setw(8) << "Mean" << std::setw(8) << "P50"
+		<< std::setw(8) << "P90" << std::setw(8) << "P99" << std::setw(8) << "Max"
+		<< std::setw(7) << ">60Hz" << std::setw(8) << ">120Hz"
+		<< std::setw(10) << "GrassCPU" << std::setw(8) << "Wind" << std::setw(10) << "OrderGPU"
+		<< std::setw(10) << "vs first" << std::endl;
+
+	out << std::fixed;
+	float baseline = results.empty() ? 0.0f : results[0].meanMS;
+	for (const GrassScenarioResult& r : results) {
+		float change = baseline > 0.0f ? (r.meanMS / baseline - 1.0f) * 100.0f : 0.0f;
+		out << std::left << std::setw(24) << r.scenario.name << std::right
+			<< std::setw(9) << (r.scenario.mode == GrassMode::Compute ? "compute" : "cpu")
+			<< std::setprecision(1) << std::setw(8) << r.tiles << std::setprecision(0) << std::setw(10) << r.instances
+			<< std::setw(8) << r.frames << std::setprecision(2)
+			<< std::setw(8) << r.meanMS << std::setw(8) << r.p50MS << std::setw(8) << r.p90MS
+			<< std::setw(8) << r.p99MS << std::setw(8) << r.maxMS
+			<< std::setw(7) << r.over60 << std::setw(8) << r.over120
+			<< std::setprecision(3) << std::setw(10) << r.grassCPUMS << std::setw(8) << r.windMS << std::setw(10) << r.orderingGPUMS
+			<< std::setprecision(1) << std::showpos << std::setw(9) << change << "%" << std::noshowpos << std::endl;
+	}
+	out << std::defaultfloat << std::setprecision(6);
+}
+
+bool GrassBenchmark::WriteResults(const std::string& directory, const std::string& dateTime) const {
+	std::string name = directory + "GrassBenchmark_" + dateTime;
+
+	std::ofstream table(name + ".txt");
+	std::ofstream json(name + ".json");
+	if (!table || !json) {
+		std::cout << __FUNCTION__ << ": Can't open " << name << ".txt / .json for writing!" << std::endl;
+		return false;
+	}
+	PrintTable(table);
+
+	json << "{\n";
+	json << "\t\"stepTime\": " << stepTime << ",\n";
+	json << "\t\"scenarios\": [\n";
+	for (size_t i = 0; i < results.size(); ++i) {
+		const GrassScenarioResult& r = results[i];
+		const GrassScenario& s = r.scenario;
+		json << "\t\t{\n";
+		json << "\t\t\t\"name\": \"" << s.name << "\",\n";
+		json << "\t\t\t\"mode\": \"" << (s.mode == GrassMode::Compute ? "compute" : "cpu") << "\",\n";
+		json << "\t\t\t\"loadRadius\": " << s.loadRadius << ", \"bladesPerTile\": " << s.bladesPerTile
+			<< ", \"ordering\": \"" << GrassOrderingName(s.ordering) << "\", \"voronoi\": " << (s.voronoi ? "true" : "false")
+			<< ", \"wind\": " << (s.wind ? "true" : "false") << ", \"windSlices\": " << s.windSlices << ",\n";
+		json << "\t\t\t\"frames\": " << r.frames << ", \"meanMS\": " << r.meanMS << ", \"p50MS\": " << r.p50MS
+			<< ", \"p90MS\": " << r.p90MS << ", \"p99MS\": " << r.p99MS << ", \"maxMS\": " << r.maxMS << ",\n";
+		json << "\t\t\t\"framesOver60\": " << r.over60 << ", \"framesOver120\": " << r.over120 << ",\n";
+		json << "\t\t\t\"grassCPUMS\": " << r.grassCPUMS << ", \"windMS\": " << r.windMS << ", \"orderingGPUMS\": " << r.orderingGPUMS
+			<< ", \"samplesPassed\": " << r.samplesPassed << ", \"instances\": " << r.instances << ", \"tiles\": " << r.tiles << "\n";
+		json << "\t\t}" << (i + 1 < results.size() ? ",\n" : "\n");
+	}
+	json << "\t]\n";
+	json << "}\n";
+
+	std::cout << "Grass benchmark results written to " << name << ".txt / .json" << std::endl;
+	return true;
+}
@@ -0,0 +1,163 @@
+#pragma once
+#include "GrassField.h"
+
+namespace NCL {
+	namespace CSC8503 {
+		struct CameraKey {
+			float	time;
+			Vector3	position;
+			float	pitch;
+			float	yaw;
+		};
+
+		/*
+		A camera flight, as keyframes the camera is moved between in straight
+		lines, turning the shortest way round. As a file, it's a keyframe a
+		line, in time order:
+
+			time x y z pitch yaw
+
+		with anything after a # ignored.
+		*/
+		class CameraPath {
+		public:
+			bool Load(const std::string& filename);
+			bool Save(const std::string& filename) const;
+
+			//Keys have to be added in time order
+			void AddKey(float time, const Camera& camera);
+
+			void Clear() {
+				keys.clear();
+			}
+
+			bool IsEmpty() const {
+				return keys.empty();
+			}
+
+			float GetDuration() const {
+				return keys.empty() ? 0.0f : keys.back().time;
+			}
+
+			//Before the first key the camera sits on it, and after the last the path loops
+			void Apply(float time, Camera& camera) const;
+
+			//Circles the centre, looking in at it
+			static CameraPath Orbit(const Vector3& centre, float radius, float height, float duration);
+
+		protected:
+			std::vector<CameraKey> keys;
+		};
+
+		//Everything one benchmark run sets up the grass with
+		struct GrassScenario {
+			std::string		name;
+			GrassMode		mode			= GrassMode::Compute;
+			int				loadRadius		= 2;
+			int				bladesPerTile	= GrassTile::defaultBlades;
+			GrassOrdering	ordering		= GrassOrdering::CellBuckets;
+			bool			voronoi			= true;
+			bool			wind			= true;
+			int				windSlices		= 1;
+			uint32_t		seed			= 8498;
+			float			warmup			= 3.0f;		//Seconds flown before recording starts, so tiles can stream in
+			float			duration		= 20.0f;	//Seconds recorded
+		};
+
+		struct GrassScenarioResult {
+			GrassScenario	scenario;
+			int				frames			= 0;
+
+			float			meanMS			= 0.0f;
+			float			p50MS			= 0.0f;
+			float			p90MS			= 0.0f;
+			float			p99MS			= 0.0f;
+			float			maxMS			= 0.0f;
+			int				over60			= 0;	//Frames over the 60hz budget
+			int				over120			= 0;
+
+			//Averages per frame
+			float			grassCPUMS		= 0.0f;	//GrassField::Draw, wind included
+			float			windMS			= 0.0f;
+			float			orderingGPUMS	= 0.0f;
+			double			samplesPassed	= 0.0;
+			double			instances		= 0.0;
+			double			tiles			= 0.0;
+		};
+
+		/*
+		Flies the camera along the same path, at the same fixed step every
+		frame, for each scenario in turn, so every scenario draws exactly the
+		same views however fast or slow it runs - only the frame times change.
+
+		Each frame, Step puts the camera where the path says, and records the
+		stats of the frame before it (which is the latest the renderer has).
+		The game is left to rebuild the grass for each scenario - see
+		TutorialGame::StartScenario.
+
+		A scenario file has a scenario a line, as key=value settings:
+
+			name=compute-cells mode=compute radius=2 ordering=cells
+
+		A line without a name doesn't add a scenario, but changes the defaults
+		for every scenario after it. path=file flies a recorded CameraPath
+		rather than circling the field. See Assets/Data/grassBenchmark.txt.
+		*/
+		class GrassBenchmark {
+		public:
+			static constexpr float stepTime = 1.0f / 60.0f;
+
+			GrassBenchmark(const std::vector<GrassScenario>& scenarios, const CameraPath& path);
+			~GrassBenchmark() {}
+
+			static bool LoadScenarios(const std::string& filename, std::vector<GrassScenario>& scenarios, std::string& pathFile);
+
+			//Moves on to the next scenario, false once they've all been run
+			bool NextScenario();
+
+			const GrassScenario& GetScenario() const {
+				return scenarios[current];
+			}
+
+			//Path time, which the game should use in place of dt, so the wind comes out the same every run
+			float GetTime() const {
+				return time;
+			}
+
+			//true while the current scenario is still going
+			bool Step(Camera& camera, float lastFrameTime, const GrassLODStats& lastGrassStats);
+
+			const std::vector<GrassScenarioResult>& GetResults() const {
+				return results;
+			}
+
+			//Each scenario's mean frame time is compared against the first's
+			void PrintTable(std::ostream& out) const;
+
+			//The table, plus the same as JSON
+			bool WriteResults(const std::string& directory, const std::string& dateTime) const;
+
+		protected:
+			struct FrameRecord {
+				float		frameTime;
+				float		grassCPUMS;
+				float		windMS;
+				float		orderingGPUMS;
+				uint64_t	samplesPassed;
+				int			instances;
+				int			tiles;
+			};
+
+			void FinishScenario();
+
+			std::vector<GrassScenario>			scenarios;
+			std::vector<GrassScenarioResult>	results;
+			CameraPath							path;
+
+			int		current	= -1;
+			int		step	= 0;
+			float	time	= 0.0f;
+			std::vector<FrameRecord> frames;
+		};
+	}
+}
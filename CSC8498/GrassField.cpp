@@ -0,0 +1,382 @@
+#include "GrassField.h"
+
+using namespace NCL;
+using namespace CSC8503;
+
+GrassField::GrassField(GrassMode mode, GameWorld* gameWorld, Window* window, JobSystem* jobs, uint32_t seed, int loadRadius, int bladesPerTile) {
+	this->mode		= (mode == GrassMode::PerBlade) ? GrassMode::CPUInstanced : mode;
+	this->gameWorld	= gameWorld;
+	this->window	= window;
+	this->seed		= seed;
+	this->bladesPerTile = bladesPerTile;
+
+	jobSystem		= jobs;
+	tileSize		= GrassTile::defaultSize;
+	tileHeight		= 2.0f;
+	uploadsPerFrame	= 1;
+	maxGenerating	= jobs ? std::max(jobs->GetThreadCount() - 1, 1) : 1;
+
+	SetLoadRadius(loadRadius);
+	SetLODDistances(tileSize * 0.5f, tileSize * 1.5f);
+	SetLODHysteresis(tileSize * 0.1f);
+
+	assets = GrassTile::LoadAssets();
+}
+
+GrassField::~GrassField() {
+	//Background jobs write into their tiles, so none of them can go until their job has finished
+	for (FieldTile* t : allTiles) {
+		while (!t->counter.IsDone()) {
+			std::this_thread::yield();
+		}
+		delete t->tile;
+		delete t;
+	}
+	delete assets.cubeMesh;
+	delete assets.grassBladeMesh;
+	delete assets.midBladeMesh;
+	delete assets.farBladeMesh;
+	delete assets.tileShader;
+	delete assets.bladeShader;
+	delete assets.instBladeShader;
+	delete assets.cpuBladeShader;
+	delete assets.bladeCompShader;
+	delete assets.sortBladeComp;
+	delete assets.cullBladeComp;
+	delete assets.grassTex;
+	delete assets.windTexture;
+}
+
+GrassField::TileCoord GrassField::ToTileCoord(const Vector3& pos) const {
+	return TileCoord((int)std::floor(pos.x / tileSize + 0.5f), (int)std::floor(pos.z / tileSize + 0.5f));
+}
+
+Vector3 GrassField::TileCentre(const TileCoord& coord) const {
+	return Vector3(coord.first * tileSize, tileHeight, coord.second * tileSize);
+}
+
+//Mixes the grid position into the field's seed, so neighbouring tiles don't look alike
+uint32_t GrassField::TileSeed(const TileCoord& coord) const {
+	uint32_t h = seed;
+	h ^= (uint32_t)coord.first * 0x9E3779B1u;
+	h = (h ^ (h >> 16)) * 0x85EBCA6Bu;
+	h ^= (uint32_t)coord.second * 0xC2B2AE35u;
+	h = (h ^ (h >> 13)) * 0x27D4EB2Fu;
+	return h ^ (h >> 16);
+}
+
+//How far pos is from the nearest point of the tile, ignoring height
+float GrassField::TileDistance(const TileCoord& coord, const Vector3& pos) const {
+	Vector3 centre		= TileCentre(coord);
+	float halfSize		= tileSize * 0.5f;
+	float x = std::max(std::abs(pos.x - centre.x) - halfSize, 0.0f);
+	float z = std::max(std::abs(pos.z - centre.z) - halfSize, 0.0f);
+	return std::sqrt(x * x + z * z);
+}
+
+/*
+The tile's blades reach from its centre out to its corners, and up to
+cullRadius above and around that, so a sphere big enough for all of that
+is never culled while any of its blades could still be seen.
+*/
+bool GrassField::TileInFrustum(const TileCoord& coord, const GrassTile* tile, const Frustum& frustum) const {
+	float radius = tileSize * 0.5f * std::sqrt(2.0f) + tile->GetCullRadius();
+	return frustum.SphereInsideFrustum(TileCentre(coord), radius);
+}
+
+GrassLOD GrassField::ChooseLOD(GrassLOD current, float distance) const {
+	int lod = (int)current;
+	while (lod < GrassLODCount - 1 && distance > lodDistances[lod] + lodHysteresis) {
+		lod++;
+	}
+	while (lod > 0 && distance < lodDistances[lod - 1] - lodHysteresis) {
+		lod--;
+	}
+	return (GrassLOD)lod;
+}
+
+void GrassField::UpdateLODs(const Vector3& cameraPos) {
+	for (const auto& [coord, t] : tiles) {
+		GrassTile* tile = t->tile;
+		tile->SetLOD(ChooseLOD(tile->GetLOD(), TileDistance(coord, cameraPos)));
+	}
+}
+
+int GrassField::GetActiveTileCount() const {
+	int count = 0;
+	for (const auto& [coord, t] : tiles) {
+		count += (t->state == TileState::Active);
+	}
+	return count;
+}
+
+int GrassField::GetPendingTileCount() const {
+	return (int)tiles.size() - GetActiveTileCount();
+}
+
+GrassField::FieldTile* GrassField::AcquireTile() {
+	if (!pool.empty()) {
+		FieldTile* t = pool.back();
+		pool.pop_back();
+		return t;
+	}
+	FieldTile* t = new FieldTile();
+	t->tile = new GrassTile(mode, assets, gameWorld, window, bladesPerTile);
+	ApplySettings(t);
+	allTiles.push_back(t);
+	return t;
+}
+
+//A tile's background job owns its blades (and their wind) until it's done, so busy tiles are left alone
+bool GrassField::IsTileBusy(const FieldTile* t) const {
+	return !t->counter.IsDone();
+}
+
+//The field's settings can change while a tile is busy, so every tile gets them again just before it's uploaded
+void GrassField::ApplySettings(FieldTile* t) {
+	t->tile->SetOrdering(ordering);
+	t->tile->SetGPUStats(gpuStats);
+	t->tile->SetWindSlices(windSlices);
+	t->tile->SetVoronoi(voronoi);
+	t->tile->SetWind(wind);
+}
+
+void GrassField::SetOrdering(GrassOrdering newOrdering) {
+	ordering = newOrdering;
+	for (FieldTile* t : allTiles) {
+		if (!IsTileBusy(t)) {
+			t->tile->SetOrdering(ordering);
+		}
+	}
+}
+
+void GrassField::SetGPUStats(bool state) {
+	gpuStats = state;
+	for (FieldTile* t : allTiles) {
+		if (!IsTileBusy(t)) {
+			t->tile->SetGPUStats(gpuStats);
+		}
+	}
+}
+
+void GrassField::SetVoronoi(bool state) {
+	voronoi = state;
+	for (FieldTile* t : allTiles) {
+		if (!IsTileBusy(t)) {
+			t->tile->SetVoronoi(voronoi);
+		}
+	}
+}
+
+void GrassField::SetWind(bool state) {
+	wind = state;
+	for (FieldTile* t : allTiles) {
+		if (!IsTileBusy(t)) {
+			t->tile->SetWind(wind);
+		}
+	}
+}
+
+void GrassField::SetWindSlices(int count) {
+	windSlices = std::max(count, 1);
+	for (FieldTile* t : allTiles) {
+		if (!IsTileBusy(t)) {
+			t->tile->SetWindSlices(windSlices);
+		}
+	}
+}
+
+void GrassField::ReleaseTile(FieldTile* t) {
+	pool.push_back(t);
+}
+
+void GrassField::StartGenerating(FieldTile* t, const TileCoord& coord) {
+	t->coord = coord;
+	t->state = TileState::Generating;
+	t->tile->SetSeed(TileSeed(coord));
+	t->tile->MoveTo(TileCentre(coord));
+	t->tile->SetLOD(GrassLOD::Near);
+
+	if (jobSystem) {
+		GrassTile* tile = t->tile;
+		jobSystem->SubmitBackground([tile](int /*threadIndex*/) {
+			tile->GenerateFieldData();
+		}, &t->counter);
+	}
+	else {
+		t->tile->GenerateFieldData();
+	}
+}
+
+/*
+Tiles are only dropped once they're a tile further out than loadRadius, so
+a camera sitting right on a tile boundary doesn't keep swapping the same
+row of tiles in and out.
+*/
+void GrassField::RetireDistantTiles(const TileCoord& centre) {
+	int keepRadius = loadRadius + 1;
+	for (auto i = tiles.begin(); i != tiles.end(); ) {
+		const TileCoord& coord = i->first;
+		if (std::abs(coord.first - centre.first) <= keepRadius && std::abs(coord.second - centre.second) <= keepRadius) {
+			++i;
+			continue;
+		}
+		FieldTile* t = i->second;
+		if (t->state == TileState::Generating) {
+			retiring.push_back(t);
+		}
+		else {
+			ReleaseTile(t);
+		}
+		i = tiles.erase(i);
+	}
+}
+
+//Nearest missing tiles first, for as many as there's room for
+void GrassField::RequestNearbyTiles(const TileCoord& centre) {
+	bool async = jobSystem && jobSystem->GetThreadCount() > 1;
+
+	int generating = (int)retiring.size();
+	for (const auto& [coord, t] : tiles) {
+		generating += (t->state == TileState::Generating);
+	}
+	//Without any workers, tiles are generated right here, so only a few a frame
+	int budget = async ? maxGenerating - generating : uploadsPerFrame;
+	if (budget <= 0) {
+		return;
+	}
+
+	std::vector<TileCoord> missing;
+	for (int x = -loadRadius; x <= loadRadius; ++x) {
+		for (int z = -loadRadius; z <= loadRadius; ++z) {
+			TileCoord coord(centre.first + x, centre.second + z);
+			if (tiles.find(coord) == tiles.end()) {
+				missing.push_back(coord);
+			}
+		}
+	}
+	auto distance = [&](const TileCoord& c) {
+		int x = c.first - centre.first;
+		int z = c.second - centre.second;
+		return x * x + z * z;
+	};
+	std::sort(missing.begin(), missing.end(), [&](const TileCoord& a, const TileCoord& b) {
+		return distance(a) < distance(b);
+	});
+
+	for (const TileCoord& coord : missing) {
+		if (budget-- <= 0) {
+			break;
+		}
+		FieldTile* t = AcquireTile();
+		tiles[coord] = t;
+		StartGenerating(t, coord);
+	}
+}
+
+void GrassField::UploadReadyTiles(const Vector3& cameraPos) {
+	std::vector<FieldTile*> ready;
+	for (const auto& [coord, t] : tiles) {
+		if (t->state == TileState::Ready) {
+			ready.push_back(t);
+		}
+	}
+	auto distance = [&](const FieldTile* t) {
+		return Vector::LengthSquared(TileCentre(t->coord) - cameraPos);
+	};
+	std::sort(ready.begin(), ready.end(), [&](const FieldTile* a, const FieldTile* b) {
+		return distance(a) < distance(b);
+	});
+
+	int uploads = std::min((int)ready.size(), uploadsPerFrame);
+	for (int i = 0; i < uploads; ++i) {
+		ApplySettings(ready[i]);
+		ready[i]->tile->UploadFieldData();
+		ready[i]->state = TileState::Active;
+	}
+}
+
+void GrassField::Update(const Vector3& cameraPos) {
+	PROFILE_SCOPE("GrassField::Update");
+	for (size_t i = 0; i < retiring.size(); ) {
+		if (retiring[i]->counter.IsDone()) {
+			ReleaseTile(retiring[i]);
+			retiring[i] = retiring.back();
+			retiring.pop_back();
+		}
+		else {
+			++i;
+		}
+	}
+	for (const auto& [coord, t] : tiles) {
+		if (t->state == TileState::Generating && t->counter.IsDone()) {
+			t->state = TileState::Ready;
+		}
+	}
+
+	TileCoord centre = ToTileCoord(cameraPos);
+	RetireDistantTiles(centre);
+	RequestNearbyTiles(centre);
+	UploadReadyTiles(cameraPos);
+	UpdateLODs(cameraPos);
+}
+
+void GrassField::Draw(GLuint* shadowTex, float dt) {
+	PROFILE_SCOPE("GrassField::Draw");
+	GameTimer drawTimer;
+	PerspectiveCamera& camera = gameWorld->GetMainCamera();
+	Frustum frustum = Frustum::FromViewProjMatrix(camera.BuildProjectionMatrix(window->GetScreenAspect()) * camera.BuildViewMatrix());
+
+	int checkedTiles	= 0;
+	int mismatches		= 0;
+
+	lodStats = GrassLODStats();
+
+	//What the renderer passes as dt is really the time since the game started (the shaders
+	//animate their wind with it too), so the step since last frame comes from the last one
+	float windStep = std::max(dt - windTime, 0.0f);
+	windTime = dt;
+	GameTimer windTimer;
+	for (const auto& [coord, t] : tiles) {
+		if (t->state != TileState::Active) {
+			continue;
+		}
+		if (!TileInFrustum(coord, t->tile, frustum)) {
+			lodStats.culledTiles++;
+			continue;
+		}
+		int lod = (int)t->tile->GetLOD();
+		lodStats.tiles[lod]++;
+		lodStats.instances[lod] += t->tile->GetInstanceCount();
+
+		if (!t->tile->GetIsCompute()) {
+			windTimer.Tick();
+			t->tile->UpdateWind(windTime, windStep);
+			windTimer.Tick();
+			lodStats.windMS += windTimer.GetTimeDeltaMSec();
+		}
+		t->tile->DrawTile(shadowTex, &frustum);
+		//A tile whose queries didn't come back this frame isn't counted, rather than counting an old result again
+		if (t->tile->GetIsCompute()) {
+			lodStats.orderingDispatches	+= t->tile->GetOrderingDispatches();
+			if (t->tile->HasOrderingMS()) {
+				lodStats.orderingMS += t->tile->GetOrderingMS();
+				lodStats.timedTiles++;
+			}
+		}
+		if (t->tile->HasSamplesPassed()) {
+			lodStats.samplesPassed += t->tile->GetSamplesPassed();
+			lodStats.sampledTiles++;
+		}
+
+		if (verifyCulling && t->tile->GetIsCompute()) {
+			mismatches += t->tile->VerifyCulling(frustum);
+			checkedTiles++;
+		}
+	}
+	if (verifyCulling) {
+		std::cout << "Grass culling checked on " << checkedTiles << " tiles, " << mismatches << " blades differ from the CPU cull" << std::endl;
+		verifyCulling = false;
+	}
+	lodStats.drawMS = (float)drawTimer.GetTotalTimeMSec();
+}
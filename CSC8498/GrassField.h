@@ -0,0 +1,205 @@
+#pragma once
+#include "GrassTile.h"
+#include "JobSystem.h"
+
+namespace NCL {
+	namespace CSC8503 {
+		/*
+		Covers the world in a grid of GrassTiles, but only keeps the ones
+		within loadRadius tiles of the camera around, bringing new ones in
+		and dropping old ones as the camera moves.
+
+		A new tile's blades / noise maps are generated as a background job,
+		so the frame never has to wait for them - it just keeps drawing
+		whatever's ready. Once a tile's data is done, it gets uploaded on the
+		render thread, no more than uploadsPerFrame tiles a frame, nearest
+		first. Tiles that drop out of range go back into a pool with their
+		SSBOs, textures and CPU side vectors intact, ready to be reused for
+		the next tile that comes into range, so streaming doesn't allocate.
+
+		Each tile's seed comes from the field's seed and the tile's grid
+		position, so a tile that's dropped and later brought back comes back
+		exactly the same.
+
+		Field tiles aren't added to the GameWorld - the ground under them is
+		whatever the world already has there.
+
+		Every tile gets a GrassLOD from how far the camera is from its nearest
+		edge. A tile only moves to another LOD once it's lodHysteresis past
+		the boundary between them, so one sitting right on a boundary doesn't
+		flicker between the two.
+
+		Tiles that are entirely outside the camera's frustum aren't drawn at
+		all. The rest cull their own blades on the GPU before drawing them
+		(see GrassTile::CullBlades).
+		*/
+		class GrassField {
+		public:
+			//PerBlade isn't streamable, and gets treated as CPUInstanced instead. bladesPerTile has to be a power of two
+			GrassField(GrassMode mode, GameWorld* gameWorld, Window* window, JobSystem* jobs = nullptr, uint32_t seed = 8498, int loadRadius = 2, int bladesPerTile = GrassTile::defaultBlades);
+			~GrassField();
+
+			//Call once a frame, from the render thread, before Draw
+			void Update(const Vector3& cameraPos);
+
+			void Draw(GLuint* shadowTex, float dt);
+
+			void SetLoadRadius(int radius) {
+				loadRadius = std::max(radius, 0);
+			}
+
+			int GetLoadRadius() const {
+				return loadRadius;
+			}
+
+			//Tiles closer than nearDistance are Near, closer than midDistance Mid, and Far beyond that
+			void SetLODDistances(float nearDistance, float midDistance) {
+				lodDistances[0] = nearDistance;
+				lodDistances[1] = std::max(midDistance, nearDistance);
+			}
+
+			void SetLODHysteresis(float distance) {
+				lodHysteresis = std::max(distance, 0.0f);
+			}
+
+			const GrassLODStats& GetLODStats() const {
+				return lodStats;
+			}
+
+			/*
+			Has the next Draw read back every compute tile's culled blades, and
+			check them against the CPU version of the cull. It stalls the GPU
+			for every tile, so it's a one frame thing.
+			*/
+			void VerifyCullingNextDraw() {
+				verifyCulling = true;
+			}
+
+			void SetOrdering(GrassOrdering newOrdering);
+
+			GrassOrdering GetOrdering() const {
+				return ordering;
+			}
+
+			//The GPU timings and sample counts in GrassLODStats - with them off, no tile makes any queries
+			void SetGPUStats(bool state);
+
+			bool GetGPUStats() const {
+				return gpuStats;
+			}
+
+			//Only affects tiles uploaded after it's set, so best set straight after the field is made
+			void SetVoronoi(bool state);
+
+			bool GetVoronoi() const {
+				return voronoi;
+			}
+
+			void SetWind(bool state);
+
+			bool GetWind() const {
+				return wind;
+			}
+
+			int GetBladesPerTile() const {
+				return bladesPerTile;
+			}
+
+			//Spreads the CPU paths' wind sampling over this many frames (see GrassWind)
+			void SetWindSlices(int count);
+
+			int GetWindSlices() const {
+				return windSlices;
+			}
+
+			void SetUploadsPerFrame(int uploads) {
+				uploadsPerFrame = std::max(uploads, 1);
+			}
+
+			GrassMode GetMode() const {
+				return mode;
+			}
+
+			float GetTileSize() const {
+				return tileSize;
+			}
+
+			int GetActiveTileCount() const;
+			int GetPendingTileCount() const;
+
+			int GetPooledTileCount() const {
+				return (int)pool.size();
+			}
+
+			//Every tile the field has ever made, whether in use or not
+			int GetAllocatedTileCount() const {
+				return (int)allTiles.size();
+			}
+
+		protected:
+			typedef std::pair<int, int> TileCoord;
+
+			enum class TileState {
+				Generating,	//Waiting on its background job
+				Ready,		//Generated, but not uploaded yet
+				Active		//Uploaded, and being drawn
+			};
+
+			struct FieldTile {
+				GrassTile*				tile = nullptr;
+				TileCoord				coord;
+				TileState				state = TileState::Generating;
+				JobSystem::JobCounter	counter;
+			};
+
+			TileCoord	ToTileCoord(const Vector3& pos) const;
+			Vector3		TileCentre(const TileCoord& coord) const;
+			uint32_t	TileSeed(const TileCoord& coord) const;
+
+			float		TileDistance(const TileCoord& coord, const Vector3& pos) const;
+			bool		TileInFrustum(const TileCoord& coord, const GrassTile* tile, const Frustum& frustum) const;
+			GrassLOD	ChooseLOD(GrassLOD current, float distance) const;
+			void		UpdateLODs(const Vector3& cameraPos);
+
+			FieldTile*	AcquireTile();
+			void		ReleaseTile(FieldTile* tile);
+			bool		IsTileBusy(const FieldTile* tile) const;
+			void		ApplySettings(FieldTile* tile);
+
+			void StartGenerating(FieldTile* tile, const TileCoord& coord);
+			void RetireDistantTiles(const TileCoord& centre);
+			void RequestNearbyTiles(const TileCoord& centre);
+			void UploadReadyTiles(const Vector3& cameraPos);
+
+			GrassMode			mode;
+			GrassTileAssets		assets;
+			GameWorld*			gameWorld;
+			Window*				window;
+			JobSystem*			jobSystem;
+
+			uint32_t	seed;
+			float		tileSize;
+			float		tileHeight;
+			int			loadRadius;
+			int			uploadsPerFrame;
+			int			maxGenerating;	//Caps the background jobs, so a fast moving camera doesn't queue up tiles it's already left behind
+
+			float			lodDistances[GrassLODCount - 1];
+			float			lodHysteresis;
+			GrassLODStats	lodStats;
+			bool			verifyCulling = false;
+			GrassOrdering	ordering = GrassOrdering::CellBuckets;
+			bool			gpuStats = true;
+			int				windSlices = 1;
+			bool			voronoi = true;
+			bool			wind = true;
+			int				bladesPerTile;
+			float			windTime = 0.0f;	//As of the last Draw - shared by every tile, so the wind carries on across their edges
+
+			std::map<TileCoord, FieldTile*>	tiles;
+			std::vector<FieldTile*>			retiring;	//Went out of range mid-generation, so waiting for their jobs before going back in the pool
+			std::vector<FieldTile*>			pool;
+			std::vector<FieldTile*>			allTiles;
+		};
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+
+namespace NCL {
+	namespace CSC8503 {
+		/*
+		How much of a tile gets drawn. Each step down draws every Nth blade
+		(see GrassTile::lodStrides) with a simpler blade mesh, so the number
+		of vertices goes down much faster than the number of blades.
+		*/
+		enum class GrassLOD {
+			Near,	//The full blade mesh, every blade
+			Mid,	//A 3 triangle blade, every 4th blade
+			Far		//A single triangle, every 16th blade
+		};
+		const int GrassLODCount = 3;
+
+		//What the field drew last frame, per LOD
+		struct GrassLODStats {
+			int tiles[GrassLODCount]		= {};
+			int instances[GrassLODCount]	= {};	//Before the GPU culls them, so an upper bound
+			int culledTiles					= 0;	//Active, but entirely outside the camera's frustum
+
+			float		orderingMS			= 0.0f;	//GPU time culling and ordering blades, from a few frames ago
+			int			orderingDispatches	= 0;
+			int			timedTiles			= 0;	//Tiles whose ordering time came back this frame, and so are in orderingMS
+			uint64_t	samplesPassed		= 0;	//From a few frames ago too
+			int			sampledTiles		= 0;	//Tiles whose sample count came back this frame
+			float		windMS				= 0.0f;	//CPU time moving the CPU paths' blades on with the wind
+			float		drawMS				= 0.0f;	//CPU time in Draw, wind included
+
+			int TotalInstances() const {
+				int total = 0;
+				for (int i : instances) {
+					total += i;
+				}
+				return total;
+			}
+		};
+	}
+}
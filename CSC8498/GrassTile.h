@@ -1,80 +1,205 @@
 #pragma once
 #include "GameObject.h"
 #include <random>
-#include "../FastNoiseLite/Cpp/FastNoiseLite.h"
 #include "Window.h"
 #include "GameTimer.h"
 #include "GameWorld.h"
 #include "MshLoader.h"
 #include "RenderObject.h"
+#include "GrassFieldGenerator.h"
+#include "GrassWind.h"
+#include "GrassCulling.h"
+#include "GrassSort.h"
+#include "Profiler.h"
+#include "GPUQueryRing.h"
+#include "GrassStats.h"
+#include "OGLShader.h"
+#include "OGLMesh.h"
+#include "OGLTexture.h"
+#include "Debug.h"
 
 namespace NCL {
 	namespace CSC8503 {
 
-		struct GrassBlade {
-			int id;
+		enum class GrassMode {
+			PerBlade,		//A GameObject per blade, drawn one at a time by the renderer
+			CPUInstanced,	//Blades laid out on the CPU, then drawn in a single instanced call
+			Compute			//Blades laid out and sorted by compute shaders
+		};
+
+		/*
+		Everything about one blade the CPU instanced path never changes once
+		it's laid out, packed so the first four floats and the last one can go
+		straight into a pair of vertex attributes (see cpuGrassBlade.vert).
+		The wind noise changes every frame, so it has a buffer of its own.
+		*/
+		struct GrassInstance {
 			Vector3 position;
-			Vector3 faceRotation;
-			float bendAmount;
-			float noiseValue;
+			float	yaw;	//Radians
+			float	bend;
 		};
 
-		struct BladeIndex {
-			float distance;
-			uint32_t index;
+		//How the Near LOD gets its blades into front to back order
+		enum class GrassOrdering {
+			Bitonic,		//A full bitonic sort of every blade, every frame, a dispatch per stage
+			BitonicLocal,	//The same sort, but with the small stages done in shared memory (see GrassSort)
+			CellBuckets		//Blades grouped into cells, and only the cells sorted, on the CPU
+		};
+		const int GrassOrderingCount = 3;
+
+		inline const char* GrassOrderingName(GrassOrdering ordering) {
+			switch (ordering) {
+				case GrassOrdering::Bitonic:		return "bitonic";
+				case GrassOrdering::BitonicLocal:	return "bitonic (local stages)";
+				case GrassOrdering::CellBuckets:	return "cell buckets";
+			}
+			return "unknown";
+		}
+
+		//Everything a tile draws with - loaded once and shared between all the tiles of a GrassField
+		struct GrassTileAssets {
+			OGLMesh*	cubeMesh		= nullptr;
+			OGLMesh*	grassBladeMesh	= nullptr;
+			OGLMesh*	midBladeMesh	= nullptr;
+			OGLMesh*	farBladeMesh	= nullptr;
+
+			OGLShader*	tileShader		= nullptr;
+			OGLShader*	bladeShader		= nullptr;
+			OGLShader*	instBladeShader = nullptr;
+			OGLShader*	cpuBladeShader	= nullptr;
+			OGLShader*	bladeCompShader = nullptr;
+			OGLShader*	sortBladeComp	= nullptr;
+			OGLShader*	cullBladeComp	= nullptr;
+
+			OGLTexture* grassTex		= nullptr;
+
+			const GrassWindTexture* windTexture = nullptr;
 		};
 
 		class GrassTile : public GameObject {
 			
+		public:
+			static constexpr float defaultSize = 128.0f;
+
+			//Has to be a power of two, for the bitonic sort
+			static constexpr int defaultBlades = 4096 * 8;
+
+			static constexpr int lodStrides[GrassLODCount] = { 1, 4, 16 };
+
 		private:
 
+			GrassMode mode = GrassMode::Compute;
 			bool isCompute = false;
 			
-			float xLen = 128.0f;
+			float xLen = defaultSize;
 			float yLen = 1.0f;
-			float zLen = 128.0f;
-			int maxBlades = 4096*8;
+			float zLen = defaultSize;
+			int maxBlades = defaultBlades;
 
-			float windDirX = 1;
-			float windDirZ = -0.75;
-			float windSpeed = 0.3;
+			bool useVoronoi = true;
+			bool useWind	= true;
 
 			std::vector<GrassBlade> blades;
 
-			FastNoiseLite noise;
+			//Per blade wind for the CPU paths, in the same order as blades
+			GrassWind wind;
 
-			std::default_random_engine gen;
-			std::uniform_real_distribution<float> posDis, rotDis, bendDis;
+			GrassFieldGenerator generator;
+			const int noiseMapSize = 512;
+
+			//Filled in by GenerateFieldData, and kept around so a recycled tile can reuse them
+			std::vector<float> voronoiMap;
+			std::vector<float> windMap;
 
 			OGLShader* tileShader;
 			OGLMesh* cubeMesh;
 
+			#pragma region CPU Instanced Data
+
+			std::vector<GrassInstance> instances;
+			std::vector<float> instanceNoise;	//Just for the upload, before the wind's had a frame to fill it in
+			GLuint instanceVBO = 0;
+			GLuint noiseVBO = 0;
+			OGLShader* cpuBladeShader;
+
+			//Attribute slots 0 to 6 belong to the mesh itself
+			static const int instanceAttribSlot = 8;
+			static const int instanceBinding	= 8;
+			static const int noiseAttribSlot	= 11;
+			static const int noiseBinding		= 10;
+
+			#pragma endregion
+
 			#pragma region Instanced Data
 				
-			GLuint ssbo;
-			GLuint rotSSBO;
-			GLuint uvSSBO;
-			GLuint sortedSSBO;
+			GLuint ssbo = 0;
+			GLuint rotSSBO = 0;
+			GLuint uvSSBO = 0;
+			GLuint sortedSSBO = 0;
 
 			OGLShader* bladeShader;
 			OGLShader* instBladeShader;
 			OGLShader* bladeCompShader;
 			OGLMesh* grassBladeMesh;
+			OGLMesh* lodMeshes[GrassLODCount];
+
+			GrassLOD lod = GrassLOD::Near;
 			OGLShader* sortBladeComp;
-			OGLShader* initBladeSort;
+			OGLShader* cullBladeComp;
+
+			//Laid out the way glDrawElementsIndirect wants it, with instanceCount filled in by bladeCull.comp
+			struct DrawCommand {
+				GLuint indexCount;
+				GLuint instanceCount;
+				GLuint firstIndex;
+				GLuint baseVertex;
+				GLuint baseInstance;
+			};
+			GLuint drawCommandBuffer = 0;
+			int drawCommandCount = 0;	//How many commands the last CullBlades filled in
+
+			//How far past its root a blade can reach, once it's bent over and blown about by the wind
+			float cullRadius = 8.0f;
+
+			GrassOrdering ordering = GrassOrdering::CellBuckets;
+
+			//The blades are laid out on a bladesX by bladesZ grid, which CellBuckets splits into cells
+			static const int cellsPerSide	= 16;
+			static const int cellCount		= cellsPerSide * cellsPerSide;
+			static const GLuint culledCell	= 0xFFFFFFFF;
+
+			int bladesX = 0;
+			int bladesZ = 0;
+			int cellCapacity = 0;	//The most blades any one cell can hold
+
+			GLuint cellSlotBuffer = 0;
+			std::vector<GLuint> cellSlots;			//Where each cell comes in the draw order, or culledCell
+			std::vector<DrawCommand> drawCommands;	//One per visible cell, front to back
+			std::vector<std::pair<float, int>> cellOrder;
+
+			//The sorted indices are read as an instanced attribute, so each cell's draw can start at its own baseInstance
+			static const int sortedAttribSlot	= 10;
+			static const int sortedBinding		= 9;
+
+			//GPU stats, read back a few frames late so they never stall - the cull and sort time, and how many samples the tile drew
+			GPUQueryRing orderTimer{ GL_TIME_ELAPSED };
+			GPUQueryRing sampleCounter{ GL_SAMPLES_PASSED };
+			int orderingDispatches = 0;
 
 			OGLTexture* grassTex;
 
-			GLuint voronoiTex;
-			OGLTexture* debugVoronoiTex;
+			GLuint voronoiTex = 0;
+			OGLTexture* debugVoronoiTex = nullptr;
 
-			GLuint perlinWindTex;
-			OGLTexture* debugPerlinWindTex;
+			GLuint perlinWindTex = 0;
+			OGLTexture* debugPerlinWindTex = nullptr;
 
 			GLint kLoc;
 			GLint jLoc;
-			GLint camPosLoc;
+			GLint localStagesLoc;
 			uint32_t groups;
+			std::vector<BladeSortPass> sortSchedule;
+			std::vector<BladeSortPass> localSortSchedule;
 
 			GameWorld* gameWorld;
 			Window* window;
@@ -84,88 +209,195 @@ namespace NCL {
 
 
 		public:
-			GrassTile(Vector3 pos, bool compute, GameWorld* gameWorld = nullptr, Window* window = nullptr) : gen(std::random_device{}()), posDis(-0.5f, 0.5f),  rotDis(-180.0f, 180.0f), bendDis(-2.0f, 2.0f) {
-
-				this->isCompute = compute;
+			/*
+			A tile for streaming (see GrassField). It gets its buffers straight
+			away, but nothing to fill them with - that comes from MoveTo, then
+			GenerateFieldData and UploadFieldData, which can be done over and
+			over again as the tile gets recycled for other parts of the field.
+			It isn't part of the GameWorld, and has no render or physics object
+			of its own.
+			*/
+			GrassTile(GrassMode mode, const GrassTileAssets& assets, GameWorld* gameWorld, Window* window, int bladeCount = defaultBlades) {
+				this->mode = mode;
+				this->maxBlades = bladeCount;
+				this->isCompute = (mode == GrassMode::Compute);
 				this->gameWorld = gameWorld;
 				this->window = window;
 
-				InitAssets();
+				SetAssets(assets);
 
-				RenderObject* renObj = new RenderObject(&this->GetTransform(), cubeMesh, grassTex, tileShader);
-				renObj->SetColour(Vector4(0.35, 0.05, 0.01, 1.0));
+				CreateBuffers();
+			}
 
-				SetRenderObject(renObj);
-				GetRenderObject()->SetGrassVals(&xLen, &zLen, &maxBlades);
+			~GrassTile() {
+				if (instanceVBO) {
+					GLuint buffers[2] = { instanceVBO, noiseVBO };
+					glDeleteBuffers(2, buffers);
+				}
+				if (ssbo) {
+					GLuint buffers[6] = { ssbo, rotSSBO, uvSSBO, sortedSSBO, drawCommandBuffer, cellSlotBuffer };
+					glDeleteBuffers(6, buffers);
+				}
+				if (voronoiTex) {
+					glDeleteTextures(1, &voronoiTex);
+					glDeleteTextures(1, &perlinWindTex);
+				}
+				delete debugVoronoiTex;
+				delete debugPerlinWindTex;
+				delete renderObject;
+				delete physicsObject;
+				delete boundingVolume;
+			}
 
+			bool GetIsCompute() { return isCompute; }
 
-				AABBVolume* volume = new AABBVolume(Vector3(8, 0, 8));
-				this->SetBoundingVolume((CollisionVolume*)volume);
-				this->GetTransform()
-					.SetScale(Vector3(xLen, yLen, zLen))
-					.SetPosition(pos);
+			float GetTileSize() const { return xLen; }
 
-				this->SetPhysicsObject(new PhysicsObject(&this->GetTransform(), this->GetBoundingVolume()));
-				this->GetPhysicsObject()->SetInverseMass(0);
+			void SetLOD(GrassLOD newLOD) { lod = newLOD; }
 
-				if (!isCompute) {
+			GrassLOD GetLOD() const { return lod; }
 
-					noise.SetNoiseType(FastNoiseLite::NoiseType_Perlin);
-					noise.SetFrequency(0.1f);
+			float GetCullRadius() const { return cullRadius; }
 
-					CalculateBlades();
-					InstanceGrassBlades();
+			void SetOrdering(GrassOrdering newOrdering) { ordering = newOrdering; }
 
-				}
-				else {
-					GenVoronoiMap();
-					GenTileableWindNoise();
-					debugVoronoiTex = new OGLTexture(voronoiTex);
-					InitSSBO();
-					InitSortComp();
+			GrassOrdering GetOrdering() const { return ordering; }
 
+			//GPU time spent culling and ordering blades, from a few frames ago, or 0 if this frame's draw didn't get one back
+			float GetOrderingMS() const { return orderTimer.GetResult() / 1000000.0f; }
 
-				}
+			bool HasOrderingMS() const { return orderTimer.HasResult(); }
 
-				
+			//Samples the tile's blades passed the depth test, from a few frames ago, or 0 if this frame's draw didn't get one back
+			uint64_t GetSamplesPassed() const { return sampleCounter.GetResult(); }
+
+			bool HasSamplesPassed() const { return sampleCounter.HasResult(); }
 
+			//Turning the GPU stats off stops the tile making any more queries at all
+			void SetGPUStats(bool state) {
+				orderTimer.SetEnabled(state);
+				sampleCounter.SetEnabled(state);
 			}
 
-			~GrassTile() {
-				delete renderObject;
-				delete physicsObject;
-				delete boundingVolume;
+			//Compute dispatches the last frame's culling and ordering took
+			int GetOrderingDispatches() const { return orderingDispatches; }
+
+			//How many blades the current LOD could draw - the compute path culls these down further on the GPU
+			int GetInstanceCount() const {
+				int blades = isCompute ? maxBlades : (int)instances.size();
+				int stride = lodStrides[(int)lod];
+				return (blades + stride - 1) / stride;
 			}
 
-			bool GetIsCompute() { return isCompute; }
+			void SetSeed(uint32_t seed) {
+				generator.SetSeed(seed);
+			}
+
+			//Anything the GPU was still measuring belongs to wherever the tile used to be, so is thrown away
+			void MoveTo(const Vector3& pos) {
+				GetTransform().SetPosition(pos);
+				orderTimer.Reset();
+				sampleCounter.Reset();
+			}
+
+			/*
+			Works out everything the tile needs on the CPU side - blades for the
+			CPU paths, noise maps for the compute path. It doesn't touch OpenGL,
+			so it's safe to call from a worker thread, as long as nothing else
+			is using the tile at the time.
+			*/
+			void GenerateFieldData() {
+				if (isCompute) {
+					GenVoronoiMap();
+					GenTileableWindNoise();
+				}
+				else {
+					CalculateBlades();
+					if (mode == GrassMode::CPUInstanced) {
+						PackInstances();
+					}
+				}
+			}
+
+			//Hands the results of GenerateFieldData over to the GPU, so must be on the render thread
+			void UploadFieldData() {
+				if (isCompute) {
+					UploadNoiseTextures();
+					DispatchBladeComp(useVoronoi);
+				}
+				else if (mode == GrassMode::CPUInstanced) {
+					UploadInstances();
+					instanceNoise.resize(blades.size());
+					for (size_t i = 0; i < blades.size(); ++i) {
+						instanceNoise[i] = blades[i].noiseValue;
+					}
+					UploadNoise(instanceNoise);
+				}
+				else {
+					InstanceGrassBlades();
+				}
+			}
+
+			GrassMode GetMode() const { return mode; }
+
+			//Both the instanced paths are drawn by the tile itself, rather than the renderer
+			bool DrawsItself() const { return mode != GrassMode::PerBlade; }
 
 			#pragma region Init Methods
 
-			void InitAssets() {
-				cubeMesh = LoadMesh("cube.msh");
-				//grassBladeMesh = LoadMesh("grassBladeCustomSingle (1).msh");
-				grassBladeMesh = LoadMesh("grassBladeLeaf.msh");
+			//Tiles only borrow these - whoever loads them (the GrassField) frees them
+			static GrassTileAssets LoadAssets() {
+				GrassTileAssets assets;
+				assets.cubeMesh = LoadMesh("cube.msh");
+				//assets.grassBladeMesh = LoadMesh("grassBladeCustomSingle (1).msh");
+				assets.grassBladeMesh = LoadMesh("grassBladeLeaf.msh");
+				assets.midBladeMesh = CreateSimpleBladeMesh(*assets.grassBladeMesh, 2);
+				assets.farBladeMesh = CreateSimpleBladeMesh(*assets.grassBladeMesh, 1);
+
+				assets.tileShader = LoadShader("grassTile.vert", "grassTile.frag");
+				assets.bladeShader = LoadShader("grassBlade.vert", "grassBlade.frag");
+
+				assets.instBladeShader = LoadShader("instGrassBlade.vert", "instGrassBlade.frag");
+				assets.cpuBladeShader = LoadShader("cpuGrassBlade.vert", "grassBlade.frag");
+				assets.bladeCompShader = LoadCompShader("grassBlade.comp");
+				assets.sortBladeComp = LoadCompShader("bladeSort.comp");
+				assets.cullBladeComp = LoadCompShader("bladeCull.comp");
+
+				assets.grassTex = LoadTexture("checkerboard.png");
+				assets.windTexture = new GrassWindTexture(GrassWind::BuildTexture(GrassFieldGenerator(8498)));
+				return assets;
+			}
+
+			void SetAssets(const GrassTileAssets& assets) {
+				cubeMesh = assets.cubeMesh;
+				grassBladeMesh = assets.grassBladeMesh;
 
-				tileShader = LoadShader("grassTile.vert", "grassTile.frag");
-				bladeShader = LoadShader("grassBlade.vert", "grassBlade.frag");
+				lodMeshes[(int)GrassLOD::Near]	= assets.grassBladeMesh;
+				lodMeshes[(int)GrassLOD::Mid]	= assets.midBladeMesh;
+				lodMeshes[(int)GrassLOD::Far]	= assets.farBladeMesh;
 
-				instBladeShader = LoadShader("instGrassBlade.vert", "instGrassBlade.frag");
-				bladeCompShader = LoadCompShader("grassBlade.comp");
-				sortBladeComp = LoadCompShader("bladeSort.comp");
-				initBladeSort = LoadCompShader("initBladeSort.comp");
+				tileShader = assets.tileShader;
+				bladeShader = assets.bladeShader;
 
-				grassTex = LoadTexture("checkerboard.png");
+				instBladeShader = assets.instBladeShader;
+				cpuBladeShader = assets.cpuBladeShader;
+				bladeCompShader = assets.bladeCompShader;
+				sortBladeComp = assets.sortBladeComp;
+				cullBladeComp = assets.cullBladeComp;
+
+				grassTex = assets.grassTex;
+				wind.SetTexture(assets.windTexture);
 			}
 
-			OGLShader* LoadShader(const std::string& vertex, const std::string& fragment) {
+			static OGLShader* LoadShader(const std::string& vertex, const std::string& fragment) {
 				return new OGLShader(vertex, fragment);
 			}
 
-			OGLShader* LoadCompShader(const std::string& compute) {
+			static OGLShader* LoadCompShader(const std::string& compute) {
 				return new OGLShader("", "", compute);
 			}
 
-			OGLMesh* LoadMesh(const std::string& name) {
+			static OGLMesh* LoadMesh(const std::string& name) {
 				OGLMesh* mesh = new OGLMesh();
 				MshLoader::LoadMesh(name, *mesh);
 				mesh->SetPrimitiveType(GeometryPrimitive::Triangles);
@@ -173,57 +405,215 @@ namespace NCL {
 				return mesh;
 			}
 
-			OGLTexture* LoadTexture(const std::string& name) {
+			static OGLTexture* LoadTexture(const std::string& name) {
 				return OGLTexture::TextureFromFile(name).release();
 			}
 
+			/*
+			A flat blade that tapers from the full blade's base width to a point
+			at its tip, made of a quad per segment and a triangle at the top, so
+			it bends and lights the same as the full blade from far enough away.
+			*/
+			static OGLMesh* CreateSimpleBladeMesh(const Mesh& fullBlade, int segments) {
+				float height	= 0.0f;
+				float width		= 0.0f;
+				for (const Vector3& p : fullBlade.GetPositionData()) {
+					height	= std::max(height, p.y);
+					width	= std::max(width, std::abs(p.x) * 2.0f);
+				}
+
+				std::vector<Vector3>		positions;
+				std::vector<Vector2>		texCoords;
+				std::vector<Vector3>		normals;
+				std::vector<unsigned int>	indices;
+
+				for (int i = 0; i < segments; ++i) {
+					float t = i / (float)segments;
+					float halfWidth = width * 0.5f * (1.0f - t);
+					positions.push_back(Vector3(-halfWidth, height * t, 0));
+					positions.push_back(Vector3( halfWidth, height * t, 0));
+					texCoords.push_back(Vector2(0, t));
+					texCoords.push_back(Vector2(1, t));
+				}
+				positions.push_back(Vector3(0, height, 0));
+				texCoords.push_back(Vector2(0.5f, 1.0f));
+				normals.resize(positions.size(), Vector3(0, 0, 1));
+
+				for (int i = 0; i < segments - 1; ++i) {
+					unsigned int b = i * 2;
+					indices.insert(indices.end(), { b, b + 1, b + 3, b, b + 3, b + 2 });
+				}
+				unsigned int top = (segments - 1) * 2;
+				indices.insert(indices.end(), { top, top + 1, top + 2 });
+
+				OGLMesh* mesh = new OGLMesh();
+				mesh->SetVertexPositions(positions);
+				mesh->SetVertexTextureCoords(texCoords);
+				mesh->SetVertexNormals(normals);
+				mesh->SetVertexIndices(indices);
+				mesh->SetPrimitiveType(GeometryPrimitive::Triangles);
+				mesh->UploadToGPU();
+				return mesh;
+			}
+
+			//Every GL object the tile needs, sized for maxBlades, so refilling it never has to reallocate
+			void CreateBuffers() {
+				bladesX = static_cast<int>(std::sqrt(maxBlades));
+				bladesZ = maxBlades / bladesX;
+				cellCapacity = ((bladesX + cellsPerSide - 1) / cellsPerSide) * ((bladesZ + cellsPerSide - 1) / cellsPerSide);
+
+				if (isCompute) {
+					CreateNoiseTextures();
+					InitSSBO();
+					InitSortComp();
+				}
+				else if (mode == GrassMode::CPUInstanced) {
+					InitInstanceBuffer();
+				}
+			}
+
 			#pragma endregion
 
 			#pragma region CPU Methods
 
 			void CalculateBlades() {
-				int id = 0;
-
-				float area = xLen * zLen;
-				float density = maxBlades / area;
-
-				int bladesX = static_cast<int>(std::sqrt(density * xLen * zLen));
-				int bladesZ = maxBlades / bladesX;
-
-				for (int i = 0; i < bladesX; ++i) {
-					for (int j = 0; j < bladesZ; ++j) {
-						if (id >= maxBlades) return;
-						GrassBlade blade;
-						blade.id = id++;
-						blade.position = Vector3((i * (xLen / bladesX)) - xLen*0.5, this->GetTransform().GetPosition().y+0.5, (j * (zLen / bladesZ)) - zLen * 0.5);
-						
-						ApplyJitter(blade);
-						
-						blade.noiseValue = noise.GetNoise(blade.position.x, blade.position.z) * 2.0f;
-
-						blades.push_back(blade);
+				generator.GenerateBlades(blades, maxBlades, xLen, zLen, this->GetTransform().GetPosition() + Vector3(0, 0.5f, 0));
+				wind.SetBlades(blades);
+			}
+
+			/*
+			Moves the CPU paths' blades on to the wind at time, which every tile
+			should share so the wind lines up across them. Only the noise changes,
+			so that's all that gets uploaded - the instances themselves stay put.
+			*/
+			void UpdateWind(float time, float dt) {
+				if (isCompute || !useWind) {
+					return;
+				}
+				wind.Update(time, dt);
+				const std::vector<float>& noise = wind.GetNoise();
+				if (noise.size() != blades.size()) {
+					return;
+				}
+				if (mode == GrassMode::CPUInstanced) {
+					UploadNoise(noise);
+				}
+				else {
+					for (size_t i = 0; i < blades.size(); ++i) {
+						blades[i].noiseValue = noise[i];
 					}
 				}
 			}
 
-			void ApplyJitter(GrassBlade& blade) {
+			//Clumps the compute path's blades around the Voronoi cells - takes effect from the next UploadFieldData
+			void SetVoronoi(bool state) { useVoronoi = state; }
+
+			bool GetVoronoi() const { return useVoronoi; }
 
-				Vector3 posJitter = Vector3(posDis(gen), 0, posDis(gen));
-				blade.position += posJitter;
+			//Without wind, the compute path's shader skips the wind texture, and the CPU paths' blades are never updated
+			void SetWind(bool state) { useWind = state; }
 
-				blade.faceRotation = Vector3(0, rotDis(gen), 0);
+			bool GetWind() const { return useWind; }
 
-				float bend = bendDis(gen);
-				blade.bendAmount = bend;
+			//Only 1/count of the blades sample the wind each frame, with the rest blending towards where they're heading
+			void SetWindSlices(int count) {
+				wind.SetSliceCount(count);
 			}
 
-			void UpdateWind(float dt) {
-				for (GrassBlade& blade : blades) {
-					//std::cout << "Timer: " << dt << std::endl;
-					blade.noiseValue = noise.GetNoise(blade.position.x + dt * 5.0f, blade.position.z) * 2.0f;
+			void PackInstances() {
+				instances.resize(blades.size());
+				for (size_t i = 0; i < blades.size(); ++i) {
+					const GrassBlade& blade = blades[i];
+					GrassInstance& instance = instances[i];
+					instance.position	= blade.position;
+					instance.yaw		= Maths::DegreesToRadians(blade.faceRotation.y);
+					instance.bend		= blade.bendAmount;
 				}
 			}
 
+			void UploadInstances() {
+				glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+				glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(GrassInstance) * instances.size(), instances.data());
+				glBindBuffer(GL_ARRAY_BUFFER, 0);
+			}
+
+			//A float per blade, in the same order as the instances
+			void UploadNoise(const std::vector<float>& noise) {
+				glBindBuffer(GL_ARRAY_BUFFER, noiseVBO);
+				glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(float) * noise.size(), noise.data());
+				glBindBuffer(GL_ARRAY_BUFFER, 0);
+			}
+
+			/*
+			The instance and noise buffers are hooked straight into the blade
+			mesh's VAO, each on a binding of its own that only advances once per
+			instance. The compute path's shader never reads these slots, so
+			sharing the VAO doesn't get in its way.
+			*/
+			void InitInstanceBuffer() {
+				glGenBuffers(1, &instanceVBO);
+				glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+				glBufferData(GL_ARRAY_BUFFER, sizeof(GrassInstance) * maxBlades, nullptr, GL_STATIC_DRAW);
+
+				glGenBuffers(1, &noiseVBO);
+				glBindBuffer(GL_ARRAY_BUFFER, noiseVBO);
+				glBufferData(GL_ARRAY_BUFFER, sizeof(float) * maxBlades, nullptr, GL_DYNAMIC_DRAW);
+				glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+				for (OGLMesh* mesh : lodMeshes) {
+					glBindVertexArray(mesh->GetVAO());
+
+					glEnableVertexAttribArray(instanceAttribSlot);
+					glVertexAttribFormat(instanceAttribSlot, 4, GL_FLOAT, false, offsetof(GrassInstance, position));
+					glVertexAttribBinding(instanceAttribSlot, instanceBinding);
+
+					glEnableVertexAttribArray(instanceAttribSlot + 1);
+					glVertexAttribFormat(instanceAttribSlot + 1, 1, GL_FLOAT, false, offsetof(GrassInstance, bend));
+					glVertexAttribBinding(instanceAttribSlot + 1, instanceBinding);
+
+					glBindVertexBuffer(instanceBinding, instanceVBO, 0, sizeof(GrassInstance));
+					glVertexBindingDivisor(instanceBinding, 1);
+
+					glEnableVertexAttribArray(noiseAttribSlot);
+					glVertexAttribFormat(noiseAttribSlot, 1, GL_FLOAT, false, 0);
+					glVertexAttribBinding(noiseAttribSlot, noiseBinding);
+
+					glBindVertexBuffer(noiseBinding, noiseVBO, 0, sizeof(float));
+					glVertexBindingDivisor(noiseBinding, 1);
+				}
+				glBindVertexArray(0);
+			}
+
+			void DrawInstancedBlades(GLuint* shadowTex) {
+				glUseProgram(cpuBladeShader->GetProgramID());
+
+				OGLMesh* mesh = lodMeshes[(int)lod];
+				glBindVertexArray(mesh->GetVAO());
+				//Tiles share the mesh's VAO, so point it at this tile's instances. Lower
+				//LODs just step over the blades they skip, so the buffer never changes
+				glBindVertexBuffer(instanceBinding, instanceVBO, 0, sizeof(GrassInstance) * lodStrides[(int)lod]);
+				glBindVertexBuffer(noiseBinding, noiseVBO, 0, sizeof(float) * lodStrides[(int)lod]);
+
+				glActiveTexture(GL_TEXTURE0);
+				glBindTexture(GL_TEXTURE_2D, grassTex->GetObjectID());
+				glUniform1i(cpuBladeShader->GetUniformLocation("mainTex"), 0);
+				glUniform1i(cpuBladeShader->GetUniformLocation("hasTexture"), 1);
+
+				glActiveTexture(GL_TEXTURE0 + 1);
+				glBindTexture(GL_TEXTURE_2D, *shadowTex);
+				glUniform1i(cpuBladeShader->GetUniformLocation("shadowTex"), 1);
+
+				glUniform4fv(cpuBladeShader->GetUniformLocation("objectColour"), 1, (const GLfloat*)&Debug::GREEN);
+				glUniform1i(cpuBladeShader->GetUniformLocation("hasVertexColours"), !mesh->GetColourData().empty());
+				glUniform1f(cpuBladeShader->GetUniformLocation("maxHeight"), GetMaxHeight());
+
+				//Camera and light come from the renderer's FrameData block
+
+				glDrawElementsInstanced(GL_TRIANGLES, (GLsizei)mesh->GetIndexCount(), GL_UNSIGNED_INT, nullptr, GetInstanceCount());
+
+				glBindVertexArray(0);
+			}
+
 			void InstanceGrassBlades() {
 
 				for (GrassBlade& blade : blades) {
@@ -249,20 +639,13 @@ namespace NCL {
 			}
 
 			float GetMaxHeight() const {
-				float maxHeight = std::numeric_limits<float>::lowest();
-				const auto& positions = grassBladeMesh->GetPositionData();
-				for (const auto& pos : positions) {
-					if (pos.y > maxHeight) {
-						maxHeight = pos.y;
-					}
-				}
-				return maxHeight;
+				return grassBladeMesh->GetBoundsMax().y;
 			}
 			
 			#pragma endregion
 			#pragma region GPU Methods
 			
-			void InitSSBO(bool useVoronoi = true, bool useWindNoise = true) {
+			void InitSSBO() {
 
 				// create ssbos
 				glGenBuffers(1, &ssbo);
@@ -289,29 +672,51 @@ namespace NCL {
 				glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(Vector2) * maxBlades, nullptr, GL_DYNAMIC_DRAW);
 				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, uvSSBO);
 
-				// bind sorted ssbo
+				// bind sorted ssbo - CellBuckets gives every cell room for cellCapacity blades, which comes to a bit more than maxBlades
 				glBindBuffer(GL_SHADER_STORAGE_BUFFER, sortedSSBO);
-				glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(BladeIndex) * maxBlades, nullptr, GL_DYNAMIC_DRAW);
+				glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(BladeIndex) * std::max(maxBlades, cellCount * cellCapacity), nullptr, GL_DYNAMIC_DRAW);
+
+				// where each cell's blades go in the sorted ssbo
+				glGenBuffers(1, &cellSlotBuffer);
+				glBindBuffer(GL_SHADER_STORAGE_BUFFER, cellSlotBuffer);
+				glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint) * cellCount, nullptr, GL_DYNAMIC_DRAW);
+				cellSlots.resize(cellCount);
+				drawCommands.resize(cellCount);
+
+				// the indirect draw commands the cull pass counts visible blades into
+				glGenBuffers(1, &drawCommandBuffer);
+				glBindBuffer(GL_DRAW_INDIRECT_BUFFER, drawCommandBuffer);
+				glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawCommand) * cellCount, nullptr, GL_DYNAMIC_DRAW);
+				glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+			}
 
-				// Dispatch Compute
+			//Every tile shares the same binding points, so they have to be pointed back at this tile before it's used
+			void BindTileBuffers() {
+				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, ssbo);
+				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, rotSSBO);
+				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, uvSSBO);
+			}
 
-					//calculate number of grass blades along x axis
-				int bladesX = static_cast<int>(std::sqrt(maxBlades));
-				int bladesZ = maxBlades / bladesX;
+			void DispatchBladeComp(bool useVoronoi = true) {
+				BindTileBuffers();
 
+				// Dispatch Compute
 				glUseProgram(bladeCompShader->GetProgramID());
-				glUniform1ui(glGetUniformLocation(bladeCompShader->GetProgramID(), "bladesX"), bladesX);
-				glUniform1ui(glGetUniformLocation(bladeCompShader->GetProgramID(), "bladesZ"), bladesZ);
-				glUniform2f(glGetUniformLocation(bladeCompShader->GetProgramID(), "tileSize"), xLen, zLen);
+				glUniform1ui(bladeCompShader->GetUniformLocation("bladesX"), bladesX);
+				glUniform1ui(bladeCompShader->GetUniformLocation("bladesZ"), bladesZ);
+				glUniform2f(bladeCompShader->GetUniformLocation("tileSize"), xLen, zLen);
+
+				Vector3 tilePos = GetTransform().GetPosition();
+				glUniform2f(bladeCompShader->GetUniformLocation("tileOffset"), tilePos.x, tilePos.z);
 
 				glActiveTexture(GL_TEXTURE0+1);
 				glBindTexture(GL_TEXTURE_2D, voronoiTex);
 
-				glUniform1i(glGetUniformLocation(bladeCompShader->GetProgramID(), "voronoiMap"), 1);
+				glUniform1i(bladeCompShader->GetUniformLocation("voronoiMap"), 1);
 
 
 				// set uniform bool
-				GLuint vornoiLoc = glGetUniformLocation(bladeCompShader->GetProgramID(), "useVoronoiMap");
+				GLuint vornoiLoc = bladeCompShader->GetUniformLocation("useVoronoiMap");
 				glUniform1i(vornoiLoc, useVoronoi);
 
 				// Set workgroup size
@@ -320,10 +725,6 @@ namespace NCL {
 
 				// make sure ssbo writes are visible to draw call
 				glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
-
-				#pragma endregion
-
-				//ReadBackSSBO();
 			}
 
 			void InitSortComp() {
@@ -331,12 +732,12 @@ namespace NCL {
 				// set workgroup size
 				groups = ((maxBlades + 255) / 256);
 
-				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, sortedSSBO);
-				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, ssbo);
+				kLoc = sortBladeComp->GetUniformLocation("sortK");
+				jLoc = sortBladeComp->GetUniformLocation("sortJ");
+				localStagesLoc = sortBladeComp->GetUniformLocation("localStages");
 
-				camPosLoc = glGetUniformLocation(initBladeSort->GetProgramID(), "cameraPos");
-				kLoc = glGetUniformLocation(sortBladeComp->GetProgramID(), "sortK");
-				jLoc = glGetUniformLocation(sortBladeComp->GetProgramID(), "sortJ");
+				sortSchedule		= GrassSort::BuildSchedule(maxBlades, false);
+				localSortSchedule	= GrassSort::BuildSchedule(maxBlades, true);
 
 				
 				//glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
@@ -345,177 +746,261 @@ namespace NCL {
 				//ReadBackSortedSSBO();
 			}
 
-			void SortBlades() {
-
+			/*
+			Runs every blade the current LOD draws against the frustum, and packs
+			the ones that survive into sortedSSBO, counting them into the draw
+			commands' instanceCounts as it goes - so the draw only touches
+			visible blades, without the counts ever coming back to the CPU.
+
+			Usually that's a single command, with every visible blade packed
+			into the front of sortedSSBO. For a Near tile that gets sorted
+			afterwards, the unused entries are set to as far away as possible
+			first, which sorts them out past the end of the visible ones.
+
+			With CellBuckets, a Near tile gets a command per visible cell
+			instead, in front to back order (see OrderCells), and each cell's
+			blades are packed into its own block of cellCapacity entries. The
+			blades within a cell end up in no particular order, but a cell is
+			small enough that it doesn't make much difference to overdraw, and
+			there's no sort to run afterwards at all.
+			*/
+			void CullBlades(const Frustum& frustum) {
+				bool useCells = UsesCellBuckets();
+				GLuint indexCount = (GLuint)lodMeshes[(int)lod]->GetIndexCount();
+				if (useCells) {
+					drawCommandCount = OrderCells(frustum, indexCount);
+					glBindBuffer(GL_SHADER_STORAGE_BUFFER, cellSlotBuffer);
+					glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint) * cellCount, cellSlots.data());
+				}
+				else {
+					drawCommands[0] = { indexCount, 0, 0, 0, 0 };
+					drawCommandCount = 1;
+				}
+				orderingDispatches = 0;
+				if (drawCommandCount == 0) {
+					return;
+				}
+				glBindBuffer(GL_DRAW_INDIRECT_BUFFER, drawCommandBuffer);
+				glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(DrawCommand) * drawCommandCount, drawCommands.data());
+				glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+				if (lod == GrassLOD::Near && !useCells) {
+					const float farAway[2] = { FLT_MAX, 0.0f };
+					glBindBuffer(GL_SHADER_STORAGE_BUFFER, sortedSSBO);
+					glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_RG32F, GL_RG, GL_FLOAT, farAway);
+				}
 
-				// Dispatch Compute
-				glUseProgram(initBladeSort->GetProgramID());
+				glUseProgram(cullBladeComp->GetProgramID());
 
 				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, sortedSSBO);
 				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, ssbo);
+				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, drawCommandBuffer);
+				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, cellSlotBuffer);
+
+				Vector4 planes[6];
+				for (int i = 0; i < 6; ++i) {
+					const Plane& p = frustum.GetPlane(i);
+					planes[i] = Vector4(p.GetNormal(), p.GetDistance());
+				}
+				glUniform4fv(cullBladeComp->GetUniformLocation("frustumPlanes"), 6, (float*)planes);
 
 				Vector3 cameraPos = gameWorld->GetMainCamera().GetPosition();
-				glUniform3fv(camPosLoc, 1, &cameraPos.x);
+				glUniform3fv(cullBladeComp->GetUniformLocation("cameraPos"), 1, &cameraPos.x);
+				glUniform1ui(cullBladeComp->GetUniformLocation("bladeCount"), bladesX * bladesZ);
+				glUniform1ui(cullBladeComp->GetUniformLocation("lodStride"), lodStrides[(int)lod]);
+				glUniform1f(cullBladeComp->GetUniformLocation("cullRadius"), cullRadius);
+
+				glUniform1i(cullBladeComp->GetUniformLocation("useCells"), useCells);
+				glUniform1ui(cullBladeComp->GetUniformLocation("bladesX"), bladesX);
+				glUniform1ui(cullBladeComp->GetUniformLocation("bladesZ"), bladesZ);
+				glUniform1ui(cullBladeComp->GetUniformLocation("cellsPerSide"), cellsPerSide);
+
+				glDispatchCompute((GetInstanceCount() + 255) / 256, 1, 1);
+				glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+				orderingDispatches++;
+			}
 
-				glDispatchCompute(groups, 1, 1);
-				glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+			bool UsesCellBuckets() const {
+				return lod == GrassLOD::Near && ordering == GrassOrdering::CellBuckets;
+			}
 
+			/*
+			Culls the tile's cells against the frustum, and sorts the rest by
+			how far their centres are from the camera - only cellCount of them,
+			so it's nothing on the CPU, compared to sorting every blade on the
+			GPU. Each visible cell gets a draw command starting at its own block
+			of sortedSSBO, and culled cells are marked so the cull pass can skip
+			their blades without testing them.
+
+			Returns how many cells are visible.
+			*/
+			int OrderCells(const Frustum& frustum, GLuint indexCount) {
+				Vector3 tilePos		= GetTransform().GetPosition();
+				Vector3 cameraPos	= gameWorld->GetMainCamera().GetPosition();
+
+				float cellX = xLen / cellsPerSide;
+				float cellZ = zLen / cellsPerSide;
+				//The voronoi clumping can pull a blade a little way outside its cell
+				float radius = 0.5f * std::sqrt(cellX * cellX + cellZ * cellZ) + cullRadius + 2.0f;
+
+				cellOrder.clear();
+				for (int z = 0; z < cellsPerSide; ++z) {
+					for (int x = 0; x < cellsPerSide; ++x) {
+						int cell = z * cellsPerSide + x;
+						cellSlots[cell] = culledCell;
+
+						Vector3 centre = tilePos + Vector3((x + 0.5f) * cellX - xLen * 0.5f, 0.0f, (z + 0.5f) * cellZ - zLen * 0.5f);
+						if (frustum.SphereInsideFrustum(centre, radius)) {
+							cellOrder.push_back({ Vector::LengthSquared(centre - cameraPos), cell });
+						}
+					}
+				}
+				std::sort(cellOrder.begin(), cellOrder.end());
 
+				for (int i = 0; i < (int)cellOrder.size(); ++i) {
+					cellSlots[cellOrder[i].second] = i;
+					drawCommands[i] = { indexCount, 0, 0, 0, (GLuint)(i * cellCapacity) };
+				}
+				return (int)cellOrder.size();
+			}
 
-				// Sort Blades
+			void SortBlades() {
 				glUseProgram(sortBladeComp->GetProgramID());
+				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, sortedSSBO);
 
-				for (uint32_t K = 2; K <= maxBlades; K <<= 1) {
-
-					glUniform1ui(kLoc, K);
-
-					for (uint32_t J = K >> 1; J > 0; J >>= 1) {
-						glUniform1ui(jLoc, J);
-						glDispatchCompute(groups, 1, 1);
+				const std::vector<BladeSortPass>& schedule = (ordering == GrassOrdering::BitonicLocal) ? localSortSchedule : sortSchedule;
+				for (const BladeSortPass& pass : schedule) {
+					glUniform1ui(kLoc, pass.k);
+					glUniform1ui(jLoc, pass.j);
+					glUniform1i(localStagesLoc, pass.local);
+					glDispatchCompute(groups, 1, 1);
 
-						glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
-					}
+					glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+					orderingDispatches++;
 				}
-				glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+				glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
 
 			}
 
 			void GenVoronoiMap() {
-				std::random_device rd;
-				int seed = rd();
-
-				noise.SetNoiseType(FastNoiseLite::NoiseType_Cellular);
-				noise.SetCellularReturnType(FastNoiseLite::CellularReturnType_Distance2Add);
-				noise.SetSeed(seed);
-
-				noise.SetFrequency(16.0f);
-
-				const int width = 512;
-				const int height = 512;
-
-				std::vector<float> voronoiMap(width * height * 4);
-
-				for (int y = 0; y < height; y++) {
-					for (int x = 0; x < width; x++) {
-
-						float u = float(x) / float(width);
-						float v = float(y) / float(height);
-
-						float noiseValue = noise.GetNoise(u, v);
-
-						float offsetX = (noise.GetNoise(u + 0.001f, v) - noiseValue);
-						float offsetZ = (noise.GetNoise(u, v + 0.001f) - noiseValue);
-
-						float distance = fabs(noiseValue);
+				generator.GenerateVoronoiMap(voronoiMap, noiseMapSize, noiseMapSize);
+			}
 
-						int index = (y * width + x) * 4;
-						voronoiMap[index + 0] = offsetX;
-						voronoiMap[index + 1] = offsetZ;
-						voronoiMap[index + 2] = distance;
-						voronoiMap[index + 3] = 0; // leave empty for comp to calc rotation
-					}
-				}
+			void CreateNoiseTextures() {
+				const int width = noiseMapSize;
+				const int height = noiseMapSize;
 
 				glGenTextures(1, &voronoiTex);
 				glBindTexture(GL_TEXTURE_2D, voronoiTex);
-				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, voronoiMap.data());
+				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
 
 				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
+				debugVoronoiTex = new OGLTexture(voronoiTex);
 
+				glGenTextures(1, &perlinWindTex);
+				glBindTexture(GL_TEXTURE_2D, perlinWindTex);
+				glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, width, height, 0, GL_RED, GL_FLOAT, nullptr);
+
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+				// Optionally, store the texture for debugging or further use
+				debugPerlinWindTex = new OGLTexture(perlinWindTex);
 			}
 
-			void DrawGrass(Vector3* lightPos, float* lightRadius, Vector4* lightColour, float dt) {
+			void UploadNoiseTextures() {
+				glBindTexture(GL_TEXTURE_2D, voronoiTex);
+				glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, noiseMapSize, noiseMapSize, GL_RGBA, GL_FLOAT, voronoiMap.data());
 
-				GLuint qTotal = 0;
-				glGenQueries(1, &qTotal);
-				glBeginQuery(GL_SAMPLES_PASSED, qTotal);
+				glBindTexture(GL_TEXTURE_2D, perlinWindTex);
+				glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, noiseMapSize, noiseMapSize, GL_RED, GL_FLOAT, windMap.data());
+			}
 
+			//Hooks this tile's sortedSSBO into the blade mesh's VAO, read once per instance
+			void BindSortedIndices() {
+				glEnableVertexAttribArray(sortedAttribSlot);
+				glVertexAttribIFormat(sortedAttribSlot, 1, GL_UNSIGNED_INT, offsetof(BladeIndex, index));
+				glVertexAttribBinding(sortedAttribSlot, sortedBinding);
+				glBindVertexBuffer(sortedBinding, sortedSSBO, 0, sizeof(BladeIndex));
+				glVertexBindingDivisor(sortedBinding, 1);
+			}
+
+			void DrawGrass() {
+				if (drawCommandCount == 0) {
+					return;
+				}
 
 				// Bind grass blade vao & ssbo
+				OGLMesh* mesh = lodMeshes[(int)lod];
 				glUseProgram(instBladeShader->GetProgramID());
-				glBindVertexArray(grassBladeMesh->GetVAO());
-
-				glUniform1i(glGetUniformLocation(instBladeShader->GetProgramID(), "useFront2Back"), true);
+				glBindVertexArray(mesh->GetVAO());
+				BindSortedIndices();
 
 				// bind main tex
-				GLint texLoc = glGetUniformLocation(instBladeShader->GetProgramID(), "mainTex");
+				GLint texLoc = instBladeShader->GetUniformLocation("mainTex");
 
 				glActiveTexture(GL_TEXTURE0);
 				glBindTexture(GL_TEXTURE_2D, grassTex->GetObjectID());
 				glUniform1i(texLoc, 0);
 
-				GLint hasTexLoc = glGetUniformLocation(instBladeShader->GetProgramID(), "hasTexture");
+				GLint hasTexLoc = instBladeShader->GetUniformLocation("hasTexture");
 				glUniform1i(hasTexLoc, 0); // enable tex
 
-				GLint objColLoc = glGetUniformLocation(instBladeShader->GetProgramID(), "objectColour");
+				GLint objColLoc = instBladeShader->GetUniformLocation("objectColour");
 				glUniform4fv(objColLoc, 1, (const GLfloat*)&Debug::GREEN);
 
-				//// bind shadow tex
-				//GLint shadowTexLoc = glGetUniformLocation(instBladeShader->GetProgramID(), "shadowTex");
-				//glActiveTexture(GL_TEXTURE0 + 1);
-				//glBindTexture(GL_TEXTURE_2D, *shadowTex);
-				//glUniform1i(shadowTexLoc, 1);
-
-				GLint maxHeightLoc = glGetUniformLocation(instBladeShader->GetProgramID(), "maxHeight");
+				GLint maxHeightLoc = instBladeShader->GetUniformLocation("maxHeight");
 				glUniform1f(maxHeightLoc, GetMaxHeight());
 
 				// bind wind noise texture
 				glActiveTexture(GL_TEXTURE0 + 2);
 				glBindTexture(GL_TEXTURE_2D, perlinWindTex);
 
-				glUniform1i(glGetUniformLocation(instBladeShader->GetProgramID(), "perlinWindTex"), 2);
-
-				GLuint windDir = glGetUniformLocation(instBladeShader->GetProgramID(), "windDir");
-				GLuint useWindDirLoc = glGetUniformLocation(instBladeShader->GetProgramID(), "useWindNoise");
-
-				glUniform3f(windDir, windDirX, windDirZ, windSpeed);
-				glUniform1i(useWindDirLoc, true);
-
-				GLuint dtLoc = glGetUniformLocation(instBladeShader->GetProgramID(), "deltaTime");
-				glUniform1f(dtLoc, dt);
-
-
-				// bind light properties
-				GLint lightPosLoc = glGetUniformLocation(instBladeShader->GetProgramID(), "lightPos");
-				GLint lightRadLoc = glGetUniformLocation(instBladeShader->GetProgramID(), "lightRadius");
-				GLint lightColLoc = glGetUniformLocation(instBladeShader->GetProgramID(), "lightColour");
-
-				glUniform3fv(lightPosLoc, 1, (float*)lightPos);
-				glUniform1f(lightRadLoc, *lightRadius);
-				glUniform4fv(lightColLoc, 1, (float*)lightColour);
-
-				// upload view-proj mats
-				int projLocation = glGetUniformLocation(instBladeShader->GetProgramID(), "projMatrix");
-				int viewLocation = glGetUniformLocation(instBladeShader->GetProgramID(), "viewMatrix");
-
-				Matrix4 viewMatrix = gameWorld->GetMainCamera().BuildViewMatrix();
-				Matrix4 projMatrix = gameWorld->GetMainCamera().BuildProjectionMatrix(window->GetScreenAspect());
-
-				glUniformMatrix4fv(projLocation, 1, false, (float*)&projMatrix);
-				glUniformMatrix4fv(viewLocation, 1, false, (float*)&viewMatrix);
+				glUniform1i(instBladeShader->GetUniformLocation("perlinWindTex"), 2);
 
-				// Draw n instances
-				glDrawElementsInstanced(GL_TRIANGLES, grassBladeMesh->GetIndexCount(), GL_UNSIGNED_INT, nullptr, maxBlades);
+				GLint useWindDirLoc = instBladeShader->GetUniformLocation("useWindNoise");
+				glUniform1i(useWindDirLoc, useWind);
 
-				glEndQuery(GL_SAMPLES_PASSED);
+				// wind, light and view-proj mats all come from the renderer's FrameData block
 
+				// Draw however many blades made it through CullBlades
+				glBindBuffer(GL_DRAW_INDIRECT_BUFFER, drawCommandBuffer);
+				glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, drawCommandCount, 0);
+				glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
 
-				GLuint samplesThisFrame = 0;
-				glGetQueryObjectuiv(qTotal, GL_QUERY_RESULT, &samplesThisFrame);
-				std::cout << "Total samples: " << samplesThisFrame << std::endl;
-	
-
+				// the other grass paths share this VAO, and don't have anything bound for the sorted indices
+				glDisableVertexAttribArray(sortedAttribSlot);
 			}
 
-			void DrawTile(GLuint* shadowTex, Vector3* lightPos, float* lightRadius, Vector4* lightColour, float dt) {
+			//Without a frustum, the tile culls against the main camera's
+			void DrawTile(GLuint* shadowTex, const Frustum* frustum = nullptr) {
+				PROFILE_SCOPE("GrassTile::DrawTile");
+
+				if (mode == GrassMode::CPUInstanced) {
+					sampleCounter.Begin();
+					DrawInstancedBlades(shadowTex);
+					sampleCounter.End();
+					return;
+				}
 
-				SortBlades();
+				BindTileBuffers();
+				orderTimer.Begin();
+				CullBlades(frustum ? *frustum : CameraFrustum());
+				// only the near LOD is sorted, further out there's too few blades overlapping for it to matter
+				if (lod == GrassLOD::Near && ordering != GrassOrdering::CellBuckets) {
+					SortBlades();
+				}
+				orderTimer.End();
 
-				DrawGrass(lightPos, lightRadius, lightColour, dt);
+				sampleCounter.Begin();
+				DrawGrass();
+				sampleCounter.End();
 
 				//Debug::DrawTex(*debugVoronoiTex, Vector2(12, 12), Vector2(10, 10), Vector4(1.0, 1.0, 1.0, 1.0));
 				//Debug::DrawTex(*debugPerlinWindTex, Vector2(12, 35), Vector2(10, 10), Vector4(1.0, 1.0, 1.0, 1.0));
@@ -575,54 +1060,49 @@ namespace NCL {
 				}
 			}
 
-			void GenTileableWindNoise() {
-				std::random_device rd;
-				int seed = rd();
-
-				noise.SetNoiseType(FastNoiseLite::NoiseType_Perlin);
-				noise.SetSeed(seed);
-				noise.SetFrequency(0.25f); 
-
-				const int width = 512; 
-				const int height = 512;
-				const float tileSize = 16.0f;
-
-				std::vector<float> tileableNoise(width * height);
-
-				for (int y = 0; y < height; ++y) {
-					for (int x = 0; x < width; ++x) {
-						// Map pixel coordinates to noise space
-						float u = float(x) / float(width) * tileSize;
-						float v = float(y) / float(height) * tileSize;
-
-						// Wrap coordinates to make the noise tileable
-						float noiseValue = (noise.GetNoise(u, v) +
-							noise.GetNoise(u + tileSize, v) +
-							noise.GetNoise(u, v + tileSize) +
-							noise.GetNoise(u + tileSize, v + tileSize)) * 0.25f;
-
+			Frustum CameraFrustum() const {
+				PerspectiveCamera& camera = gameWorld->GetMainCamera();
+				return Frustum::FromViewProjMatrix(camera.BuildProjectionMatrix(window->GetScreenAspect()) * camera.BuildViewMatrix());
+			}
 
-						noiseValue += 1.0f; // Normalize to [0, 2]
-						noiseValue *= 0.5f; // Scale to [0, 1]
+			/*
+			Reads back what the last CullBlades gave the draw, and checks it
+			against GrassCulling's CPU version of the same thing. Returns how
+			many blades the two disagree on. It stalls the GPU, so it's only for
+			checking the cull pass, not for every frame.
+			*/
+			int VerifyCulling(const Frustum& frustum) {
+				if (!isCompute) {
+					return 0;
+				}
+				int bladeCount = bladesX * bladesZ;
+				std::vector<Vector4> positions(bladeCount);
+				glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+				glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(Vector4) * bladeCount, positions.data());
 
+				std::vector<DrawCommand> commands(drawCommandCount);
+				glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawCommandBuffer);
+				glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(DrawCommand) * commands.size(), commands.data());
 
-						int index = (y * width + x);
-						tileableNoise[index] = noiseValue;
-					}
+				//Each command's blades start at its baseInstance, so gather them all up into one list
+				std::vector<BladeIndex> gpuVisible;
+				glBindBuffer(GL_SHADER_STORAGE_BUFFER, sortedSSBO);
+				for (const DrawCommand& c : commands) {
+					size_t start = gpuVisible.size();
+					gpuVisible.resize(start + c.instanceCount);
+					glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(BladeIndex) * c.baseInstance, sizeof(BladeIndex) * c.instanceCount, gpuVisible.data() + start);
 				}
+				glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 
-				// Create OpenGL texture
-				glGenTextures(1, &perlinWindTex);
-				glBindTexture(GL_TEXTURE_2D, perlinWindTex);
-				glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, width, height, 0, GL_RED, GL_FLOAT, tileableNoise.data());
+				std::vector<BladeIndex> cpuVisible;
+				GrassCulling::CompactVisibleBlades(positions.data(), bladeCount, lodStrides[(int)lod], frustum,
+					gameWorld->GetMainCamera().GetPosition(), cullRadius, cpuVisible);
 
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+				return GrassCulling::CountMismatches(gpuVisible.data(), (int)gpuVisible.size(), cpuVisible);
+			}
 
-				// Optionally, store the texture for debugging or further use
-				debugPerlinWindTex = new OGLTexture(perlinWindTex);
+			void GenTileableWindNoise() {
+				generator.GenerateWindNoise(windMap, noiseMapSize, noiseMapSize);
 			}
 
 
@@ -3,6 +3,8 @@
 #include "Window.h"
 #include "TutorialGame.h"
 #include "../NCLCoreClasses/GameTimer.h"
+#include "../NCLCoreClasses/Profiler.h"
+#include "../NCLCoreClasses/Assets.h"
 
 
 using namespace NCL;
@@ -14,7 +16,11 @@ extern "C" {
 	_declspec(dllexport) DWORD NvOptimusEnablement = 0x00000001;
 }
 
-int main()
+/*
+--benchmark runs the grass benchmark scenarios in the given file (or
+Assets/Data/grassBenchmark.txt), then quits once they're all done.
+*/
+int main(int argc, char** argv)
 {
 	std::cout << "Hello World!" << std::endl;
 
@@ -43,10 +49,17 @@ int main()
 		return -1;
 	}
 
+	for (int i = 1; i < argc; ++i) {
+		if (std::string(argv[i]) == "--benchmark") {
+			std::string config = (i + 1 < argc && argv[i + 1][0] != '-') ? argv[++i] : Assets::DATADIR + "grassBenchmark.txt";
+			game->StartBenchmark(config);
+		}
+	}
 
-	while (window->UpdateWindow() && !Window::GetKeyboard()->KeyPressed(KeyCodes::ESCAPE)) {
+	while (window->UpdateWindow() && !Window::GetKeyboard()->KeyPressed(KeyCodes::ESCAPE) && !game->IsFinished()) {
 		dt += window->GetTimer().GetTimeDeltaSeconds();
 		game->UpdateGame(dt);
+		Profiler::EndFrame();
 	}
 
 	Window::DestroyGameWindow();
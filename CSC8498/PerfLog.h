@@ -0,0 +1,265 @@
+#pragma once
+#include <atomic>
+#include <thread>
+#include <cmath>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include "GrassStats.h"
+
+namespace NCL {
+	namespace CSC8503 {
+		/*
+		A fixed size queue for exactly one thread pushing and one thread
+		popping. Each side only ever writes its own index, so neither has to
+		lock, and a full queue just refuses the push rather than waiting.
+		*/
+		template<typename T>
+		class SPSCQueue {
+		public:
+			//Rounded up to a power of two
+			SPSCQueue(size_t capacity) {
+				size_t size = 1;
+				while (size < capacity) {
+					size <<= 1;
+				}
+				items.resize(size);
+				mask = size - 1;
+			}
+
+			bool Push(const T& item) {
+				size_t h = head.load(std::memory_order_relaxed);
+				if (h - tail.load(std::memory_order_acquire) > mask) {
+					return false;
+				}
+				items[h & mask] = item;
+				head.store(h + 1, std::memory_order_release);
+				return true;
+			}
+
+			bool Pop(T& item) {
+				size_t t = tail.load(std::memory_order_relaxed);
+				if (t == head.load(std::memory_order_acquire)) {
+					return false;
+				}
+				item = items[t & mask];
+				tail.store(t + 1, std::memory_order_release);
+				return true;
+			}
+
+		protected:
+			std::vector<T>		items;
+			size_t				mask;
+			alignas(64) std::atomic<size_t> head = 0;	//On their own cache lines, so the two threads don't fight over them
+			alignas(64) std::atomic<size_t> tail = 0;
+		};
+
+		//One frame's row of the perf log
+		struct PerfSample {
+			float		frameTime			= 0.0f;	//Seconds
+			float		frameRate			= 0.0f;
+			uint32_t	droppedFrames60		= 0;	//Running totals
+			uint32_t	droppedFrames120	= 0;
+
+			int			bladeCounts[GrassLODCount] = {};
+			float		orderingMS			= 0.0f;
+			int			orderingDispatches	= 0;
+			uint64_t	samplesPassed		= 0;
+
+			int			drawCalls			= 0;
+			int			stateChanges		= 0;
+		};
+		static_assert(GrassLODCount == 3, "The perf log has a column for each LOD");
+
+		/*
+		Writes the perf log from a thread of its own, so the frames being
+		measured never wait on the disk. The game thread just pushes each
+		frame's PerfSample into a queue; the writer wakes up every so often,
+		turns whatever's queued into CSV text, and only writes it out once
+		it's built up a big block of it.
+
+		Every frame time is also kept, and Stop writes a summary of them -
+		percentiles, a histogram, and how many frames went over the 60 and
+		120hz budgets.
+
+		If the writer ever falls so far behind that the queue fills up, the
+		frames that don't fit are counted in the summary rather than waited on.
+		*/
+		class PerfLogWriter {
+		public:
+			static const size_t queueSize	= 1 << 14;
+			static const size_t blockSize	= 1 << 16;	//Bytes of CSV built up before each write
+
+			PerfLogWriter() : queue(queueSize) {}
+
+			~PerfLogWriter() {
+				Stop();
+			}
+
+			PerfLogWriter(const PerfLogWriter&) = delete;
+			PerfLogWriter& operator=(const PerfLogWriter&) = delete;
+
+			//An empty summaryFile skips the summary
+			bool Start(const std::string& logFile, const std::string& newSummaryFile) {
+				Stop();
+				file.open(logFile, std::ios::out | std::ios::binary);
+				if (!file) {
+					std::cout << __FUNCTION__ << ": Can't open " << logFile << ", no stats will be logged!" << std::endl;
+					return false;
+				}
+				summaryFile = newSummaryFile;
+				frameTimes.clear();
+				droppedSamples	= 0;
+				running			= true;
+				writer			= std::thread([this]() { Run(); });
+				return true;
+			}
+
+			//Writes out anything still queued, then the summary
+			void Stop() {
+				if (!writer.joinable()) {
+					return;
+				}
+				running = false;
+				writer.join();
+				file.close();
+				if (!summaryFile.empty()) {
+					WriteSummary(summaryFile, frameTimes, droppedSamples);
+				}
+			}
+
+			bool IsRunning() const {
+				return writer.joinable();
+			}
+
+			//Game thread only
+			void Push(const PerfSample& sample) {
+				if (!writer.joinable() || !queue.Push(sample)) {
+					droppedSamples++;
+				}
+			}
+
+			//The nearest rank percentile, p from 0 to 1, of an already sorted list
+			static float Percentile(const std::vector<float>& sorted, double p) {
+				if (sorted.empty()) {
+					return 0.0f;
+				}
+				size_t rank = (size_t)std::ceil(p * sorted.size());
+				return sorted[std::clamp(rank, (size_t)1, sorted.size()) - 1];
+			}
+
+			/*
+			Whole vsync intervals a frame of frameTime seconds missed, against
+			a budget of target seconds - so 1.5 budgets is 1 dropped, not 0.
+			*/
+			static uint32_t DroppedFrames(float frameTime, float target) {
+				float intervals = frameTime / target;
+				return intervals > 1.0f ? (uint32_t)std::ceil(intervals) - 1 : 0;
+			}
+
+			//JSON, with frame times in milliseconds, and a histogram of 0.5ms buckets up to 50ms
+			static void WriteSummary(const std::string& filename, std::vector<float> frameTimes, uint64_t droppedSamples) {
+				std::ofstream out(filename);
+				if (!out) {
+					std::cout << __FUNCTION__ << ": Can't open " << filename << " for writing!" << std::endl;
+					return;
+				}
+				const float bucketMS	= 0.5f;
+				const int	bucketCount	= 100;
+				std::vector<uint32_t> histogram(bucketCount + 1, 0);	//The last bucket catches everything over
+
+				double		total		= 0.0;
+				uint32_t	over60		= 0;
+				uint32_t	over120		= 0;
+				uint64_t	dropped60	= 0;
+				uint64_t	dropped120	= 0;
+				for (float& t : frameTimes) {
+					over60		+= t > hz60Budget;
+					over120		+= t > hz120Budget;
+					dropped60	+= DroppedFrames(t, hz60Budget);
+					dropped120	+= DroppedFrames(t, hz120Budget);
+
+					t *= 1000.0f;
+					total += t;
+					histogram[std::min((int)(t / bucketMS), bucketCount)]++;
+				}
+				std::sort(frameTimes.begin(), frameTimes.end());
+
+				out << "{\n";
+				out << "\t\"frames\": "			<< frameTimes.size() << ",\n";
+				out << "\t\"droppedSamples\": "	<< droppedSamples << ",\n";
+				out << "\t\"meanMS\": "			<< (frameTimes.empty() ? 0.0 : total / frameTimes.size()) << ",\n";
+				out << "\t\"minMS\": "			<< (frameTimes.empty() ? 0.0f : frameTimes.front()) << ",\n";
+				out << "\t\"maxMS\": "			<< (frameTimes.empty() ? 0.0f : frameTimes.back()) << ",\n";
+				out << "\t\"p50MS\": "			<< Percentile(frameTimes, 0.5) << ",\n";
+				out << "\t\"p90MS\": "			<< Percentile(frameTimes, 0.9) << ",\n";
+				out << "\t\"p99MS\": "			<< Percentile(frameTimes, 0.99) << ",\n";
+				out << "\t\"p999MS\": "			<< Percentile(frameTimes, 0.999) << ",\n";
+				out << "\t\"framesOver60\": "	<< over60 << ",\n";
+				out << "\t\"framesOver120\": "	<< over120 << ",\n";
+				out << "\t\"droppedFrames60\": "	<< dropped60 << ",\n";
+				out << "\t\"droppedFrames120\": "	<< dropped120 << ",\n";
+				out << "\t\"histogramBucketMS\": " << bucketMS << ",\n";
+				out << "\t\"histogram\": [";
+				for (size_t i = 0; i < histogram.size(); ++i) {
+					out << histogram[i] << (i + 1 < histogram.size() ? ", " : "");
+				}
+				out << "]\n";
+				out << "}\n";
+			}
+
+			static constexpr float hz60Budget	= 1.0f / 60.0f;
+			static constexpr float hz120Budget	= 1.0f / 120.0f;
+
+		protected:
+			void Run() {
+				std::string block;
+				block.reserve(blockSize * 2);
+				block += "FrameTime,FrameRate,DroppedFrames60,DroppedFrames120,NearBlades,MidBlades,FarBlades,GrassOrderingMS,GrassOrderingDispatches,GrassSamplesPassed,SceneDrawCalls,SceneStateChanges\n";
+
+				bool keepGoing = true;
+				while (keepGoing) {
+					//Checked before draining, so nothing pushed before Stop can be missed
+					keepGoing = running;
+
+					PerfSample s;
+					while (queue.Pop(s)) {
+						frameTimes.push_back(s.frameTime);
+						AppendRow(block, s);
+						if (block.size() >= blockSize) {
+							file.write(block.data(), block.size());
+							block.clear();
+						}
+					}
+					if (keepGoing) {
+						std::this_thread::sleep_for(std::chrono::milliseconds(10));
+					}
+				}
+				file.write(block.data(), block.size());
+			}
+
+			static void AppendRow(std::string& block, const PerfSample& s) {
+				char row[256];
+				int length = snprintf(row, sizeof(row), "%g,%g,%u,%u,%d,%d,%d,%g,%d,%llu,%d,%d\n",
+					s.frameTime, s.frameRate, s.droppedFrames60, s.droppedFrames120,
+					s.bladeCounts[0], s.bladeCounts[1], s.bladeCounts[2],
+					s.orderingMS, s.orderingDispatches, (unsigned long long)s.samplesPassed,
+					s.drawCalls, s.stateChanges);
+				block.append(row, std::min(length, (int)sizeof(row) - 1));
+			}
+
+			SPSCQueue<PerfSample>	queue;
+			std::thread				writer;
+			std::atomic<bool>		running = false;
+
+			//Only the writer thread touches these while it's running
+			std::ofstream			file;
+			std::vector<float>		frameTimes;
+
+			std::string				summaryFile;
+			uint64_t				droppedSamples = 0;
+		};
+	}
+}
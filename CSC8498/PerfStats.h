@@ -3,15 +3,26 @@
 #include <iostream>
 #include <chrono>
 #include "GameTechRenderer.h"
+#include "Profiler.h"
+#include "PerfLog.h"
 #include <ctime>
 
 
 namespace NCL {
 	namespace CSC8503 {
 
+		/*
+		The frame counters the renderer keeps, plus the grass and scene stats,
+		logged to a CSV file every frame, by a PerfLogWriter on a thread of its
+		own, which also writes a summary of the frame times when it's done.
+		Where the frame time actually goes is down to the Profiler's zones -
+		PrintStats shows those too, and CaptureTrace saves a few frames of
+		them for chrome://tracing.
+		*/
 		class PerfStats
 		{
 		private:
+			//These all belong to the renderer
 			float* framerate = nullptr;
 			float* frametime = nullptr;
 
@@ -19,18 +30,19 @@ namespace NCL {
 			uint32_t droppedFrames60;
 			uint32_t droppedFrames120;
 
-			const float hz60Target = 1.0f / 60.0f;
-			const float hz120Target = 1.0f / 120.0f;
-
 			GameTechRenderer* renderer = nullptr;
+			const GrassField* grassField = nullptr;
 
-			std::ofstream file;
+			PerfLogWriter log;
+			std::string directory;
 
 
 		public:
 
-			PerfStats(GameTechRenderer* renderer) {
+			//Files go in directory, which should end in a slash - by default, the working directory
+			PerfStats(GameTechRenderer* renderer, const std::string& directory = "") {
 				this->renderer = renderer;
+				this->directory = directory;
 				framerate = this->renderer->GetFrameRate();
 				frametime = this->renderer->GetFrameTime();
 				totalFrames = this->renderer->GetTotalFrames();
@@ -43,11 +55,12 @@ namespace NCL {
 			}
 
 			~PerfStats() {
-				delete framerate;
-				delete frametime;
-				delete totalFrames;
+				log.Stop();
+			}
 
-				file.close();
+			//Adds the field's per LOD tile and instance counts to the stats
+			void SetGrassField(const GrassField* field) {
+				grassField = field;
 			}
 
 			void UpdateStats(bool print) {
@@ -61,10 +74,6 @@ namespace NCL {
 			}
 
 			void PrintStats() {
-
-				//clear console
-				system("cls");
-
 				std::cout << "-------Stats--------" << std::endl;
 				std::cout << "FPS: " << *framerate << std::endl;
 				std::cout << "Frame time: " << *frametime * 1000.0f << "ms" << std::endl;
@@ -72,38 +81,70 @@ namespace NCL {
 				std::cout << "Dropped frames@60hz: " << droppedFrames60 << std::endl;
 				std::cout << "Dropped frames@120hz: " << droppedFrames120 << std::endl;
 
-			}
-
-			void CalcDroppedFrames() {
+				if (grassField) {
+					const GrassLODStats& lods = grassField->GetLODStats();
+					const char* names[GrassLODCount] = { "Near", "Mid", "Far" };
+					for (int i = 0; i < GrassLODCount; ++i) {
+						std::cout << "Grass " << names[i] << ": " << lods.tiles[i] << " tiles, " << lods.instances[i] << " blades" << std::endl;
+					}
+					std::cout << "Grass tiles culled: " << lods.culledTiles << std::endl;
+					std::cout << "Grass ordering (" << GrassOrderingName(grassField->GetOrdering()) << "): "
+						<< lods.orderingMS << "ms GPU (" << lods.timedTiles << " tiles timed), " << lods.orderingDispatches << " dispatches" << std::endl;
+					if (grassField->GetMode() != GrassMode::Compute) {
+						std::cout << "Grass wind (" << grassField->GetWindSlices() << " slices): " << lods.windMS << "ms CPU" << std::endl;
+					}
+					if (grassField->GetGPUStats()) {
+						std::cout << "Grass samples passed: " << lods.samplesPassed << " (" << lods.sampledTiles << " tiles counted)" << std::endl;
+					}
+				}
 
-				uint32_t expectedFrames60 = *frametime / hz60Target;
+				const SceneRenderStats& scene = renderer->GetSceneStats();
+				std::cout << "Scene (" << (renderer->GetSceneBatching() ? "batched" : "unbatched") << "): " << scene.objects << " objects, "
+					<< scene.cameraCulled << " culled by the camera, " << scene.shadowCulled << " by the light, "
+					<< scene.drawCalls << " draws (" << scene.instancedDraws << " instanced), "
+					<< scene.StateChanges() << " state changes (" << scene.shaderChanges << " shader, "
+					<< scene.textureChanges << " texture, " << scene.meshChanges << " mesh)" << std::endl;
 
-				if (expectedFrames60 > 1.0f) {
-					droppedFrames60 += expectedFrames60 - 1.0f;
-				}
+				Profiler::PrintStats(std::cout);
+			}
 
-				uint32_t expectedFrames120 = *frametime / hz120Target;
+			//Saves every profiler zone from the next frameCount frames as a Chrome trace
+			void CaptureTrace(int frameCount) {
+				Profiler::CaptureFrames(frameCount, directory + "ProfilerTrace_" + GetDateTime() + ".json");
+			}
 
-				if (expectedFrames120 > 1.0f) {
-					droppedFrames120 += expectedFrames120 - 1.0f;
-				}
+			void CalcDroppedFrames() {
+				droppedFrames60		+= PerfLogWriter::DroppedFrames(*frametime, PerfLogWriter::hz60Budget);
+				droppedFrames120	+= PerfLogWriter::DroppedFrames(*frametime, PerfLogWriter::hz120Budget);
 			}
 
+			//Just hands the frame over to the log's thread, nothing here touches the disk
 			void WriteToFile() {
-				file << *frametime << "," << *framerate << "," << droppedFrames60 << "," << droppedFrames120 << std::endl;
-				file.flush();
+				PerfSample sample;
+				sample.frameTime		= *frametime;
+				sample.frameRate		= *framerate;
+				sample.droppedFrames60	= droppedFrames60;
+				sample.droppedFrames120 = droppedFrames120;
+
+				if (grassField) {
+					const GrassLODStats& lods = grassField->GetLODStats();
+					for (int i = 0; i < GrassLODCount; ++i) {
+						sample.bladeCounts[i] = lods.instances[i];
+					}
+					sample.orderingMS			= lods.orderingMS;
+					sample.orderingDispatches	= lods.orderingDispatches;
+					sample.samplesPassed		= lods.samplesPassed;
+				}
+
+				const SceneRenderStats& scene = renderer->GetSceneStats();
+				sample.drawCalls	= scene.drawCalls;
+				sample.stateChanges = scene.StateChanges();
+				log.Push(sample);
 			}
 
 			void OpenFile() {
-				std::string date = std::to_string(std::chrono::system_clock::to_time_t(std::chrono::system_clock::now()));
-				std::string time = std::to_string(std::chrono::system_clock::now().time_since_epoch().count());
-				std::string filename = "PerfStats_" + GetDateTime() + ".csv";
-				std::string directory = "../../Documents/";
-
-				file.open(directory + filename, std::ios::app);
-
-				// Headers for frametime, framerate, and dropped frames
-				file << "FrameTime,FrameRate,DroppedFrames60,DroppedFrames120" << std::endl;
+				std::string dateTime = GetDateTime();
+				log.Start(directory + "PerfStats_" + dateTime + ".csv", directory + "PerfSummary_" + dateTime + ".json");
 			}
 
 			std::string GetDateTime() {
@@ -3,7 +3,7 @@
 #include "PhysicsObject.h"
 #include "RenderObject.h"
 #include "TextureLoader.h"
-#include "GrassTile.h"
+#include "GrassField.h"
 #include "PerfStats.h"
 
 
@@ -14,8 +14,12 @@ using namespace CSC8503;
 TutorialGame::TutorialGame() : controller(*Window::GetWindow()->GetKeyboard(), *Window::GetWindow()->GetMouse()) {
 	world		= new GameWorld();
 	renderer = new GameTechRenderer(*world);
+	jobSystem	= new JobSystem();
+	renderer->SetJobSystem(jobSystem);
+	perfStats	= new PerfStats(renderer);
 
 	physics		= new PhysicsSystem(*world);
+	physics->UseSleeping(true);
 
 	forceMagnitude	= 10.0f;
 	useGravity		= false;
@@ -52,21 +56,40 @@ TutorialGame::~TutorialGame()	{
 	delete basicTex;
 	delete basicShader;
 
+	delete benchmark;
+	delete grassField;
+	delete perfStats;
 	delete physics;
 	delete renderer;
 	delete world;
+	delete jobSystem;
 }
 
 void TutorialGame::UpdateGame(float dt) {
-
-	if (Window::GetKeyboard()->KeyPressed(KeyCodes::R)) {
-		InitWorld();
-		std::cout << "Resetting World " << std::endl;
+	PROFILE_SCOPE("TutorialGame::UpdateGame");
+
+	if (benchmark) {
+		UpdateBenchmark();
+		if (finished) {
+			return;
+		}
+		dt = benchmark->GetTime();
+	}
+	else {
+		UpdateKeys(dt);
+		world->GetMainCamera().UpdateCamera(dt);
+
+		if (recordingPath && dt - lastRecordedKey >= 0.1f) {
+			recordedPath.AddKey(dt - recordStart, world->GetMainCamera());
+			lastRecordedKey = dt;
+		}
 	}
 
-	world->GetMainCamera().UpdateCamera(dt);
-
-	world->UpdateWorld(dt);
+	grassField->Update(world->GetMainCamera().GetPosition());
+	{
+		PROFILE_SCOPE("GameWorld::UpdateWorld");
+		world->UpdateWorld(dt);
+	}
 	renderer->Update(dt);
 	physics->Update(dt);
 
@@ -75,13 +98,140 @@ void TutorialGame::UpdateGame(float dt) {
 	
 	
 
-
 	Debug::UpdateRenderables(dt);
 
 	perfStats->UpdateStats(false);
 
 }
 
+void TutorialGame::UpdateKeys(float dt) {
+	if (Window::GetKeyboard()->KeyPressed(KeyCodes::R)) {
+		InitWorld();
+		std::cout << "Resetting World " << std::endl;
+	}
+
+	if (Window::GetKeyboard()->KeyPressed(KeyCodes::B)) {
+		physics->UseBroadPhase(!physics->IsUsingBroadPhase());
+		std::cout << "Setting broadphase to " << physics->IsUsingBroadPhase() << std::endl;
+	}
+	if (Window::GetKeyboard()->KeyPressed(KeyCodes::N)) {
+		physics->UseSimpleContainer(!physics->IsUsingSimpleContainer());
+		std::cout << "Setting broad container to " << physics->IsUsingSimpleContainer() << std::endl;
+	}
+	if (Window::GetKeyboard()->KeyPressed(KeyCodes::I)) {
+		physics->SetConstraintIterationCount(physics->GetConstraintIterationCount() - 1);
+		std::cout << "Setting constraint iterations to " << physics->GetConstraintIterationCount() << std::endl;
+	}
+	if (Window::GetKeyboard()->KeyPressed(KeyCodes::O)) {
+		physics->SetConstraintIterationCount(physics->GetConstraintIterationCount() + 1);
+		std::cout << "Setting constraint iterations to " << physics->GetConstraintIterationCount() << std::endl;
+	}
+	if (Window::GetKeyboard()->KeyPressed(KeyCodes::Z)) {
+		physics->UseSleeping(!physics->IsUsingSleeping());
+		const PhysicsBodyCounts& counts = physics->GetBodyCounts();
+		std::cout << "Setting sleeping to " << physics->IsUsingSleeping() << " (awake " << counts.awake
+			<< ", asleep " << counts.asleep << ", static " << counts.statics << ")" << std::endl;
+	}
+
+	if (Window::GetKeyboard()->KeyPressed(KeyCodes::V)) {
+		grassField->VerifyCullingNextDraw();
+	}
+	if (Window::GetKeyboard()->KeyPressed(KeyCodes::G)) {
+		GrassOrdering next = (GrassOrdering)(((int)grassField->GetOrdering() + 1) % GrassOrderingCount);
+		grassField->SetOrdering(next);
+		std::cout << "Setting grass ordering to " << GrassOrderingName(next) << std::endl;
+	}
+	if (Window::GetKeyboard()->KeyPressed(KeyCodes::P)) {
+		grassField->SetGPUStats(!grassField->GetGPUStats());
+		std::cout << "Setting grass GPU stats to " << grassField->GetGPUStats() << std::endl;
+	}
+	if (Window::GetKeyboard()->KeyPressed(KeyCodes::M)) {
+		renderer->SetSceneBatching(!renderer->GetSceneBatching());
+		std::cout << "Setting scene batching to " << renderer->GetSceneBatching() << std::endl;
+	}
+	if (Window::GetKeyboard()->KeyPressed(KeyCodes::K)) {
+		int slices = grassField->GetWindSlices() >= 8 ? 1 : grassField->GetWindSlices() * 2;
+		grassField->SetWindSlices(slices);
+		std::cout << "Setting grass wind slices to " << slices << std::endl;
+	}
+	if (Window::GetKeyboard()->KeyPressed(KeyCodes::L)) {
+		perfStats->PrintStats();
+	}
+	if (Window::GetKeyboard()->KeyPressed(KeyCodes::F) && !Profiler::IsCapturing()) {
+		perfStats->CaptureTrace(120);
+		std::cout << "Capturing the next 120 frames of profiler zones" << std::endl;
+	}
+	if (Window::GetKeyboard()->KeyPressed(KeyCodes::C)) {
+		if (recordingPath) {
+			std::string filename = "CameraPath_" + perfStats->GetDateTime() + ".txt";
+			if (recordedPath.Save(filename)) {
+				std::cout << "Saved " << recordedPath.GetDuration() << "s of camera path to " << filename << std::endl;
+			}
+		}
+		else {
+			recordedPath.Clear();
+			recordedPath.AddKey(0.0f, world->GetMainCamera());
+			recordStart		= dt;
+			lastRecordedKey = dt;
+			std::cout << "Recording the camera path, C again to stop" << std::endl;
+		}
+		recordingPath = !recordingPath;
+	}
+}
+
+/*
+Each Step flies the camera on along the path - when a scenario runs out,
+the grass is rebuilt for the next one, and once they've all been run the
+results are printed and saved, and the game finishes.
+*/
+void TutorialGame::UpdateBenchmark() {
+	Camera& camera = world->GetMainCamera();
+	while (!benchmark->Step(camera, *renderer->GetFrameTime(), grassField->GetLODStats())) {
+		if (!benchmark->NextScenario()) {
+			benchmark->PrintTable(std::cout);
+			benchmark->WriteResults("", perfStats->GetDateTime());
+			finished = true;
+			return;
+		}
+		StartScenario(benchmark->GetScenario());
+	}
+}
+
+bool TutorialGame::StartBenchmark(const std::string& configFile) {
+	std::vector<GrassScenario> scenarios;
+	std::string pathFile;
+	if (!GrassBenchmark::LoadScenarios(configFile, scenarios, pathFile)) {
+		std::cout << "No grass benchmark scenarios in " << configFile << "!" << std::endl;
+		return false;
+	}
+	CameraPath path;
+	if (pathFile.empty() || !path.Load(pathFile)) {
+		path = CameraPath::Orbit(Vector3(0, 0, 0), 60.0f, 8.0f, 30.0f);
+	}
+	delete benchmark;
+	benchmark	= new GrassBenchmark(scenarios, path);
+	finished	= false;
+	benchmark->NextScenario();
+	StartScenario(benchmark->GetScenario());
+
+	std::cout << "Running " << scenarios.size() << " grass benchmark scenarios" << std::endl;
+	return true;
+}
+
+void TutorialGame::StartScenario(const GrassScenario& scenario) {
+	std::cout << "Grass benchmark: starting " << scenario.name << std::endl;
+
+	delete grassField;
+	grassField = new GrassField(scenario.mode, world, Window::GetWindow(), jobSystem, scenario.seed, scenario.loadRadius, scenario.bladesPerTile);
+	grassField->SetOrdering(scenario.ordering);
+	grassField->SetVoronoi(scenario.voronoi);
+	grassField->SetWind(scenario.wind);
+	grassField->SetWindSlices(scenario.windSlices);
+	grassField->SetGPUStats(true);	//So every scenario pays for the same queries
+	renderer->SetGrassField(grassField);
+	perfStats->SetGrassField(grassField);
+}
+
 void TutorialGame::InitCamera() {
 	world->GetMainCamera().SetNearPlane(0.1f);
 	world->GetMainCamera().SetFarPlane(500.0f);
@@ -93,17 +243,15 @@ void TutorialGame::InitCamera() {
 void TutorialGame::InitWorld() {
 
 	renderer->SetVerticalSync(VerticalSyncState::VSync_OFF);
-	perfStats = new PerfStats(renderer);
 	world->ClearAndErase();
 	physics->Clear();
 
 	InitDefaultFloor();
 
-	grassTile = new GrassTile(Vector3(0, 2, 0), true, world, Window::GetWindow());
-	if (grassTile->GetIsCompute()) { renderer->AddTile(grassTile); }
-
-
-	world->AddGameObject(grassTile);
+	delete grassField;
+	grassField = new GrassField(GrassMode::Compute, world, Window::GetWindow(), jobSystem);
+	renderer->SetGrassField(grassField);
+	perfStats->SetGrassField(grassField);
 
 }
 
@@ -3,8 +3,9 @@
 #include "../NCLCoreClasses/KeyboardMouseController.h"
 #include "PhysicsSystem.h"
 #include "GameTechRenderer.h"
-#include "GrassTile.h"
+#include "GrassField.h"
 #include "PerfStats.h"
+#include "GrassBenchmark.h"
 
 
 
@@ -17,7 +18,17 @@ namespace NCL {
 
 			virtual void UpdateGame(float dt);
 
+			//Runs every scenario in configFile, instead of taking any input, then finishes
+			bool StartBenchmark(const std::string& configFile);
+
+			bool IsFinished() const {
+				return finished;
+			}
+
 		protected:
+			void UpdateKeys(float dt);
+			void UpdateBenchmark();
+			void StartScenario(const GrassScenario& scenario);
 
 			void InitialiseAssets();
 			void InitCamera();
@@ -33,6 +44,7 @@ namespace NCL {
 
 			PhysicsSystem*		physics;
 			GameWorld*			world;
+			JobSystem*			jobSystem;	//Shared by anything that wants to spread work across cores
 
 			KeyboardMouseController controller;
 
@@ -48,9 +60,18 @@ namespace NCL {
 
 			Texture*	basicTex	= nullptr;
 			Shader*		basicShader = nullptr;
-			GrassTile* grassTile = nullptr;
+			GrassField* grassField = nullptr;
 
 			PerfStats* perfStats = nullptr;
+
+			GrassBenchmark* benchmark	= nullptr;
+			bool			finished	= false;
+
+			//C starts and stops recording the camera, for a benchmark to fly again later
+			CameraPath	recordedPath;
+			bool		recordingPath	= false;
+			float		recordStart		= 0.0f;
+			float		lastRecordedKey = 0.0f;
 		};
 	}
 }
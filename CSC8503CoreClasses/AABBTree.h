@@ -0,0 +1,566 @@
+#pragma once
+#include "CollisionDetection.h"
+
+namespace NCL {
+	using namespace NCL::Maths;
+	namespace CSC8503 {
+		/*
+		A persistent, incrementally updated bounding volume hierarchy.
+
+		Each object is stored in a leaf whose box is 'fattened' by a margin, so
+		that small movements don't require the tree to change at all. Only when
+		an object's real bounds leave its fat bounds is its leaf removed and
+		re-inserted. Nodes live in a single array and refer to each other by
+		index, with freed nodes recycled through a free list, so the tree can
+		live across many frames without touching the heap.
+
+		Queries and raycasts reuse traversal stacks kept in the tree, so they
+		aren't const, and only one of them can run on a tree at a time.
+		*/
+		template<class T>
+		class AABBTree {
+		public:
+			static const int NullNode = -1;
+
+			AABBTree(float fatMargin = 0.5f) {
+				margin		= fatMargin;
+				root		= NullNode;
+				freeList	= NullNode;
+				proxyCount	= 0;
+			}
+			~AABBTree() {
+			}
+
+			void Clear() {
+				nodes.clear();
+				root		= NullNode;
+				freeList	= NullNode;
+				proxyCount	= 0;
+			}
+
+			//Returns a proxy handle, which stays valid until the object is removed
+			int Insert(T object, const Vector3& pos, const Vector3& halfSize) {
+				int leaf = AllocateNode();
+				Vector3 fatSize = halfSize + Vector3(margin, margin, margin);
+
+				nodes[leaf].min		= pos - fatSize;
+				nodes[leaf].max		= pos + fatSize;
+				nodes[leaf].object	= object;
+				nodes[leaf].height	= 0;
+
+				InsertLeaf(leaf);
+				proxyCount++;
+				return leaf;
+			}
+
+			void Remove(int proxy) {
+				RemoveLeaf(proxy);
+				FreeNode(proxy);
+				proxyCount--;
+			}
+
+			//Returns true if the object left its fat bounds and had to be re-inserted
+			bool Move(int proxy, const Vector3& pos, const Vector3& halfSize) {
+				Vector3 minB = pos - halfSize;
+				Vector3 maxB = pos + halfSize;
+
+				const Node& n = nodes[proxy];
+				if (n.min.x <= minB.x && n.min.y <= minB.y && n.min.z <= minB.z &&
+					n.max.x >= maxB.x && n.max.y >= maxB.y && n.max.z >= maxB.z) {
+					return false;
+				}
+				RemoveLeaf(proxy);
+
+				Vector3 fatSize = halfSize + Vector3(margin, margin, margin);
+				nodes[proxy].min = pos - fatSize;
+				nodes[proxy].max = pos + fatSize;
+
+				InsertLeaf(proxy);
+				return true;
+			}
+
+			T& GetObject(int proxy) {
+				return nodes[proxy].object;
+			}
+
+			const T& GetObject(int proxy) const {
+				return nodes[proxy].object;
+			}
+
+			void GetFatBounds(int proxy, Vector3& outMin, Vector3& outMax) const {
+				outMin = nodes[proxy].min;
+				outMax = nodes[proxy].max;
+			}
+
+			int GetProxyCount() const {
+				return proxyCount;
+			}
+
+			int GetHeight() const {
+				return root == NullNode ? 0 : nodes[root].height;
+			}
+
+			/*
+			Calls func(proxy, object) for every leaf whose fat bounds overlap the
+			given box. Returning false from func stops the query early.
+			*/
+			template<typename F>
+			void Query(const Vector3& minB, const Vector3& maxB, F&& func) {
+				if (root == NullNode) {
+					return;
+				}
+				queryStack.clear();
+				queryStack.push_back(root);
+
+				while (!queryStack.empty()) {
+					int index = queryStack.back();
+					queryStack.pop_back();
+
+					const Node& n = nodes[index];
+					if (!Overlaps(n.min, n.max, minB, maxB)) {
+						continue;
+					}
+					if (n.IsLeaf()) {
+						if (!func(index, n.object)) {
+							return;
+						}
+					}
+					else {
+						queryStack.push_back(n.children[0]);
+						queryStack.push_back(n.children[1]);
+					}
+				}
+			}
+
+			template<typename F>
+			void QueryProxy(int proxy, F&& func) {
+				Query(nodes[proxy].min, nodes[proxy].max, func);
+			}
+
+			/*
+			Calls func(proxyA, objectA, proxyB, objectB) once for every pair of leaves
+			whose fat bounds overlap. Rather than querying once per leaf, this walks
+			the tree against itself, so a subtree that doesn't touch another is
+			skipped along with every leaf in it - a full pass visits far fewer nodes
+			than querying each leaf in turn, and each pair only comes out once.
+			*/
+			template<typename F>
+			void QueryPairs(F&& func) {
+				if (root == NullNode) {
+					return;
+				}
+				pairStack.clear();
+				pairStack.push_back({ root, root });
+
+				while (!pairStack.empty()) {
+					NodePair pair = pairStack.back();
+					pairStack.pop_back();
+
+					const Node& a = nodes[pair.a];
+					if (pair.a == pair.b) { //A subtree against itself - its children against themselves, and each other
+						if (!a.IsLeaf()) {
+							pairStack.push_back({ a.children[0], a.children[0] });
+							pairStack.push_back({ a.children[1], a.children[1] });
+							pairStack.push_back({ a.children[0], a.children[1] });
+						}
+						continue;
+					}
+					const Node& b = nodes[pair.b];
+					if (!Overlaps(a.min, a.max, b.min, b.max)) {
+						continue;
+					}
+					if (a.IsLeaf() && b.IsLeaf()) {
+						func(pair.a, a.object, pair.b, b.object);
+					}
+					else if (b.IsLeaf() || (!a.IsLeaf() && a.height >= b.height)) { //Split the taller side
+						pairStack.push_back({ a.children[0], pair.b });
+						pairStack.push_back({ a.children[1], pair.b });
+					}
+					else {
+						pairStack.push_back({ pair.a, b.children[0] });
+						pairStack.push_back({ pair.a, b.children[1] });
+					}
+				}
+			}
+
+			/*
+			Walks the tree front to back along a ray, calling func(proxy, object, maxT)
+			for each leaf whose fat bounds the ray enters before maxT. func returns the
+			new maxT - anything the ray would reach after that gets skipped, so a
+			closest hit query can shrink it every time it finds something. Returning
+			a negative value stops the walk altogether.
+			*/
+			template<typename F>
+			void RayCast(const Vector3& origin, const Vector3& dir, float maxT, F&& func) {
+				if (root == NullNode) {
+					return;
+				}
+				Vector3 invDir = InverseDirection(dir);
+				float tEnter;
+				if (!RayEnters(nodes[root], origin, invDir, maxT, tEnter)) {
+					return;
+				}
+				rayStack.clear();
+				rayStack.push_back({ root, tEnter });
+
+				while (!rayStack.empty()) {
+					RayEntry entry = rayStack.back();
+					rayStack.pop_back();
+
+					if (entry.t > maxT) {
+						continue; //Something closer was found since this was pushed
+					}
+					const Node& n = nodes[entry.node];
+					if (n.IsLeaf()) {
+						maxT = func(entry.node, n.object, maxT);
+						if (maxT < 0.0f) {
+							return;
+						}
+						continue;
+					}
+					float t0, t1;
+					bool hit0 = RayEnters(nodes[n.children[0]], origin, invDir, maxT, t0);
+					bool hit1 = RayEnters(nodes[n.children[1]], origin, invDir, maxT, t1);
+
+					//The nearer child goes on last, so it's looked at first
+					if (hit0 && hit1) {
+						bool firstNearer = t0 <= t1;
+						rayStack.push_back(firstNearer ? RayEntry{ n.children[1], t1 } : RayEntry{ n.children[0], t0 });
+						rayStack.push_back(firstNearer ? RayEntry{ n.children[0], t0 } : RayEntry{ n.children[1], t1 });
+					}
+					else if (hit0) {
+						rayStack.push_back({ n.children[0], t0 });
+					}
+					else if (hit1) {
+						rayStack.push_back({ n.children[1], t1 });
+					}
+				}
+			}
+
+			static constexpr int MaxPacketSize = 32;
+
+			/*
+			Casts up to MaxPacketSize rays down the tree together, so that each node
+			is only visited once for the whole packet rather than once per ray.
+			Each node keeps a mask of which rays are still inside it, and leaves
+			call func(ray, proxy, object, maxT) for each of them, which returns
+			that ray's new maxT just as in RayCast.
+
+			This works best when the rays start near each other and point roughly
+			the same way, like a fan of AI sensor rays - children are visited in
+			order along the first active ray.
+			*/
+			template<typename F>
+			void RayCastPacket(int count, const Vector3* origins, const Vector3* dirs, float* maxT, F&& func) {
+				if (root == NullNode || count <= 0) {
+					return;
+				}
+				count = std::min(count, MaxPacketSize);
+
+				Vector3 invDirs[MaxPacketSize];
+				for (int i = 0; i < count; ++i) {
+					invDirs[i] = InverseDirection(dirs[i]);
+				}
+				packetStack.clear();
+				packetStack.push_back({ root, count == MaxPacketSize ? 0xFFFFFFFFu : (1u << count) - 1 });
+
+				while (!packetStack.empty()) {
+					PacketEntry entry = packetStack.back();
+					packetStack.pop_back();
+
+					const Node& n = nodes[entry.node];
+					uint32_t mask = 0;
+					int first = -1;
+					for (int i = 0; i < count; ++i) {
+						float t;
+						if ((entry.rays & (1u << i)) && RayEnters(n, origins[i], invDirs[i], maxT[i], t)) {
+							mask |= 1u << i;
+							first = first < 0 ? i : first;
+						}
+					}
+					if (!mask) {
+						continue;
+					}
+					if (n.IsLeaf()) {
+						for (int i = first; i < count; ++i) {
+							if (mask & (1u << i)) {
+								maxT[i] = func(i, entry.node, n.object, maxT[i]);
+							}
+						}
+						continue;
+					}
+					const Node& c0 = nodes[n.children[0]];
+					const Node& c1 = nodes[n.children[1]];
+					float d0 = Vector::Dot((c0.min + c0.max) * 0.5f - origins[first], dirs[first]);
+					float d1 = Vector::Dot((c1.min + c1.max) * 0.5f - origins[first], dirs[first]);
+
+					bool firstNearer = d0 <= d1;
+					packetStack.push_back({ n.children[firstNearer ? 1 : 0], mask });
+					packetStack.push_back({ n.children[firstNearer ? 0 : 1], mask });
+				}
+			}
+
+		protected:
+			struct Node {
+				Vector3 min;
+				Vector3 max;
+				T		object;
+
+				int parent		= NullNode; //Doubles as the next pointer while on the free list
+				int children[2] = { NullNode, NullNode };
+				int height		= -1;		//Leaves are 0, free nodes are -1
+
+				bool IsLeaf() const {
+					return children[0] == NullNode;
+				}
+			};
+
+			static bool Overlaps(const Vector3& minA, const Vector3& maxA, const Vector3& minB, const Vector3& maxB) {
+				return	minA.x <= maxB.x && maxA.x >= minB.x &&
+						minA.y <= maxB.y && maxA.y >= minB.y &&
+						minA.z <= maxB.z && maxA.z >= minB.z;
+			}
+
+			//Axis aligned directions get a huge (rather than infinite) inverse, so the slab test never sees 0 * inf
+			static Vector3 InverseDirection(const Vector3& dir) {
+				Vector3 inv;
+				for (int i = 0; i < 3; ++i) {
+					inv[i] = dir[i] != 0.0f ? 1.0f / dir[i] : std::copysign(1e30f, dir[i]);
+				}
+				return inv;
+			}
+
+			//Slab test - gives the distance the ray enters the node's box, if it does before maxT
+			static bool RayEnters(const Node& n, const Vector3& origin, const Vector3& invDir, float maxT, float& tEnter) {
+				float tMin = 0.0f;
+				float tMax = maxT;
+				for (int i = 0; i < 3; ++i) {
+					float t0 = (n.min[i] - origin[i]) * invDir[i];
+					float t1 = (n.max[i] - origin[i]) * invDir[i];
+					tMin = std::max(tMin, std::min(t0, t1));
+					tMax = std::min(tMax, std::max(t0, t1));
+				}
+				tEnter = tMin;
+				return tMin <= tMax;
+			}
+
+			static float SurfaceArea(const Vector3& minB, const Vector3& maxB) {
+				Vector3 d = maxB - minB;
+				return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+			}
+
+			int AllocateNode() {
+				if (freeList == NullNode) {
+					nodes.emplace_back();
+					return (int)nodes.size() - 1;
+				}
+				int index	= freeList;
+				freeList	= nodes[index].parent;
+				nodes[index] = Node();
+				return index;
+			}
+
+			void FreeNode(int index) {
+				nodes[index].parent = freeList;
+				nodes[index].height = -1;
+				freeList = index;
+			}
+
+			void InsertLeaf(int leaf) {
+				if (root == NullNode) {
+					root = leaf;
+					nodes[root].parent = NullNode;
+					return;
+				}
+
+				//Walk down the tree picking whichever child is cheapest to grow
+				Vector3 leafMin = nodes[leaf].min;
+				Vector3 leafMax = nodes[leaf].max;
+				int index = root;
+				while (!nodes[index].IsLeaf()) {
+					int child0 = nodes[index].children[0];
+					int child1 = nodes[index].children[1];
+
+					float area			= SurfaceArea(nodes[index].min, nodes[index].max);
+					float combinedArea	= SurfaceArea(Vector::Min(nodes[index].min, leafMin), Vector::Max(nodes[index].max, leafMax));
+
+					float cost				= 2.0f * combinedArea;
+					float inheritanceCost	= 2.0f * (combinedArea - area);
+
+					float cost0 = DescendCost(child0, leafMin, leafMax) + inheritanceCost;
+					float cost1 = DescendCost(child1, leafMin, leafMax) + inheritanceCost;
+
+					if (cost < cost0 && cost < cost1) {
+						break;
+					}
+					index = cost0 < cost1 ? child0 : child1;
+				}
+				int sibling = index;
+
+				int oldParent = nodes[sibling].parent;
+				int newParent = AllocateNode();
+				nodes[newParent].parent = oldParent;
+				nodes[newParent].min	= Vector::Min(leafMin, nodes[sibling].min);
+				nodes[newParent].max	= Vector::Max(leafMax, nodes[sibling].max);
+				nodes[newParent].height = nodes[sibling].height + 1;
+
+				if (oldParent != NullNode) {
+					if (nodes[oldParent].children[0] == sibling) {
+						nodes[oldParent].children[0] = newParent;
+					}
+					else {
+						nodes[oldParent].children[1] = newParent;
+					}
+				}
+				else {
+					root = newParent;
+				}
+				nodes[newParent].children[0] = sibling;
+				nodes[newParent].children[1] = leaf;
+				nodes[sibling].parent	= newParent;
+				nodes[leaf].parent		= newParent;
+
+				Refit(nodes[leaf].parent);
+			}
+
+			float DescendCost(int child, const Vector3& leafMin, const Vector3& leafMax) const {
+				Vector3 newMin = Vector::Min(nodes[child].min, leafMin);
+				Vector3 newMax = Vector::Max(nodes[child].max, leafMax);
+				if (nodes[child].IsLeaf()) {
+					return SurfaceArea(newMin, newMax);
+				}
+				return SurfaceArea(newMin, newMax) - SurfaceArea(nodes[child].min, nodes[child].max);
+			}
+
+			void RemoveLeaf(int leaf) {
+				if (leaf == root) {
+					root = NullNode;
+					return;
+				}
+				int parent		= nodes[leaf].parent;
+				int grandParent = nodes[parent].parent;
+				int sibling		= nodes[parent].children[0] == leaf ? nodes[parent].children[1] : nodes[parent].children[0];
+
+				if (grandParent != NullNode) {
+					if (nodes[grandParent].children[0] == parent) {
+						nodes[grandParent].children[0] = sibling;
+					}
+					else {
+						nodes[grandParent].children[1] = sibling;
+					}
+					nodes[sibling].parent = grandParent;
+					FreeNode(parent);
+					Refit(grandParent);
+				}
+				else {
+					root = sibling;
+					nodes[sibling].parent = NullNode;
+					FreeNode(parent);
+				}
+			}
+
+			//Walks back up to the root, rebalancing and recomputing bounds
+			void Refit(int index) {
+				while (index != NullNode) {
+					index = Balance(index);
+
+					int child0 = nodes[index].children[0];
+					int child1 = nodes[index].children[1];
+
+					nodes[index].height = 1 + std::max(nodes[child0].height, nodes[child1].height);
+					nodes[index].min	= Vector::Min(nodes[child0].min, nodes[child1].min);
+					nodes[index].max	= Vector::Max(nodes[child0].max, nodes[child1].max);
+
+					index = nodes[index].parent;
+				}
+			}
+
+			//Performs a left or right rotation if node A is imbalanced, returning the new subtree root
+			int Balance(int iA) {
+				Node& A = nodes[iA];
+				if (A.IsLeaf() || A.height < 2) {
+					return iA;
+				}
+				int iB = A.children[0];
+				int iC = A.children[1];
+
+				int balance = nodes[iC].height - nodes[iB].height;
+
+				if (balance > 1) {
+					return Rotate(iA, iC, 1);
+				}
+				if (balance < -1) {
+					return Rotate(iA, iB, 0);
+				}
+				return iA;
+			}
+
+			//Promotes child 'iUp' (at slot 'slot' of iA) above iA
+			int Rotate(int iA, int iUp, int slot) {
+				int iF = nodes[iUp].children[0];
+				int iG = nodes[iUp].children[1];
+
+				nodes[iUp].children[0]	= iA;
+				nodes[iUp].parent		= nodes[iA].parent;
+				nodes[iA].parent		= iUp;
+
+				if (nodes[iUp].parent != NullNode) {
+					int p = nodes[iUp].parent;
+					if (nodes[p].children[0] == iA) {
+						nodes[p].children[0] = iUp;
+					}
+					else {
+						nodes[p].children[1] = iUp;
+					}
+				}
+				else {
+					root = iUp;
+				}
+
+				int other = nodes[iA].children[1 - slot];
+
+				//Keep the taller grandchild up with iUp, hand the shorter one to iA
+				int keep	= nodes[iF].height > nodes[iG].height ? iF : iG;
+				int give	= keep == iF ? iG : iF;
+
+				nodes[iUp].children[1]		= keep;
+				nodes[iA].children[slot]	= give;
+				nodes[give].parent			= iA;
+
+				nodes[iA].min		= Vector::Min(nodes[other].min, nodes[give].min);
+				nodes[iA].max		= Vector::Max(nodes[other].max, nodes[give].max);
+				nodes[iA].height	= 1 + std::max(nodes[other].height, nodes[give].height);
+
+				nodes[iUp].min		= Vector::Min(nodes[iA].min, nodes[keep].min);
+				nodes[iUp].max		= Vector::Max(nodes[iA].max, nodes[keep].max);
+				nodes[iUp].height	= 1 + std::max(nodes[iA].height, nodes[keep].height);
+
+				return iUp;
+			}
+
+			std::vector<Node>	nodes;
+			int					root;
+			int					freeList;
+			int					proxyCount;
+			float				margin;
+
+			struct RayEntry {
+				int		node;
+				float	t;
+			};
+			struct PacketEntry {
+				int			node;
+				uint32_t	rays;
+			};
+			struct NodePair {
+				int a;
+				int b;
+			};
+
+			std::vector<int>			queryStack;
+			std::vector<RayEntry>		rayStack;
+			std::vector<PacketEntry>	packetStack;
+			std::vector<NodePair>		pairStack;
+		};
+	}
+}
@@ -0,0 +1,497 @@
+#include "BatchCollision.h"
+#include <cfloat>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define BATCH_COLLISION_AVX2
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define BATCH_COLLISION_SSE
+#endif
+
+using namespace NCL;
+using namespace CSC8503;
+
+/*
+A thin layer over the intrinsics, so that each test only has to be written
+once, and works with whichever register width we've been compiled for.
+*/
+namespace {
+#if defined(BATCH_COLLISION_AVX2)
+	using Float = __m256;
+	const int laneCount = 8;
+
+	inline Float Load(const float* p)			{ return _mm256_loadu_ps(p); }
+	inline void  Store(float* p, Float a)		{ _mm256_storeu_ps(p, a); }
+	inline Float Set(float f)					{ return _mm256_set1_ps(f); }
+	inline Float Add(Float a, Float b)			{ return _mm256_add_ps(a, b); }
+	inline Float Sub(Float a, Float b)			{ return _mm256_sub_ps(a, b); }
+	inline Float Mul(Float a, Float b)			{ return _mm256_mul_ps(a, b); }
+	inline Float Div(Float a, Float b)			{ return _mm256_div_ps(a, b); }
+	inline Float Sqrt(Float a)					{ return _mm256_sqrt_ps(a); }
+	inline Float And(Float a, Float b)			{ return _mm256_and_ps(a, b); }
+	inline Float Xor(Float a, Float b)			{ return _mm256_xor_ps(a, b); }
+	inline Float AndNot(Float a, Float b)		{ return _mm256_andnot_ps(a, b); }
+	inline Float Less(Float a, Float b)			{ return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+	inline Float Select(Float m, Float a, Float b) { return _mm256_blendv_ps(b, a, m); }
+	inline int	 Mask(Float m)					{ return _mm256_movemask_ps(m); }
+#elif defined(BATCH_COLLISION_SSE)
+	using Float = __m128;
+	const int laneCount = 4;
+
+	inline Float Load(const float* p)			{ return _mm_loadu_ps(p); }
+	inline void  Store(float* p, Float a)		{ _mm_storeu_ps(p, a); }
+	inline Float Set(float f)					{ return _mm_set1_ps(f); }
+	inline Float Add(Float a, Float b)			{ return _mm_add_ps(a, b); }
+	inline Float Sub(Float a, Float b)			{ return _mm_sub_ps(a, b); }
+	inline Float Mul(Float a, Float b)			{ return _mm_mul_ps(a, b); }
+	inline Float Div(Float a, Float b)			{ return _mm_div_ps(a, b); }
+	inline Float Sqrt(Float a)					{ return _mm_sqrt_ps(a); }
+	inline Float And(Float a, Float b)			{ return _mm_and_ps(a, b); }
+	inline Float Xor(Float a, Float b)			{ return _mm_xor_ps(a, b); }
+	inline Float AndNot(Float a, Float b)		{ return _mm_andnot_ps(a, b); }
+	inline Float Less(Float a, Float b)			{ return _mm_cmplt_ps(a, b); }
+	//No blendv before SSE4.1, so pick each lane with the mask instead
+	inline Float Select(Float m, Float a, Float b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+	inline int	 Mask(Float m)					{ return _mm_movemask_ps(m); }
+#else
+	const int laneCount = 1;
+#endif
+
+#if defined(BATCH_COLLISION_AVX2) || defined(BATCH_COLLISION_SSE)
+	inline Float Neg(Float a)	{ return Xor(a, Set(-0.0f)); }
+	inline Float Abs(Float a)	{ return AndNot(Set(-0.0f), a); }
+
+	//Summed in the same order as Vector::LengthSquared
+	inline Float LengthSquared(Float x, Float y, Float z) {
+		return Add(Add(Mul(x, x), Mul(y, y)), Mul(z, z));
+	}
+
+	//Same as std::clamp, including which value wins on a tie
+	inline Float Clamp(Float v, Float lo, Float hi) {
+		return Select(Less(v, lo), lo, Select(Less(hi, v), hi, v));
+	}
+
+	inline void StoreHits(uint8_t* out, Float m) {
+		int bits = Mask(m);
+		for (int j = 0; j < laneCount; ++j) {
+			out[j] = (bits >> j) & 1;
+		}
+	}
+#endif
+
+	//Outputs are sized to match the inputs, rather than the pair count
+	template<typename T>
+	void ResizeOutputs(T& batch, size_t size) {
+		if (batch.hit.size() < size) {
+			batch.normalX.resize(size);
+			batch.normalY.resize(size);
+			batch.normalZ.resize(size);
+			batch.penetration.resize(size);
+			batch.hit.resize(size);
+		}
+	}
+
+	void GrowArrays(std::initializer_list<std::vector<float>*> arrays) {
+		size_t size = std::max((size_t)64, (*arrays.begin())->size() * 2);
+		for (std::vector<float>* v : arrays) {
+			v->resize(size);
+		}
+	}
+
+	template<typename T>
+	void StoreNormal(T& batch, int i, const Vector3& normal, float penetration) {
+		batch.normalX[i]		= normal.x;
+		batch.normalY[i]		= normal.y;
+		batch.normalZ[i]		= normal.z;
+		batch.penetration[i]	= penetration;
+	}
+}
+
+/*
+Adding a pair writes straight into the arrays, rather than pushing onto each
+of them in turn, as the size checks soon add up when there are a dozen of them.
+*/
+void SpherePairBatch::Add(const Vector3& posA, float rA, const Vector3& posB, float rB) {
+	if (count == (int)posAX.size()) {
+		Grow();
+	}
+	int i = count++;
+	posAX[i] = posA.x; posAY[i] = posA.y; posAZ[i] = posA.z; radiusA[i] = rA;
+	posBX[i] = posB.x; posBY[i] = posB.y; posBZ[i] = posB.z; radiusB[i] = rB;
+}
+
+void SpherePairBatch::Clear() {
+	count = 0;
+}
+
+void SpherePairBatch::Grow() {
+	GrowArrays({ &posAX, &posAY, &posAZ, &radiusA, &posBX, &posBY, &posBZ, &radiusB });
+}
+
+void SpherePairBatch::GetContact(int i, CollisionDetection::CollisionInfo& info) const {
+	Vector3 normal(normalX[i], normalY[i], normalZ[i]);
+	info.AddContactPoint(normal * radiusA[i], -normal * radiusB[i], normal, penetration[i]);
+}
+
+void AABBPairBatch::Add(const Vector3& posA, const Vector3& halfA, const Vector3& posB, const Vector3& halfB) {
+	if (count == (int)posAX.size()) {
+		Grow();
+	}
+	int i = count++;
+	posAX[i] = posA.x; posAY[i] = posA.y; posAZ[i] = posA.z;
+	halfAX[i] = halfA.x; halfAY[i] = halfA.y; halfAZ[i] = halfA.z;
+	posBX[i] = posB.x; posBY[i] = posB.y; posBZ[i] = posB.z;
+	halfBX[i] = halfB.x; halfBY[i] = halfB.y; halfBZ[i] = halfB.z;
+}
+
+void AABBPairBatch::Clear() {
+	count = 0;
+}
+
+void AABBPairBatch::Grow() {
+	GrowArrays({	&posAX, &posAY, &posAZ, &halfAX, &halfAY, &halfAZ,
+					&posBX, &posBY, &posBZ, &halfBX, &halfBY, &halfBZ });
+}
+
+void AABBPairBatch::GetContact(int i, CollisionDetection::CollisionInfo& info) const {
+	info.AddContactPoint(Vector3(), Vector3(), Vector3(normalX[i], normalY[i], normalZ[i]), penetration[i]);
+}
+
+void AABBSpherePairBatch::Add(const Vector3& boxPos, const Vector3& boxHalf, const Vector3& spherePos, float r) {
+	if (count == (int)boxX.size()) {
+		Grow();
+	}
+	int i = count++;
+	boxX[i] = boxPos.x; boxY[i] = boxPos.y; boxZ[i] = boxPos.z;
+	halfX[i] = boxHalf.x; halfY[i] = boxHalf.y; halfZ[i] = boxHalf.z;
+	sphereX[i] = spherePos.x; sphereY[i] = spherePos.y; sphereZ[i] = spherePos.z;
+	radius[i] = r;
+}
+
+void AABBSpherePairBatch::Clear() {
+	count = 0;
+}
+
+void AABBSpherePairBatch::Grow() {
+	GrowArrays({	&boxX, &boxY, &boxZ, &halfX, &halfY, &halfZ,
+					&sphereX, &sphereY, &sphereZ, &radius });
+}
+
+void AABBSpherePairBatch::GetContact(int i, CollisionDetection::CollisionInfo& info) const {
+	Vector3 normal(normalX[i], normalY[i], normalZ[i]);
+	info.AddContactPoint(Vector3(), -normal * radius[i], normal, penetration[i]);
+}
+
+int BatchCollision::GetLaneCount() {
+	return laneCount;
+}
+
+const char* BatchCollision::GetInstructionSetName() {
+#if defined(BATCH_COLLISION_AVX2)
+	return "AVX2";
+#elif defined(BATCH_COLLISION_SSE)
+	return "SSE";
+#else
+	return "Scalar";
+#endif
+}
+
+/*
+The scalar versions are the per-pair tests from CollisionDetection, just
+reading their inputs from the batch arrays. The SIMD versions finish off
+any pairs left over at the end of the batch with them.
+*/
+void BatchCollision::SphereIntersectionScalar(SpherePairBatch& batch, int begin) {
+	ResizeOutputs(batch, batch.posAX.size());
+	for (int i = begin; i < batch.Size(); ++i) {
+		Vector3 posA(batch.posAX[i], batch.posAY[i], batch.posAZ[i]);
+		Vector3 posB(batch.posBX[i], batch.posBY[i], batch.posBZ[i]);
+
+		float radii = batch.radiusA[i] + batch.radiusB[i];
+		Vector3 delta = posB - posA;
+
+		float deltaLength = Vector::Length(delta);
+
+		batch.hit[i] = deltaLength < radii;
+		if (batch.hit[i]) {
+			StoreNormal(batch, i, Vector::Normalise(delta), radii - deltaLength);
+		}
+	}
+}
+
+void BatchCollision::AABBIntersectionScalar(AABBPairBatch& batch, int begin) {
+	static const Vector3 faces[6] = {
+		Vector3(-1, 0, 0), Vector3(1, 0, 0),
+		Vector3(0, -1, 0), Vector3(0, 1, 0),
+		Vector3(0, 0, -1), Vector3(0, 0, 1),
+	};
+	ResizeOutputs(batch, batch.posAX.size());
+	for (int i = begin; i < batch.Size(); ++i) {
+		Vector3 boxAPos(batch.posAX[i], batch.posAY[i], batch.posAZ[i]);
+		Vector3 boxBPos(batch.posBX[i], batch.posBY[i], batch.posBZ[i]);
+		Vector3 boxASize(batch.halfAX[i], batch.halfAY[i], batch.halfAZ[i]);
+		Vector3 boxBSize(batch.halfBX[i], batch.halfBY[i], batch.halfBZ[i]);
+
+		batch.hit[i] = CollisionDetection::AABBTest(boxAPos, boxBPos, boxASize, boxBSize);
+		if (!batch.hit[i]) {
+			continue;
+		}
+		Vector3 maxA = boxAPos + boxASize;
+		Vector3 minA = boxAPos - boxASize;
+
+		Vector3 maxB = boxBPos + boxBSize;
+		Vector3 minB = boxBPos - boxBSize;
+
+		float distances[6] = {
+			(maxB.x - minA.x), (maxA.x - minB.x),
+			(maxB.y - minA.y), (maxA.y - minB.y),
+			(maxB.z - minA.z), (maxA.z - minB.z)
+		};
+
+		float penetration = FLT_MAX;
+		Vector3 bestAxis;
+
+		for (int j = 0; j < 6; j++) {
+			if (distances[j] < penetration) {
+				penetration = distances[j];
+				bestAxis = faces[j];
+			}
+		}
+		StoreNormal(batch, i, bestAxis, penetration);
+	}
+}
+
+void BatchCollision::AABBSphereIntersectionScalar(AABBSpherePairBatch& batch, int begin) {
+	ResizeOutputs(batch, batch.boxX.size());
+	for (int i = begin; i < batch.Size(); ++i) {
+		Vector3 boxSize(batch.halfX[i], batch.halfY[i], batch.halfZ[i]);
+		Vector3 delta = Vector3(batch.sphereX[i], batch.sphereY[i], batch.sphereZ[i]) - Vector3(batch.boxX[i], batch.boxY[i], batch.boxZ[i]);
+
+		Vector3 closestPointOnBox = Vector::Clamp(delta, -boxSize, boxSize);
+
+		Vector3 localPoint = delta - closestPointOnBox;
+		float distance = Vector::Length(localPoint);
+
+		batch.hit[i] = distance < batch.radius[i];
+		if (batch.hit[i]) {
+			StoreNormal(batch, i, Vector::Normalise(localPoint), batch.radius[i] - distance);
+		}
+	}
+}
+
+#if defined(BATCH_COLLISION_AVX2) || defined(BATCH_COLLISION_SSE)
+
+/*
+Every lane does the whole test, hit or not, and the results for the lanes
+that missed are just ignored. Normalise leaves a zero length vector alone,
+so the normals are masked off wherever the length was zero.
+*/
+void BatchCollision::SphereIntersection(SpherePairBatch& batch) {
+	ResizeOutputs(batch, batch.posAX.size());
+	const Float zero	= Set(0.0f);
+	const Float one		= Set(1.0f);
+
+	int count	= batch.Size();
+	int i		= 0;
+	for (; i + laneCount <= count; i += laneCount) {
+		Float radii = Add(Load(&batch.radiusA[i]), Load(&batch.radiusB[i]));
+		Float dx	= Sub(Load(&batch.posBX[i]), Load(&batch.posAX[i]));
+		Float dy	= Sub(Load(&batch.posBY[i]), Load(&batch.posAY[i]));
+		Float dz	= Sub(Load(&batch.posBZ[i]), Load(&batch.posAZ[i]));
+
+		Float length	= Sqrt(LengthSquared(dx, dy, dz));
+		Float hit		= Less(length, radii);
+		Float nonZero	= Less(zero, length);
+		Float r			= Div(one, length);
+
+		Store(&batch.normalX[i], And(Mul(dx, r), nonZero));
+		Store(&batch.normalY[i], And(Mul(dy, r), nonZero));
+		Store(&batch.normalZ[i], And(Mul(dz, r), nonZero));
+		Store(&batch.penetration[i], Sub(radii, length));
+		StoreHits(&batch.hit[i], hit);
+	}
+	SphereIntersectionScalar(batch, i);
+}
+
+/*
+The overlap test is just the separating axis test on each world axis. The
+contact normal is the face with the smallest overlap, picked in the same
+order as the scalar loop, so ties go the same way.
+*/
+void BatchCollision::AABBIntersection(AABBPairBatch& batch) {
+	ResizeOutputs(batch, batch.posAX.size());
+	const Float zero	= Set(0.0f);
+	const Float one		= Set(1.0f);
+	const Float minusOne = Set(-1.0f);
+
+	int count	= batch.Size();
+	int i		= 0;
+	for (; i + laneCount <= count; i += laneCount) {
+		Float ax = Load(&batch.posAX[i]), ay = Load(&batch.posAY[i]), az = Load(&batch.posAZ[i]);
+		Float bx = Load(&batch.posBX[i]), by = Load(&batch.posBY[i]), bz = Load(&batch.posBZ[i]);
+		Float hax = Load(&batch.halfAX[i]), hay = Load(&batch.halfAY[i]), haz = Load(&batch.halfAZ[i]);
+		Float hbx = Load(&batch.halfBX[i]), hby = Load(&batch.halfBY[i]), hbz = Load(&batch.halfBZ[i]);
+
+		Float hit = And(And(
+			Less(Abs(Sub(bx, ax)), Add(hax, hbx)),
+			Less(Abs(Sub(by, ay)), Add(hay, hby))),
+			Less(Abs(Sub(bz, az)), Add(haz, hbz)));
+
+		Float distances[6] = {
+			Sub(Add(bx, hbx), Sub(ax, hax)), Sub(Add(ax, hax), Sub(bx, hbx)),
+			Sub(Add(by, hby), Sub(ay, hay)), Sub(Add(ay, hay), Sub(by, hby)),
+			Sub(Add(bz, hbz), Sub(az, haz)), Sub(Add(az, haz), Sub(bz, hbz))
+		};
+		Float penetration = Set(FLT_MAX);
+		Float normal[3] = { zero, zero, zero };
+
+		for (int j = 0; j < 6; ++j) {
+			Float better	= Less(distances[j], penetration);
+			penetration		= Select(better, distances[j], penetration);
+			Float face		= (j & 1) ? one : minusOne;
+			for (int axis = 0; axis < 3; ++axis) {
+				normal[axis] = Select(better, (j / 2 == axis) ? face : zero, normal[axis]);
+			}
+		}
+		Store(&batch.normalX[i], normal[0]);
+		Store(&batch.normalY[i], normal[1]);
+		Store(&batch.normalZ[i], normal[2]);
+		Store(&batch.penetration[i], penetration);
+		StoreHits(&batch.hit[i], hit);
+	}
+	AABBIntersectionScalar(batch, i);
+}
+
+void BatchCollision::AABBSphereIntersection(AABBSpherePairBatch& batch) {
+	ResizeOutputs(batch, batch.boxX.size());
+	const Float zero	= Set(0.0f);
+	const Float one		= Set(1.0f);
+
+	int count	= batch.Size();
+	int i		= 0;
+	for (; i + laneCount <= count; i += laneCount) {
+		Float hx = Load(&batch.halfX[i]), hy = Load(&batch.halfY[i]), hz = Load(&batch.halfZ[i]);
+		Float dx = Sub(Load(&batch.sphereX[i]), Load(&batch.boxX[i]));
+		Float dy = Sub(Load(&batch.sphereY[i]), Load(&batch.boxY[i]));
+		Float dz = Sub(Load(&batch.sphereZ[i]), Load(&batch.boxZ[i]));
+
+		Float lx = Sub(dx, Clamp(dx, Neg(hx), hx));
+		Float ly = Sub(dy, Clamp(dy, Neg(hy), hy));
+		Float lz = Sub(dz, Clamp(dz, Neg(hz), hz));
+
+		Float radius	= Load(&batch.radius[i]);
+		Float distance	= Sqrt(LengthSquared(lx, ly, lz));
+		Float hit		= Less(distance, radius);
+		Float nonZero	= Less(zero, distance);
+		Float r			= Div(one, distance);
+
+		Store(&batch.normalX[i], And(Mul(lx, r), nonZero));
+		Store(&batch.normalY[i], And(Mul(ly, r), nonZero));
+		Store(&batch.normalZ[i], And(Mul(lz, r), nonZero));
+		Store(&batch.penetration[i], Sub(radius, distance));
+		StoreHits(&batch.hit[i], hit);
+	}
+	AABBSphereIntersectionScalar(batch, i);
+}
+
+#else
+
+void BatchCollision::SphereIntersection(SpherePairBatch& batch) {
+	SphereIntersectionScalar(batch);
+}
+
+void BatchCollision::AABBIntersection(AABBPairBatch& batch) {
+	AABBIntersectionScalar(batch);
+}
+
+void BatchCollision::AABBSphereIntersection(AABBSpherePairBatch& batch) {
+	AABBSphereIntersectionScalar(batch);
+}
+
+#endif
+
+void ObjectPairBatch::Clear() {
+	pairs.clear();
+	spheres.Clear();
+	boxes.Clear();
+	boxSpheres.Clear();
+}
+
+/*
+AABB vs sphere pairs are always stored box first, and GetResult swaps the
+objects round to match, just as ObjectIntersection does.
+*/
+bool ObjectPairBatch::Add(GameObject* a, GameObject* b) {
+	const CollisionVolume* volA = a->GetBoundingVolume();
+	const CollisionVolume* volB = b->GetBoundingVolume();
+
+	if (!volA || !volB) {
+		return false;
+	}
+	Vector3 posA = a->GetTransform().GetPosition();
+	Vector3 posB = b->GetTransform().GetPosition();
+
+	VolumeType pairType = (VolumeType)((int)volA->type | (int)volB->type);
+
+	if (pairType == VolumeType::Sphere) {
+		pairs.push_back({ a, b, pairType, spheres.Size() });
+		spheres.Add(posA, ((const SphereVolume&)*volA).GetRadius(), posB, ((const SphereVolume&)*volB).GetRadius());
+		return true;
+	}
+	if (pairType == VolumeType::AABB) {
+		pairs.push_back({ a, b, pairType, boxes.Size() });
+		boxes.Add(posA, ((const AABBVolume&)*volA).GetHalfDimensions(), posB, ((const AABBVolume&)*volB).GetHalfDimensions());
+		return true;
+	}
+	if (pairType == (VolumeType)((int)VolumeType::AABB | (int)VolumeType::Sphere)) {
+		bool swap = volA->type == VolumeType::Sphere;
+		GameObject* box		= swap ? b : a;
+		GameObject* sphere	= swap ? a : b;
+
+		pairs.push_back({ box, sphere, pairType, boxSpheres.Size() });
+		boxSpheres.Add(	box->GetTransform().GetPosition(), ((const AABBVolume&)*box->GetBoundingVolume()).GetHalfDimensions(),
+						sphere->GetTransform().GetPosition(), ((const SphereVolume&)*sphere->GetBoundingVolume()).GetRadius());
+		return true;
+	}
+	return false;
+}
+
+void ObjectPairBatch::Test(bool useSIMD) {
+	if (useSIMD) {
+		BatchCollision::SphereIntersection(spheres);
+		BatchCollision::AABBIntersection(boxes);
+		BatchCollision::AABBSphereIntersection(boxSpheres);
+	}
+	else {
+		BatchCollision::SphereIntersectionScalar(spheres);
+		BatchCollision::AABBIntersectionScalar(boxes);
+		BatchCollision::AABBSphereIntersectionScalar(boxSpheres);
+	}
+}
+
+bool ObjectPairBatch::GetResult(int i, CollisionDetection::CollisionInfo& info) const {
+	const Pair& p = pairs[i];
+	info.a = p.a;
+	info.b = p.b;
+	switch (p.type) {
+		case VolumeType::Sphere:
+			if (spheres.hit[p.index]) {
+				spheres.GetContact(p.index, info);
+				return true;
+			}
+			return false;
+		case VolumeType::AABB:
+			if (boxes.hit[p.index]) {
+				boxes.GetContact(p.index, info);
+				return true;
+			}
+			return false;
+		default:
+			if (boxSpheres.hit[p.index]) {
+				boxSpheres.GetContact(p.index, info);
+				return true;
+			}
+			return false;
+	}
+}
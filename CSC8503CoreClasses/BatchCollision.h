@@ -0,0 +1,146 @@
+#pragma once
+#include "CollisionDetection.h"
+
+namespace NCL {
+	namespace CSC8503 {
+		/*
+		Batches of collision pairs that all share the same volume type
+		combination. Each component lives in its own array, so the tests
+		can load 4 (SSE) or 8 (AVX2) pairs at a time straight out of them.
+
+		Pairs are added with their own volumes and transforms, then once the
+		batch has been tested, GetContact fills in a CollisionInfo exactly as
+		CollisionDetection::ObjectIntersection would have done for that pair.
+
+		Clearing a batch keeps its arrays, which only ever grow, so a batch
+		that gets reused every step stops allocating after the first few.
+		*/
+		struct SpherePairBatch {
+			std::vector<float> posAX, posAY, posAZ, radiusA;
+			std::vector<float> posBX, posBY, posBZ, radiusB;
+
+			std::vector<float>		normalX, normalY, normalZ, penetration;
+			std::vector<uint8_t>	hit;
+
+			void Add(const Vector3& posA, float rA, const Vector3& posB, float rB);
+			void Clear();
+
+			int Size() const {
+				return count;
+			}
+
+			void GetContact(int i, CollisionDetection::CollisionInfo& info) const;
+
+		protected:
+			void Grow();
+			int count = 0;
+		};
+
+		struct AABBPairBatch {
+			std::vector<float> posAX, posAY, posAZ, halfAX, halfAY, halfAZ;
+			std::vector<float> posBX, posBY, posBZ, halfBX, halfBY, halfBZ;
+
+			std::vector<float>		normalX, normalY, normalZ, penetration;
+			std::vector<uint8_t>	hit;
+
+			void Add(const Vector3& posA, const Vector3& halfA, const Vector3& posB, const Vector3& halfB);
+			void Clear();
+
+			int Size() const {
+				return count;
+			}
+
+			void GetContact(int i, CollisionDetection::CollisionInfo& info) const;
+
+		protected:
+			void Grow();
+			int count = 0;
+		};
+
+		//The box is always volume A, as in CollisionDetection::AABBSphereIntersection
+		struct AABBSpherePairBatch {
+			std::vector<float> boxX, boxY, boxZ, halfX, halfY, halfZ;
+			std::vector<float> sphereX, sphereY, sphereZ, radius;
+
+			std::vector<float>		normalX, normalY, normalZ, penetration;
+			std::vector<uint8_t>	hit;
+
+			void Add(const Vector3& boxPos, const Vector3& boxHalf, const Vector3& spherePos, float r);
+			void Clear();
+
+			int Size() const {
+				return count;
+			}
+
+			void GetContact(int i, CollisionDetection::CollisionInfo& info) const;
+
+		protected:
+			void Grow();
+			int count = 0;
+		};
+
+		/*
+		The batched versions of the sphere and AABB tests. The maths is done
+		in the same order as the per-pair tests, so every lane gets exactly
+		the same answer as the scalar code would have.
+
+		Which instruction set gets used is decided at compile time - AVX2 if
+		the compiler has it turned on (see USE_AVX2 in the CMakeLists), SSE
+		otherwise. The scalar versions are always available, mostly so the
+		two can be compared.
+		*/
+		class BatchCollision {
+		public:
+			static void SphereIntersection(SpherePairBatch& batch);
+			static void AABBIntersection(AABBPairBatch& batch);
+			static void AABBSphereIntersection(AABBSpherePairBatch& batch);
+
+			static void SphereIntersectionScalar(SpherePairBatch& batch, int begin = 0);
+			static void AABBIntersectionScalar(AABBPairBatch& batch, int begin = 0);
+			static void AABBSphereIntersectionScalar(AABBSpherePairBatch& batch, int begin = 0);
+
+			//How many pairs each SIMD test handles at once - 1 if there's no SIMD
+			static int GetLaneCount();
+			static const char* GetInstructionSetName();
+
+		private:
+			BatchCollision()	{}
+			~BatchCollision()	{}
+		};
+
+		/*
+		Sorts object pairs into the batches above by their volume types, so
+		a list of broadphase pairs can be tested in bulk. Pairs that don't
+		have a batched test aren't added, and should go through
+		CollisionDetection::ObjectIntersection as normal.
+		*/
+		class ObjectPairBatch {
+		public:
+			void Clear();
+
+			//Returns false (and adds nothing) if this pair needs the per-pair test
+			bool Add(GameObject* a, GameObject* b);
+
+			void Test(bool useSIMD = true);
+
+			int Size() const {
+				return (int)pairs.size();
+			}
+
+			//Gives the same result and contact as ObjectIntersection would for pair i
+			bool GetResult(int i, CollisionDetection::CollisionInfo& info) const;
+
+		protected:
+			struct Pair {
+				GameObject* a;
+				GameObject* b;
+				VolumeType	type;
+				int			index;
+			};
+			std::vector<Pair>	pairs;
+			SpherePairBatch		spheres;
+			AABBPairBatch		boxes;
+			AABBSpherePairBatch	boxSpheres;
+		};
+	}
+}
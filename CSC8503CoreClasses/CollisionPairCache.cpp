@@ -0,0 +1,135 @@
+#include "CollisionPairCache.h"
+#include "GameObject.h"
+
+using namespace NCL;
+using namespace CSC8503;
+
+CollisionPairCache::CollisionPairCache(size_t initialCapacity) {
+	size_t capacity = 16;
+	while (capacity < initialCapacity) {
+		capacity <<= 1;
+	}
+	entries.resize(capacity);
+	mask	= capacity - 1;
+	count	= 0;
+}
+
+CollisionPairCache::~CollisionPairCache() {
+}
+
+uint64_t CollisionPairCache::MakeKey(const GameObject* a, const GameObject* b) {
+	uint32_t idA = (uint32_t)a->GetWorldID();
+	uint32_t idB = (uint32_t)b->GetWorldID();
+	if (idA > idB) {
+		std::swap(idA, idB);
+	}
+	return ((uint64_t)idA << 32) | (uint64_t)idB;
+}
+
+//Finalising mix from splitmix64, so that neighbouring IDs spread across the table
+size_t CollisionPairCache::HomeSlot(uint64_t key) const {
+	key ^= key >> 30;
+	key *= 0xbf58476d1ce4e5b9ull;
+	key ^= key >> 27;
+	key *= 0x94d049bb133111ebull;
+	key ^= key >> 31;
+	return (size_t)key & mask;
+}
+
+CollisionPairCache::Entry& CollisionPairCache::Insert(uint64_t key, bool& isNew) {
+	//Keep the load factor at or below 1/2, so probe sequences stay short
+	if ((count + 1) * 2 > entries.size()) {
+		Grow();
+	}
+	size_t slot = HomeSlot(key);
+	while (true) {
+		Entry& e = entries[slot];
+		if (e.key == key) {
+			isNew = false;
+			return e;
+		}
+		if (e.key == EmptyKey) {
+			e		= Entry();
+			e.key	= key;
+			count++;
+			isNew = true;
+			return e;
+		}
+		slot = (slot + 1) & mask;
+	}
+}
+
+CollisionPairCache::Entry* CollisionPairCache::Find(uint64_t key) {
+	size_t slot = HomeSlot(key);
+	while (true) {
+		Entry& e = entries[slot];
+		if (e.key == key) {
+			return &e;
+		}
+		if (e.key == EmptyKey) {
+			return nullptr;
+		}
+		slot = (slot + 1) & mask;
+	}
+}
+
+/*
+Removal uses backward shifting rather than tombstones: any entries further
+along the probe sequence that could live in the freed slot get moved back,
+so lookups never have to step over deleted entries.
+*/
+bool CollisionPairCache::Remove(uint64_t key) {
+	size_t slot = HomeSlot(key);
+	while (true) {
+		if (entries[slot].key == EmptyKey) {
+			return false;
+		}
+		if (entries[slot].key == key) {
+			break;
+		}
+		slot = (slot + 1) & mask;
+	}
+
+	size_t hole = slot;
+	size_t next = (hole + 1) & mask;
+	while (entries[next].key != EmptyKey) {
+		size_t home = HomeSlot(entries[next].key);
+		//Can the entry at 'next' legally move back to 'hole'?
+		if (((next - home) & mask) >= ((next - hole) & mask)) {
+			entries[hole] = entries[next];
+			hole = next;
+		}
+		next = (next + 1) & mask;
+	}
+	entries[hole].key = EmptyKey;
+	count--;
+	return true;
+}
+
+void CollisionPairCache::Clear() {
+	if (count == 0) {
+		return;
+	}
+	for (Entry& e : entries) {
+		e.key = EmptyKey;
+	}
+	count = 0;
+}
+
+void CollisionPairCache::Grow() {
+	std::vector<Entry> oldEntries;
+	oldEntries.swap(entries);
+
+	entries.resize(oldEntries.size() * 2);
+	mask	= entries.size() - 1;
+	count	= 0;
+
+	for (const Entry& e : oldEntries) {
+		if (e.key == EmptyKey) {
+			continue;
+		}
+		bool isNew = false;
+		Entry& moved = Insert(e.key, isNew);
+		moved = e;
+	}
+}
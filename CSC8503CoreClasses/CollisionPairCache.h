@@ -0,0 +1,70 @@
+#pragma once
+#include "CollisionDetection.h"
+
+namespace NCL {
+	namespace CSC8503 {
+		/*
+		An open addressing hash map of collision pairs, keyed by the world IDs
+		of the two objects packed into 64 bits (smallest ID in the high half).
+
+		Entries live in a single flat array and use linear probing, so adding,
+		finding and removing a pair never allocates (unless the table has to
+		grow), and walking every pair is a walk over contiguous memory.
+		Each entry carries the frame it was last in contact, which is how
+		the PhysicsSystem decides when a collision has begun and ended.
+		*/
+		class CollisionPairCache {
+		public:
+			static const uint64_t EmptyKey = ~0ull;
+
+			struct Entry {
+				uint64_t							key			= EmptyKey;
+				CollisionDetection::CollisionInfo	info;
+				int									lastFrame	= 0;
+				bool								begun		= false;
+			};
+
+			CollisionPairCache(size_t initialCapacity = 256);
+			~CollisionPairCache();
+
+			static uint64_t MakeKey(const GameObject* a, const GameObject* b);
+
+			//Returns the entry for this pair, adding an empty one if it isn't already stored
+			Entry&	Insert(uint64_t key, bool& isNew);
+			Entry*	Find(uint64_t key);
+			bool	Remove(uint64_t key);
+
+			void	Clear();
+
+			size_t	Size() const {
+				return count;
+			}
+
+			template<typename F>
+			void ForEach(F&& func) {
+				for (Entry& e : entries) {
+					if (e.key != EmptyKey) {
+						func(e);
+					}
+				}
+			}
+
+			template<typename F>
+			void ForEach(F&& func) const {
+				for (const Entry& e : entries) {
+					if (e.key != EmptyKey) {
+						func(e);
+					}
+				}
+			}
+
+		protected:
+			size_t	HomeSlot(uint64_t key) const;
+			void	Grow();
+
+			std::vector<Entry>	entries;
+			size_t				count;
+			size_t				mask;
+		};
+	}
+}
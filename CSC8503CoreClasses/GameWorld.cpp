@@ -13,6 +13,7 @@ GameWorld::GameWorld()	{
 	shuffleObjects		= false;
 	worldIDCounter		= 0;
 	worldStateCounter	= 0;
+	boundsCounter		= 0;
 }
 
 GameWorld::~GameWorld()	{
@@ -23,6 +24,11 @@ void GameWorld::Clear() {
 	constraints.clear();
 	worldIDCounter		= 0;
 	worldStateCounter	= 0;
+
+	rayTree.Clear();
+	rayProxies.clear();
+	rayTreeWorldState	= -1;
+	rayTreeBoundsCounter	= -1;
 }
 
 void GameWorld::ClearAndErase() {
@@ -78,45 +84,151 @@ void GameWorld::UpdateWorld(float dt) {
 	}
 }
 
-bool GameWorld::Raycast(Ray& r, RayCollision& closestCollision, bool closestObject, GameObject* ignoreThis) const {
-	//The simplest raycast just goes through each object and sees if there's a collision
-	RayCollision collision;
-
-	for (auto& i : gameObjects) {
-		if (!i->GetBoundingVolume()) { //objects might not be collideable etc...
-			continue;
+namespace {
+	//The per-object part of a raycast, which only ever looks at objects the ray tree says are close
+	bool RayHitsObject(const Ray& r, GameObject* object, GameObject* ignoreThis, RayCollision& collision) {
+		if (object == ignoreThis || !object->GetBoundingVolume()) {
+			return false;
 		}
-		if (i == ignoreThis) {
-			continue;
+		if (object->getCollisionLayer() == CollisionLayer::Terrain) {
+			return false;
 		}
-		if (i->getCollisionLayer() == CollisionLayer::Terrain) {
-			continue;
+		if (!CollisionDetection::RayIntersection(r, *object, collision)) {
+			return false;
 		}
+		collision.node = object;
+		return true;
+	}
+}
 
+/*
+Rather than testing the ray against every object, we walk the ray tree front
+to back, only testing the objects whose bounds the ray passes through. Once
+something has been hit, anything further away than it is skipped, and if we
+don't care which object is closest, the first hit ends the raycast.
+*/
+bool GameWorld::Raycast(Ray& r, RayCollision& closestCollision, bool closestObject, GameObject* ignoreThis) {
+	UpdateRayTree();
+
+	RayCollision collision;
+	rayTree.RayCast(r.GetPosition(), r.GetDirection(), FLT_MAX, [&](int /*proxy*/, GameObject* object, float maxT) {
 		RayCollision thisCollision;
-		if (CollisionDetection::RayIntersection(r, *i, thisCollision)) {
-				
-			if (!closestObject) {	
-				closestCollision		= collision;
-				closestCollision.node = i;
-				return true;
-			}
-			else {
-				if (thisCollision.rayDistance < collision.rayDistance) {
-					thisCollision.node = i;
-					collision = thisCollision;
-				}
-			}
+		if (!RayHitsObject(r, object, ignoreThis, thisCollision) || thisCollision.rayDistance >= collision.rayDistance) {
+			return maxT;
 		}
-	}
+		collision = thisCollision;
+		return closestObject ? collision.rayDistance : -1.0f;
+	});
+
 	if (collision.node) {
-		closestCollision		= collision;
-		closestCollision.node	= collision.node;
+		closestCollision = collision;
 		return true;
 	}
 	return false;
 }
 
+//Rays are sent down the tree in packets, so that nearby rays share the work of walking it
+int GameWorld::RaycastMany(const std::vector<Ray>& rays, std::vector<RayCollision>& collisions, bool closestObject, GameObject* ignoreThis) {
+	UpdateRayTree();
+	collisions.assign(rays.size(), RayCollision());
+
+	const int packetSize = AABBTree<GameObject*>::MaxPacketSize;
+	Vector3 origins[packetSize];
+	Vector3 directions[packetSize];
+	float	maxT[packetSize];
+
+	for (size_t start = 0; start < rays.size(); start += packetSize) {
+		int count = (int)std::min(rays.size() - start, (size_t)packetSize);
+		for (int i = 0; i < count; ++i) {
+			origins[i]		= rays[start + i].GetPosition();
+			directions[i]	= rays[start + i].GetDirection();
+			maxT[i]			= FLT_MAX;
+		}
+		rayTree.RayCastPacket(count, origins, directions, maxT, [&](int ray, int /*proxy*/, GameObject* object, float rayMaxT) {
+			RayCollision& best = collisions[start + ray];
+			RayCollision thisCollision;
+			if (!RayHitsObject(rays[start + ray], object, ignoreThis, thisCollision) || thisCollision.rayDistance >= best.rayDistance) {
+				return rayMaxT;
+			}
+			best = thisCollision;
+			return closestObject ? best.rayDistance : -1.0f;
+		});
+	}
+
+	int hits = 0;
+	for (const RayCollision& c : collisions) {
+		hits += c.node ? 1 : 0;
+	}
+	return hits;
+}
+
+/*
+Brings the ray tree up to date with whatever has been added, removed or moved
+since it was last used. Only objects whose transform has changed since their
+proxy was last fitted get their bounds rebuilt, so a world that's mostly
+standing still costs little more than a version check per object. Even then,
+objects only get re-inserted if they've left their fat bounds.
+Terrain is never raycast against, so it's left out of the tree entirely.
+*/
+void GameWorld::UpdateRayTree() {
+	bool refitAll = rayTreeBoundsCounter != boundsCounter;
+	if (rayTreeWorldState != worldStateCounter) {
+		raySyncStamp++;
+		for (GameObject* o : gameObjects) {
+			int id = o->GetWorldID();
+			if (id >= (int)rayProxies.size()) {
+				rayProxies.resize(id + 1);
+			}
+			RayProxy& p = rayProxies[id];
+			if (p.object != o) {
+				if (p.proxy >= 0) {
+					rayTree.Remove(p.proxy);
+				}
+				p = RayProxy();
+				p.object = o;
+			}
+			p.syncStamp = raySyncStamp;
+		}
+		for (RayProxy& p : rayProxies) {
+			if (p.object && p.syncStamp != raySyncStamp) {
+				if (p.proxy >= 0) {
+					rayTree.Remove(p.proxy);
+				}
+				p = RayProxy();
+			}
+		}
+		rayTreeWorldState = worldStateCounter;
+	}
+
+	for (GameObject* o : gameObjects) {
+		RayProxy& p = rayProxies[o->GetWorldID()];
+		unsigned int version = o->GetTransform().GetVersion();
+		if (p.transformVersion == version && p.fitted && !refitAll) {
+			continue;
+		}
+		p.transformVersion	= version;
+		p.fitted			= true;
+		o->UpdateBroadphaseAABB();
+
+		Vector3 halfSizes;
+		bool inTree = o->GetBroadphaseAABB(halfSizes) && o->getCollisionLayer() != CollisionLayer::Terrain;
+		if (!inTree) {
+			if (p.proxy >= 0) {
+				rayTree.Remove(p.proxy);
+				p.proxy = -1;
+			}
+			continue;
+		}
+		Vector3 pos = o->GetTransform().GetPosition();
+		if (p.proxy < 0) {
+			p.proxy = rayTree.Insert(o, pos, halfSizes);
+		}
+		else {
+			rayTree.Move(p.proxy, pos, halfSizes);
+		}
+	}
+	rayTreeBoundsCounter = boundsCounter;
+}
 
 /*
 Constraint Tutorial Stuff
@@ -4,6 +4,7 @@
 #include "Ray.h"
 #include "CollisionDetection.h"
 #include "QuadTree.h"
+#include "AABBTree.h"
 namespace NCL {
 		class Camera;
 		using Maths::Ray;
@@ -40,7 +41,27 @@ namespace NCL {
 				shuffleObjects = state;
 			}
 
-			bool Raycast(Ray& r, RayCollision& closestCollision, bool closestObject = false, GameObject* ignore = nullptr) const;
+			/*
+			Both raycasts bring the ray tree up to date first, and walk it using
+			scratch space kept in the tree, so neither is safe to call from more
+			than one thread at once.
+			*/
+			bool Raycast(Ray& r, RayCollision& closestCollision, bool closestObject = false, GameObject* ignore = nullptr);
+
+			//Casts every ray, writing each result into the matching entry of collisions
+			//(which has a null node if that ray missed). Returns how many rays hit.
+			int RaycastMany(const std::vector<Ray>& rays, std::vector<RayCollision>& collisions, bool closestObject = true, GameObject* ignore = nullptr);
+
+			/*
+			Raycasts are sped up by a tree of every object's broadphase bounds.
+			Moving an object is picked up by itself, as only objects whose
+			transform has changed get refitted, but changing an object's bounding
+			volume isn't - call this afterwards, and every object gets refitted
+			before the next raycast.
+			*/
+			void BoundsChanged() {
+				boundsCounter++;
+			}
 
 			virtual void UpdateWorld(float dt);
 
@@ -59,6 +80,8 @@ namespace NCL {
 			}
 
 		protected:
+			void UpdateRayTree();
+
 			std::vector<GameObject*> gameObjects;
 			std::vector<Constraint*> constraints;
 
@@ -68,6 +91,21 @@ namespace NCL {
 			bool shuffleObjects;
 			int		worldIDCounter;
 			int		worldStateCounter;
+			int		boundsCounter;
+
+			//Proxies are indexed by world ID, like the PhysicsSystem's broadphase
+			struct RayProxy {
+				GameObject*		object				= nullptr;
+				int				proxy				= -1;
+				int				syncStamp			= 0;
+				unsigned int	transformVersion	= 0;		//Of the transform, when the proxy was last fitted to it
+				bool			fitted				= false;
+			};
+			AABBTree<GameObject*>	rayTree;
+			std::vector<RayProxy>	rayProxies;
+			int						rayTreeWorldState		= -1;
+			int						rayTreeBoundsCounter	= -1;
+			int						raySyncStamp			= 0;
 		};
 	}
 }
@@ -0,0 +1,51 @@
+#include "GrassCulling.h"
+
+using namespace NCL;
+using namespace CSC8503;
+
+int GrassCulling::CompactVisibleBlades(const Vector4* positions, int bladeCount, int stride, const Frustum& frustum,
+	const Vector3& cameraPos, float radius, std::vector<BladeIndex>& visible) {
+	visible.clear();
+	stride = std::max(stride, 1);
+
+	for (int i = 0; i < bladeCount; i += stride) {
+		Vector3 p = Vector3(positions[i]);
+		if (!frustum.SphereInsideFrustum(p, radius)) {
+			continue;
+		}
+		visible.push_back({ Vector::Length(p - cameraPos), (uint32_t)i });
+	}
+	return (int)visible.size();
+}
+
+int GrassCulling::CountMismatches(const BladeIndex* gpu, int gpuCount, const std::vector<BladeIndex>& reference, float distanceTolerance) {
+	auto byIndex = [](const BladeIndex& a, const BladeIndex& b) {
+		return a.index < b.index;
+	};
+	std::vector<BladeIndex> a(gpu, gpu + gpuCount);
+	std::vector<BladeIndex> b(reference);
+	std::sort(a.begin(), a.end(), byIndex);
+	std::sort(b.begin(), b.end(), byIndex);
+
+	int mismatches = 0;
+	size_t i = 0;
+	size_t j = 0;
+	while (i < a.size() && j < b.size()) {
+		if (a[i].index < b[j].index) {
+			mismatches++;
+			i++;
+		}
+		else if (b[j].index < a[i].index) {
+			mismatches++;
+			j++;
+		}
+		else {
+			if (std::abs(a[i].distance - b[j].distance) > distanceTolerance) {
+				mismatches++;
+			}
+			i++;
+			j++;
+		}
+	}
+	return mismatches + (int)(a.size() - i) + (int)(b.size() - j);
+}
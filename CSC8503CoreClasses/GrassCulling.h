@@ -0,0 +1,41 @@
+#pragma once
+#include "GrassFieldGenerator.h"
+#include "Frustum.h"
+
+namespace NCL {
+	using namespace NCL::Maths;
+	namespace CSC8503 {
+		/*
+		A CPU version of bladeCull.comp, so what the GPU gives back can be
+		checked against something.
+
+		Looks at every stride'th blade, treating each one as a sphere of the
+		given radius around its root, and writes a BladeIndex (its distance
+		from the camera, and its index) for every one that's at least partly
+		inside the frustum, packed together at the front of the list. The
+		test is exactly the one Frustum::SphereInsideFrustum does.
+
+		The GPU hands out slots with an atomic counter, so its list comes out
+		in no particular order - use CountMismatches to compare the two.
+		*/
+		class GrassCulling {
+		public:
+			//Positions are laid out as in the blade SSBO - xyz position, w unused here
+			static int CompactVisibleBlades(const Vector4* positions, int bladeCount, int stride, const Frustum& frustum,
+				const Vector3& cameraPos, float radius, std::vector<BladeIndex>& visible);
+
+			/*
+			How many blades are in one list but not the other, ignoring order,
+			plus how many are in both but with distances further apart than
+			distanceTolerance. A blade that's right on the edge of a plane can
+			legitimately go either way, so a handful of mismatches on a big
+			tile isn't necessarily a bug.
+			*/
+			static int CountMismatches(const BladeIndex* gpu, int gpuCount, const std::vector<BladeIndex>& reference, float distanceTolerance = 0.01f);
+
+		private:
+			GrassCulling()	{}
+			~GrassCulling() {}
+		};
+	}
+}
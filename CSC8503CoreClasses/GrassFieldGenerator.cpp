@@ -0,0 +1,171 @@
+#include "GrassFieldGenerator.h"
+#include "../FastNoiseLite/Cpp/FastNoiseLite.h"
+#include <random>
+
+using namespace NCL;
+using namespace CSC8503;
+
+namespace {
+	//Each map gets its own seed, so they don't line up with each other
+	const uint32_t voronoiSeedOffset	= 0;
+	const uint32_t windSeedOffset		= 1;
+	const uint32_t bladeSeedOffset		= 2;
+
+	/*
+	SplitMix64, started from the seed and the blade's id, so every blade gets
+	the same jitter no matter which thread generates it, or when.
+	*/
+	struct BladeRandom {
+		uint64_t state;
+
+		BladeRandom(uint32_t seed, int id) {
+			state = ((uint64_t)seed << 32) ^ (uint64_t)(uint32_t)id;
+		}
+
+		uint32_t Next() {
+			uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+			return (uint32_t)((z ^ (z >> 31)) >> 32);
+		}
+
+		float Range(float low, float high) {
+			return low + (high - low) * ((Next() >> 8) * (1.0f / 16777216.0f));
+		}
+	};
+}
+
+GrassFieldGenerator::GrassFieldGenerator(JobSystem* jobs) : GrassFieldGenerator(std::random_device{}(), jobs) {
+}
+
+GrassFieldGenerator::GrassFieldGenerator(uint32_t seed, JobSystem* jobs) {
+	this->seed	= seed;
+	jobSystem	= jobs;
+}
+
+template<typename F>
+void GrassFieldGenerator::ForEachStrip(int rows, F&& func) const {
+	if (jobSystem) {
+		jobSystem->ParallelFor(rows, rowsPerStrip, [&](int begin, int end, int /*threadIndex*/) {
+			func(begin, end);
+		});
+	}
+	else if (rows > 0) {
+		func(0, rows);
+	}
+}
+
+/*
+The same grid as GrassTile always laid out, with each column of blades
+handled as a unit. Blade ids are worked out from the grid position rather
+than counted, so columns can be filled in any order.
+*/
+void GrassFieldGenerator::GenerateBlades(std::vector<GrassBlade>& blades, int maxBlades, float xLen, float zLen, const Vector3& centre) const {
+	float area		= xLen * zLen;
+	float density	= maxBlades / area;
+
+	int bladesX = static_cast<int>(std::sqrt(density * xLen * zLen));
+	int bladesZ = maxBlades / bladesX;
+
+	int bladeCount = std::min(bladesX * bladesZ, maxBlades);
+	blades.resize(bladeCount);
+
+	FastNoiseLite noise;
+	noise.SetNoiseType(FastNoiseLite::NoiseType_Perlin);
+	noise.SetFrequency(0.1f);
+	noise.SetSeed((int)(seed + bladeSeedOffset));
+
+	ForEachStrip(bladesX, [&](int begin, int end) {
+		for (int i = begin; i < end; ++i) {
+			for (int j = 0; j < bladesZ; ++j) {
+				int id = i * bladesZ + j;
+				if (id >= bladeCount) {
+					return;
+				}
+				BladeRandom random(seed, id);
+
+				GrassBlade& blade = blades[id];
+				blade.id		= id;
+				blade.position	= centre + Vector3((i * (xLen / bladesX)) - xLen * 0.5f, 0.0f, (j * (zLen / bladesZ)) - zLen * 0.5f);
+
+				blade.position.x	+= random.Range(-0.5f, 0.5f);
+				blade.position.z	+= random.Range(-0.5f, 0.5f);
+				blade.faceRotation	= Vector3(0, random.Range(-180.0f, 180.0f), 0);
+				blade.bendAmount	= random.Range(-2.0f, 2.0f);
+
+				blade.noiseValue = noise.GetNoise(blade.position.x, blade.position.z) * 2.0f;
+			}
+		}
+	});
+}
+
+/*
+FastNoiseLite only gives us one sample at a time, so each row is split into
+separate passes - every sample the row needs is taken first, into its own
+array, and then they're all combined in plain loops over those arrays,
+which the compiler is free to vectorise.
+*/
+void GrassFieldGenerator::GenerateVoronoiMap(std::vector<float>& rgba, int width, int height) const {
+	rgba.resize((size_t)width * height * 4);
+
+	FastNoiseLite noise;
+	noise.SetNoiseType(FastNoiseLite::NoiseType_Cellular);
+	noise.SetCellularReturnType(FastNoiseLite::CellularReturnType_Distance2Add);
+	noise.SetSeed((int)(seed + voronoiSeedOffset));
+	noise.SetFrequency(16.0f);
+
+	ForEachStrip(height, [&](int begin, int end) {
+		std::vector<float> centre(width);
+		std::vector<float> right(width);
+		std::vector<float> forward(width);
+
+		for (int y = begin; y < end; ++y) {
+			float v = float(y) / float(height);
+			for (int x = 0; x < width; ++x) {
+				float u = float(x) / float(width);
+				centre[x]	= noise.GetNoise(u, v);
+				right[x]	= noise.GetNoise(u + 0.001f, v);
+				forward[x]	= noise.GetNoise(u, v + 0.001f);
+			}
+			float* row = &rgba[(size_t)y * width * 4];
+			for (int x = 0; x < width; ++x) {
+				row[x * 4 + 0] = right[x] - centre[x];
+				row[x * 4 + 1] = forward[x] - centre[x];
+				row[x * 4 + 2] = std::fabs(centre[x]);
+				row[x * 4 + 3] = 0.0f; // leave empty for comp to calc rotation
+			}
+		}
+	});
+}
+
+//Averaging the four corners of a tileSize square makes the result wrap at its edges
+void GrassFieldGenerator::GenerateWindNoise(std::vector<float>& red, int width, int height, float tileSize) const {
+	red.resize((size_t)width * height);
+
+	FastNoiseLite noise;
+	noise.SetNoiseType(FastNoiseLite::NoiseType_Perlin);
+	noise.SetSeed((int)(seed + windSeedOffset));
+	noise.SetFrequency(0.25f);
+
+	ForEachStrip(height, [&](int begin, int end) {
+		std::vector<float> corners[4];
+		for (std::vector<float>& c : corners) {
+			c.resize(width);
+		}
+		for (int y = begin; y < end; ++y) {
+			float v = float(y) / float(height) * tileSize;
+			for (int x = 0; x < width; ++x) {
+				float u = float(x) / float(width) * tileSize;
+				corners[0][x] = noise.GetNoise(u, v);
+				corners[1][x] = noise.GetNoise(u + tileSize, v);
+				corners[2][x] = noise.GetNoise(u, v + tileSize);
+				corners[3][x] = noise.GetNoise(u + tileSize, v + tileSize);
+			}
+			float* row = &red[(size_t)y * width];
+			for (int x = 0; x < width; ++x) {
+				float noiseValue = (corners[0][x] + corners[1][x] + corners[2][x] + corners[3][x]) * 0.25f;
+				row[x] = (noiseValue + 1.0f) * 0.5f; // [-1, 1] to [0, 1]
+			}
+		}
+	});
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include "JobSystem.h"
+
+namespace NCL {
+	using namespace NCL::Maths;
+	namespace CSC8503 {
+		struct GrassBlade {
+			int id;
+			Vector3 position;
+			Vector3 faceRotation;
+			float bendAmount;
+			float noiseValue;
+		};
+
+		struct BladeIndex {
+			float distance;
+			uint32_t index;
+		};
+
+		/*
+		Fills in everything a grass tile needs before it can be drawn - the blade
+		layout for the CPU path, and the Voronoi and wind noise textures for the
+		compute path - without touching OpenGL, so it can run off the main thread.
+
+		Each job gets a strip of rows (or columns of blades), and every value only
+		depends on its coordinates and the seed, never on which thread made it or
+		in which order, so a fixed seed gives exactly the same field every time,
+		whatever the thread count. Without a seed, a random one is picked when the
+		generator is made, as GrassTile always used to.
+		*/
+		class GrassFieldGenerator {
+		public:
+			//Without a job system, everything is generated on the calling thread
+			GrassFieldGenerator(JobSystem* jobs = nullptr);
+			GrassFieldGenerator(uint32_t seed, JobSystem* jobs = nullptr);
+			~GrassFieldGenerator() {}
+
+			void SetSeed(uint32_t newSeed) {
+				seed = newSeed;
+			}
+
+			uint32_t GetSeed() const {
+				return seed;
+			}
+
+			void SetJobSystem(JobSystem* jobs) {
+				jobSystem = jobs;
+			}
+
+			//Blades are spread over an xLen by zLen area, centred on the given point
+			void GenerateBlades(std::vector<GrassBlade>& blades, int maxBlades, float xLen, float zLen, const Vector3& centre) const;
+
+			//RGBA - x and z offsets towards the nearest cell edge, the distance to it, and an empty channel
+			void GenerateVoronoiMap(std::vector<float>& rgba, int width, int height) const;
+
+			//A single channel of [0, 1] Perlin noise that wraps seamlessly at the edges
+			void GenerateWindNoise(std::vector<float>& red, int width, int height, float tileSize = 16.0f) const;
+
+			static const int rowsPerStrip = 16;
+
+		protected:
+			template<typename F>
+			void ForEachStrip(int rows, F&& func) const;
+
+			JobSystem*	jobSystem;
+			uint32_t	seed;
+		};
+	}
+}
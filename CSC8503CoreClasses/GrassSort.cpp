@@ -0,0 +1,75 @@
+#include "GrassSort.h"
+
+using namespace NCL;
+using namespace CSC8503;
+
+std::vector<BladeSortPass> GrassSort::BuildSchedule(uint32_t count, bool useLocalStages) {
+	std::vector<BladeSortPass> schedule;
+	if (!useLocalStages || count < localSize) {
+		for (uint32_t k = 2; k <= count; k <<= 1) {
+			for (uint32_t j = k >> 1; j > 0; j >>= 1) {
+				schedule.push_back({ k, j, false });
+			}
+		}
+		return schedule;
+	}
+	//Every k up to localSize fits in a single workgroup
+	schedule.push_back({ localSize, localSize >> 1, true });
+
+	for (uint32_t k = localSize << 1; k <= count; k <<= 1) {
+		for (uint32_t j = k >> 1; j >= localSize; j >>= 1) {
+			schedule.push_back({ k, j, false });
+		}
+		schedule.push_back({ k, localSize >> 1, true });
+	}
+	return schedule;
+}
+
+void GrassSort::CompareExchange(BladeIndex* blades, uint32_t i, uint32_t globalIndex, uint32_t k, uint32_t j) {
+	uint32_t partner = i ^ j;
+	if (partner <= i) {
+		return;
+	}
+	bool ascending = (globalIndex & k) == 0;
+	if ((blades[i].distance > blades[partner].distance) == ascending) {
+		std::swap(blades[i], blades[partner]);
+	}
+}
+
+/*
+Within a stage, no two compare-exchanges touch the same element, so doing
+them one after another here gives exactly what the GPU gets doing them all
+at once.
+*/
+void GrassSort::Simulate(std::vector<BladeIndex>& blades, const std::vector<BladeSortPass>& schedule) {
+	uint32_t count = (uint32_t)blades.size();
+	for (const BladeSortPass& pass : schedule) {
+		if (!pass.local) {
+			for (uint32_t i = 0; i < count; ++i) {
+				CompareExchange(blades.data(), i, i, pass.k, pass.j);
+			}
+			continue;
+		}
+		//Each workgroup's block, as if it had been copied into shared memory
+		for (uint32_t block = 0; block < count; block += localSize) {
+			BladeIndex* shared = blades.data() + block;
+			uint32_t firstK = pass.k <= localSize ? 2 : pass.k;
+			for (uint32_t k = firstK; k <= pass.k; k <<= 1) {
+				for (uint32_t j = std::min(k, localSize) >> 1; j > 0; j >>= 1) {
+					for (uint32_t i = 0; i < localSize; ++i) {
+						CompareExchange(shared, i, block + i, k, j);
+					}
+				}
+			}
+		}
+	}
+}
+
+bool GrassSort::IsSorted(const std::vector<BladeIndex>& blades) {
+	for (size_t i = 1; i < blades.size(); ++i) {
+		if (blades[i].distance < blades[i - 1].distance) {
+			return false;
+		}
+	}
+	return true;
+}
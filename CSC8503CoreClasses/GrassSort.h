@@ -0,0 +1,48 @@
+#pragma once
+#include "GrassFieldGenerator.h"
+
+namespace NCL {
+	namespace CSC8503 {
+		//One dispatch of bladeSort.comp
+		struct BladeSortPass {
+			uint32_t	k;
+			uint32_t	j;		//Ignored by local passes, which always start from whichever j is first for their k
+			bool		local;	//Does every stage from j down to 1 in shared memory
+		};
+
+		/*
+		The bitonic sort bladeSort.comp runs, split up into the dispatches
+		GrassTile makes, so the same schedule can be run through on the CPU
+		and checked without a GPU.
+
+		A compare-exchange stage only ever swaps elements j apart, so once j
+		is under the workgroup size, every element a workgroup needs is
+		already in its own block. With local stages turned on, all of those
+		stages are done in one dispatch out of shared memory, rather than a
+		dispatch each - and every k up to the workgroup size can be done in
+		that same first dispatch too. Only the stages with a j of the
+		workgroup size or more still need a dispatch of their own.
+
+		For 32768 blades, that's 36 dispatches instead of 120.
+		*/
+		class GrassSort {
+		public:
+			//Has to match local_size_x in bladeSort.comp
+			static const uint32_t localSize = 256;
+
+			//count has to be a power of two
+			static std::vector<BladeSortPass> BuildSchedule(uint32_t count, bool useLocalStages);
+
+			//Runs each pass just as a dispatch would, sorting blades by distance, nearest first
+			static void Simulate(std::vector<BladeIndex>& blades, const std::vector<BladeSortPass>& schedule);
+
+			static bool IsSorted(const std::vector<BladeIndex>& blades);
+
+		private:
+			GrassSort()		{}
+			~GrassSort()	{}
+
+			static void CompareExchange(BladeIndex* blades, uint32_t i, uint32_t globalIndex, uint32_t k, uint32_t j);
+		};
+	}
+}
@@ -0,0 +1,260 @@
+#include "GrassWind.h"
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define GRASS_WIND_AVX2
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define GRASS_WIND_SSE
+#endif
+
+using namespace NCL;
+using namespace CSC8503;
+
+//The same kind of thin layer over the intrinsics as BatchCollision uses, plus the integer bits sampling needs
+namespace {
+#if defined(GRASS_WIND_AVX2)
+	using Float = __m256;
+	using Int	= __m256i;
+	const int laneCount = 8;
+
+	inline Float Load(const float* p)			{ return _mm256_loadu_ps(p); }
+	inline void  Store(float* p, Float a)		{ _mm256_storeu_ps(p, a); }
+	inline Float Set(float f)					{ return _mm256_set1_ps(f); }
+	inline Float Add(Float a, Float b)			{ return _mm256_add_ps(a, b); }
+	inline Float Sub(Float a, Float b)			{ return _mm256_sub_ps(a, b); }
+	inline Float Mul(Float a, Float b)			{ return _mm256_mul_ps(a, b); }
+
+	inline Int	 SetInt(int i)					{ return _mm256_set1_epi32(i); }
+	inline Int	 AddInt(Int a, Int b)			{ return _mm256_add_epi32(a, b); }
+	inline Int	 AndInt(Int a, Int b)			{ return _mm256_and_si256(a, b); }
+	inline Int	 ShiftLeft(Int a, int bits)		{ return _mm256_sll_epi32(a, _mm_cvtsi32_si128(bits)); }
+	inline Int	 Truncate(Float a)				{ return _mm256_cvttps_epi32(a); }
+	inline Float ToFloat(Int a)					{ return _mm256_cvtepi32_ps(a); }
+	inline Float Gather(const float* p, Int i)	{ return _mm256_i32gather_ps(p, i, 4); }
+#elif defined(GRASS_WIND_SSE)
+	using Float = __m128;
+	using Int	= __m128i;
+	const int laneCount = 4;
+
+	inline Float Load(const float* p)			{ return _mm_loadu_ps(p); }
+	inline void  Store(float* p, Float a)		{ _mm_storeu_ps(p, a); }
+	inline Float Set(float f)					{ return _mm_set1_ps(f); }
+	inline Float Add(Float a, Float b)			{ return _mm_add_ps(a, b); }
+	inline Float Sub(Float a, Float b)			{ return _mm_sub_ps(a, b); }
+	inline Float Mul(Float a, Float b)			{ return _mm_mul_ps(a, b); }
+
+	inline Int	 SetInt(int i)					{ return _mm_set1_epi32(i); }
+	inline Int	 AddInt(Int a, Int b)			{ return _mm_add_epi32(a, b); }
+	inline Int	 AndInt(Int a, Int b)			{ return _mm_and_si128(a, b); }
+	inline Int	 ShiftLeft(Int a, int bits)		{ return _mm_sll_epi32(a, _mm_cvtsi32_si128(bits)); }
+	inline Int	 Truncate(Float a)				{ return _mm_cvttps_epi32(a); }
+	inline Float ToFloat(Int a)					{ return _mm_cvtepi32_ps(a); }
+	//No gather before AVX2, so each lane is loaded on its own
+	inline Float Gather(const float* p, Int i) {
+		alignas(16) int index[4];
+		_mm_store_si128((Int*)index, i);
+		return _mm_set_ps(p[index[3]], p[index[2]], p[index[1]], p[index[0]]);
+	}
+#else
+	const int laneCount = 1;
+#endif
+
+	//Into [0, size), in double so a big time doesn't eat all of the precision
+	inline float Wrap(double texels, int size) {
+		double wrapped = std::fmod(texels, (double)size);
+		return (float)(wrapped < 0.0 ? wrapped + size : wrapped);
+	}
+
+	//Where slice s of a count long list starts - the last slice always ends at count
+	inline size_t SliceStart(size_t count, int slice, int sliceCount) {
+		return count * slice / sliceCount;
+	}
+}
+
+GrassWindTexture GrassWind::BuildTexture(const GrassFieldGenerator& generator, int size, float worldSize) {
+	GrassWindTexture texture;
+	texture.size		= size;
+	texture.worldSize	= worldSize;
+	generator.GenerateWindNoise(texture.texels, size, size);
+	return texture;
+}
+
+void GrassWind::SetTexture(const GrassWindTexture* newTexture) {
+	texture = nullptr;
+	if (!newTexture || newTexture->size <= 0 || (newTexture->size & (newTexture->size - 1)) != 0) {
+		std::cout << __FUNCTION__ << ": wind textures have to be a power of two in size!\n";
+		return;
+	}
+	texture			= newTexture;
+	texelsPerUnit	= texture->size / texture->worldSize;
+	sizeShift		= 0;
+	while ((1 << sizeShift) < texture->size) {
+		sizeShift++;
+	}
+	primed = false;
+}
+
+void GrassWind::SetBlades(const std::vector<GrassBlade>& blades) {
+	size_t count = blades.size();
+	u.resize(count);
+	v.resize(count);
+	from.assign(count, 0.0f);
+	to.assign(count, 0.0f);
+	noise.assign(count, 0.0f);
+
+	if (!texture) {
+		return;
+	}
+	for (size_t i = 0; i < count; ++i) {
+		u[i] = Wrap((double)blades[i].position.x * texelsPerUnit, texture->size);
+		v[i] = Wrap((double)blades[i].position.z * texelsPerUnit, texture->size);
+	}
+	primed = false;
+}
+
+void GrassWind::SetSliceCount(int count) {
+	sliceCount	= std::max(count, 1);
+	primed		= false;
+}
+
+void GrassWind::ScrollOffset(float time, float& offsetU, float& offsetV) const {
+	offsetU = Wrap((double)time * velocity.x * texelsPerUnit, texture->size);
+	offsetV = Wrap((double)time * velocity.y * texelsPerUnit, texture->size);
+}
+
+/*
+tu and tv are both somewhere in [0, 2 * size], so truncating them is the same
+as flooring them, and masking wraps them (and their neighbours) back onto
+the texture.
+*/
+float GrassWind::SampleTexel(float tu, float tv) const {
+	int mask = texture->size - 1;
+	int x0 = (int)tu;
+	int y0 = (int)tv;
+	float fx = tu - (float)x0;
+	float fy = tv - (float)y0;
+
+	int x1 = (x0 + 1) & mask;
+	int y1 = (y0 + 1) & mask;
+	x0 &= mask;
+	y0 &= mask;
+
+	const float* texels = texture->texels.data();
+	float a = texels[(y0 << sizeShift) + x0];
+	float b = texels[(y0 << sizeShift) + x1];
+	float c = texels[(y1 << sizeShift) + x0];
+	float d = texels[(y1 << sizeShift) + x1];
+
+	float top		= a + (b - a) * fx;
+	float bottom	= c + (d - c) * fx;
+	float value		= top + (bottom - top) * fy;
+	return (value * 2.0f - 1.0f) * strength;
+}
+
+float GrassWind::Sample(size_t blade, float time) const {
+	float offsetU;
+	float offsetV;
+	ScrollOffset(time, offsetU, offsetV);
+	return SampleTexel(u[blade] + offsetU, v[blade] + offsetV);
+}
+
+void GrassWind::SampleAll(float time, float* out) const {
+	if (texture) {
+		SampleRange(0, u.size(), time, out);
+	}
+}
+
+//Exactly the same sums as SampleTexel, just a register's worth of blades at a time
+void GrassWind::SampleRange(size_t begin, size_t end, float time, float* out) const {
+	float offsetU;
+	float offsetV;
+	ScrollOffset(time, offsetU, offsetV);
+
+	size_t i = begin;
+#if defined(GRASS_WIND_AVX2) || defined(GRASS_WIND_SSE)
+	const float* texels = texture->texels.data();
+	Int		mask	= SetInt(texture->size - 1);
+	Int		oneInt	= SetInt(1);
+	Float	scrollU = Set(offsetU);
+	Float	scrollV = Set(offsetV);
+	Float	two		= Set(2.0f);
+	Float	one		= Set(1.0f);
+	Float	scale	= Set(strength);
+
+	for (; i + laneCount <= end; i += laneCount) {
+		Float tu = Add(Load(&u[i]), scrollU);
+		Float tv = Add(Load(&v[i]), scrollV);
+
+		Int x0 = Truncate(tu);
+		Int y0 = Truncate(tv);
+		Float fx = Sub(tu, ToFloat(x0));
+		Float fy = Sub(tv, ToFloat(y0));
+
+		Int x1 = AndInt(AddInt(x0, oneInt), mask);
+		Int y1 = AndInt(AddInt(y0, oneInt), mask);
+		x0 = AndInt(x0, mask);
+		y0 = AndInt(y0, mask);
+
+		Int row0 = ShiftLeft(y0, sizeShift);
+		Int row1 = ShiftLeft(y1, sizeShift);
+
+		Float a = Gather(texels, AddInt(row0, x0));
+		Float b = Gather(texels, AddInt(row0, x1));
+		Float c = Gather(texels, AddInt(row1, x0));
+		Float d = Gather(texels, AddInt(row1, x1));
+
+		Float top		= Add(a, Mul(Sub(b, a), fx));
+		Float bottom	= Add(c, Mul(Sub(d, c), fx));
+		Float value		= Add(top, Mul(Sub(bottom, top), fy));
+		Store(&out[i], Mul(Sub(Mul(value, two), one), scale));
+	}
+#endif
+	for (; i < end; ++i) {
+		out[i] = SampleTexel(u[i] + offsetU, v[i] + offsetV);
+	}
+}
+
+void GrassWind::Update(float time, float dt) {
+	size_t count = u.size();
+	if (!texture || count == 0) {
+		return;
+	}
+	//Everything starts off sampled, so there's nothing to blend in from
+	if (!primed) {
+		SampleRange(0, count, time, to.data());
+		from	= to;
+		noise	= to;
+		frame	= 0;
+		primed	= true;
+		return;
+	}
+	frame++;
+
+	//This frame's slice aims for where the wind will be by the last frame before it's next sampled
+	int		slice	= (int)(frame % sliceCount);
+	size_t	begin	= SliceStart(count, slice, sliceCount);
+	size_t	end		= SliceStart(count, slice + 1, sliceCount);
+	std::copy(to.begin() + begin, to.begin() + end, from.begin() + begin);
+	SampleRange(begin, end, time + (sliceCount - 1) * dt, to.data());
+
+	//A slice sampled this frame is 1/K of the way there, one sampled K-1 frames ago has arrived
+	for (int s = 0; s < sliceCount; ++s) {
+		uint32_t framesSince = (frame + sliceCount - s) % sliceCount;
+		float t = float(framesSince + 1) / float(sliceCount);
+
+		size_t i	= SliceStart(count, s, sliceCount);
+		size_t last = SliceStart(count, s + 1, sliceCount);
+#if defined(GRASS_WIND_AVX2) || defined(GRASS_WIND_SSE)
+		Float blend = Set(t);
+		for (; i + laneCount <= last; i += laneCount) {
+			Float a = Load(&from[i]);
+			Store(&noise[i], Add(a, Mul(Sub(Load(&to[i]), a), blend)));
+		}
+#endif
+		for (; i < last; ++i) {
+			noise[i] = from[i] + (to[i] - from[i]) * t;
+		}
+	}
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include "GrassFieldGenerator.h"
+
+namespace NCL {
+	using namespace NCL::Maths;
+	namespace CSC8503 {
+		//A square wind noise texture that wraps at its edges, stretched over worldSize units before it repeats
+		struct GrassWindTexture {
+			std::vector<float>	texels;				//[0, 1]
+			int					size		= 0;	//Has to be a power of two
+			float				worldSize	= 0.0f;
+		};
+
+		/*
+		The wind for the CPU grass paths. Rather than running Perlin noise for
+		every blade every frame, a tileable noise texture is made once, and
+		each blade just bilinearly samples it, with the texture scrolling
+		across the field over time - that's what the compute path's shaders
+		do with perlinWindTex too.
+
+		Everything is kept as separate arrays of floats, one value per blade,
+		so the sampling can be done 4 or 8 blades at a time (SSE or AVX2,
+		whichever we've been compiled for), and GetNoise is just a plain array
+		to copy out of.
+
+		With a slice count of K, only 1/K of the blades sample the texture each
+		frame. Each slice samples where the wind will be when it's next due,
+		and every blade is blended towards that over the frames in between,
+		so blades still move smoothly every frame.
+		*/
+		class GrassWind {
+		public:
+			GrassWind()		{}
+			~GrassWind()	{}
+
+			//Made from GrassFieldGenerator::GenerateWindNoise, so the same seed always gives the same wind
+			static GrassWindTexture BuildTexture(const GrassFieldGenerator& generator, int size = 256, float worldSize = 64.0f);
+
+			//Has to outlive this - it's usually shared between every tile, so the wind lines up across them
+			void SetTexture(const GrassWindTexture* newTexture);
+
+			//Where each blade samples the wind - its root, in world space
+			void SetBlades(const std::vector<GrassBlade>& blades);
+
+			//How fast the texture moves across the world, in units a second, and how far it bends the blades
+			void SetWind(const Vector2& newVelocity, float newStrength) {
+				velocity = newVelocity;
+				strength = newStrength;
+			}
+
+			void SetSliceCount(int count);
+
+			int GetSliceCount() const {
+				return sliceCount;
+			}
+
+			//time keeps counting up from whenever, dt is the step since the last update
+			void Update(float time, float dt);
+
+			//One value per blade, in the order SetBlades got them, from -strength to strength
+			const std::vector<float>& GetNoise() const {
+				return noise;
+			}
+
+			size_t GetBladeCount() const {
+				return u.size();
+			}
+
+			//What the wind is for one blade at a given time, without any vectorising, to check Update against
+			float Sample(size_t blade, float time) const;
+
+			//Samples every blade at once, ignoring the slices
+			void SampleAll(float time, float* out) const;
+
+		protected:
+			void	SampleRange(size_t begin, size_t end, float time, float* out) const;
+			void	ScrollOffset(float time, float& offsetU, float& offsetV) const;
+			float	SampleTexel(float tu, float tv) const;
+
+			const GrassWindTexture* texture = nullptr;
+			int			sizeShift	= 0;
+			float		texelsPerUnit = 0.0f;
+
+			//Each blade's root in texels, wrapped into [0, size)
+			std::vector<float> u;
+			std::vector<float> v;
+
+			std::vector<float> from;	//Where each blade was heading when its slice was last sampled
+			std::vector<float> to;		//Where it's heading now
+			std::vector<float> noise;
+
+			Vector2		velocity	= Vector2(5.0f, 0.0f);
+			float		strength	= 2.0f;
+			int			sliceCount	= 1;
+			uint32_t	frame		= 0;
+			bool		primed		= false;
+		};
+	}
+}
@@ -0,0 +1,150 @@
+#include "JobSystem.h"
+
+using namespace NCL;
+using namespace CSC8503;
+
+namespace {
+	//Which system (if any) the current thread is a worker of, and its index there
+	thread_local const JobSystem*	currentSystem	= nullptr;
+	thread_local int				currentIndex	= 0;
+}
+
+JobSystem::JobSystem(int threadCount) : queues(std::max(threadCount > 0 ? threadCount : (int)std::thread::hardware_concurrency(), 1)) {
+	this->threadCount	= (int)queues.size();
+	queuedJobs			= 0;
+	backgroundJobs		= 0;
+	running				= true;
+
+	for (int i = 1; i < this->threadCount; ++i) {
+		workers.emplace_back([this, i]() {
+			WorkerLoop(i);
+		});
+	}
+}
+
+JobSystem::~JobSystem() {
+	{
+		std::lock_guard<std::mutex> guard(sleepLock);
+		running = false;
+	}
+	sleepCondition.notify_all();
+	for (std::thread& t : workers) {
+		t.join();
+	}
+}
+
+int JobSystem::GetThreadIndex() const {
+	return currentSystem == this ? currentIndex : 0;
+}
+
+void JobSystem::Submit(const JobFunc& func, JobCounter* counter) {
+	if (counter) {
+		counter->pending++;
+	}
+	WorkQueue& queue = queues[GetThreadIndex()];
+	{
+		std::lock_guard<std::mutex> guard(queue.lock);
+		queue.jobs.push_back({ func, counter });
+	}
+	queuedJobs++;
+	{	//Taking the lock means a worker can't miss this between checking and sleeping
+		std::lock_guard<std::mutex> guard(sleepLock);
+	}
+	sleepCondition.notify_all();
+}
+
+void JobSystem::SubmitBackground(const JobFunc& func, JobCounter* counter) {
+	if (workers.empty()) {
+		func(0);
+		return;
+	}
+	if (counter) {
+		counter->pending++;
+	}
+	{
+		std::lock_guard<std::mutex> guard(backgroundQueue.lock);
+		backgroundQueue.jobs.push_back({ func, counter });
+	}
+	backgroundJobs++;
+	{
+		std::lock_guard<std::mutex> guard(sleepLock);
+	}
+	sleepCondition.notify_all();
+}
+
+void JobSystem::Wait(JobCounter& counter) {
+	int threadIndex = GetThreadIndex();
+	while (!counter.IsDone()) {
+		Job job;
+		if (PopJob(threadIndex, job)) {
+			RunJob(job, threadIndex);
+		}
+		else {
+			std::this_thread::yield();
+		}
+	}
+}
+
+void JobSystem::WorkerLoop(int threadIndex) {
+	currentSystem	= this;
+	currentIndex	= threadIndex;
+
+	while (true) {
+		Job job;
+		if (PopJob(threadIndex, job) || PopBackgroundJob(job)) {
+			RunJob(job, threadIndex);
+			continue;
+		}
+		std::unique_lock<std::mutex> guard(sleepLock);
+		sleepCondition.wait(guard, [&]() {
+			return !running || queuedJobs > 0 || backgroundJobs > 0;
+		});
+		if (!running) {
+			return;
+		}
+	}
+}
+
+bool JobSystem::PopJob(int threadIndex, Job& job) {
+	{	//Newest job from our own queue first, it's most likely to still be in cache
+		WorkQueue& queue = queues[threadIndex];
+		std::lock_guard<std::mutex> guard(queue.lock);
+		if (!queue.jobs.empty()) {
+			job = std::move(queue.jobs.back());
+			queue.jobs.pop_back();
+			queuedJobs--;
+			return true;
+		}
+	}
+	//Then the oldest job from anyone else
+	for (int i = 1; i < threadCount; ++i) {
+		WorkQueue& queue = queues[(threadIndex + i) % threadCount];
+		std::lock_guard<std::mutex> guard(queue.lock);
+		if (!queue.jobs.empty()) {
+			job = std::move(queue.jobs.front());
+			queue.jobs.pop_front();
+			queuedJobs--;
+			return true;
+		}
+	}
+	return false;
+}
+
+//Oldest first, so background work gets done in the order it was asked for
+bool JobSystem::PopBackgroundJob(Job& job) {
+	std::lock_guard<std::mutex> guard(backgroundQueue.lock);
+	if (backgroundQueue.jobs.empty()) {
+		return false;
+	}
+	job = std::move(backgroundQueue.jobs.front());
+	backgroundQueue.jobs.pop_front();
+	backgroundJobs--;
+	return true;
+}
+
+void JobSystem::RunJob(Job& job, int threadIndex) {
+	job.func(threadIndex);
+	if (job.counter) {
+		job.counter->pending--;
+	}
+}
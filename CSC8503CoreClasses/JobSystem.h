@@ -0,0 +1,110 @@
+#pragma once
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+namespace NCL {
+	namespace CSC8503 {
+		/*
+		A small work-stealing job system.
+
+		Every thread (including the one that created the system, which counts
+		as thread 0) has its own queue. Threads push and pop jobs at the back
+		of their own queue, and when it runs dry they steal from the front of
+		everyone else's, so a big batch of jobs submitted from one thread
+		quickly spreads itself out across all of them.
+
+		Waiting on a JobCounter doesn't block - the waiting thread helps out by
+		running queued jobs until its counter reaches zero.
+
+		Background jobs go into a queue of their own that only the workers
+		look at, once they've run out of everything else. They're meant for
+		long running work (like generating grass tiles) that shouldn't ever
+		end up being run by the main thread just because it was waiting on
+		something else at the time.
+		*/
+		class JobSystem {
+		public:
+			typedef std::function<void(int threadIndex)> JobFunc;
+
+			struct JobCounter {
+				std::atomic<int> pending = 0;
+
+				bool IsDone() const {
+					return pending.load() == 0;
+				}
+			};
+
+			//A threadCount of 0 uses one thread per hardware core
+			JobSystem(int threadCount = 0);
+			~JobSystem();
+
+			int GetThreadCount() const {
+				return threadCount;
+			}
+
+			//The calling thread's index, from 0 to GetThreadCount() - 1.
+			//Any thread that isn't one of this system's workers is thread 0.
+			int GetThreadIndex() const;
+
+			void Submit(const JobFunc& func, JobCounter* counter = nullptr);
+			void Wait(JobCounter& counter);
+
+			//With no worker threads to hand it to, the job is just run there and then
+			void SubmitBackground(const JobFunc& func, JobCounter* counter = nullptr);
+
+			/*
+			Splits [0, count) into batches of batchSize and calls
+			func(begin, end, threadIndex) for each of them across all threads,
+			returning once every batch is done. Batch boundaries only depend on
+			count and batchSize, never on the thread count, so per-batch
+			results can be merged in a repeatable order.
+			*/
+			template<typename F>
+			void ParallelFor(int count, int batchSize, F&& func) {
+				if (count <= 0) {
+					return;
+				}
+				if (threadCount <= 1 || count <= batchSize) {
+					func(0, count, GetThreadIndex());
+					return;
+				}
+				JobCounter counter;
+				for (int begin = 0; begin < count; begin += batchSize) {
+					int end = std::min(begin + batchSize, count);
+					Submit([&func, begin, end](int threadIndex) {
+						func(begin, end, threadIndex);
+					}, &counter);
+				}
+				Wait(counter);
+			}
+
+		protected:
+			struct Job {
+				JobFunc		func;
+				JobCounter* counter = nullptr;
+			};
+
+			struct WorkQueue {
+				std::mutex		lock;
+				std::deque<Job> jobs;
+			};
+
+			void WorkerLoop(int threadIndex);
+			bool PopJob(int threadIndex, Job& job);
+			bool PopBackgroundJob(Job& job);
+			void RunJob(Job& job, int threadIndex);
+
+			int								threadCount;
+			std::vector<WorkQueue>			queues;
+			WorkQueue						backgroundQueue;
+			std::vector<std::thread>		workers;
+
+			std::mutex						sleepLock;
+			std::condition_variable			sleepCondition;
+			std::atomic<int>				queuedJobs;
+			std::atomic<int>				backgroundJobs;
+			std::atomic<bool>				running;
+		};
+	}
+}
@@ -14,35 +14,65 @@ PhysicsObject::PhysicsObject(Transform* parentTransform, const CollisionVolume*
 }
 
 PhysicsObject::~PhysicsObject()	{
+	if (store) {
+		store->Remove(storeIndex);
+	}
+}
 
+void PhysicsObject::PutToSleep() {
+	SetLinearVelocity(Vector3());
+	SetAngularVelocity(Vector3());
+	asleep		= true;
+	sleepTimer	= 0.0f;
 }
 
 void PhysicsObject::ApplyAngularImpulse(const Vector3& force) {
-	angularVelocity += inverseInertiaTensor * force;  
+	SetAngularVelocity(GetAngularVelocity() + inverseInertiaTensor * force);
 }
 
 void PhysicsObject::ApplyLinearImpulse(const Vector3& force) {
-	linearVelocity += force * inverseMass;
+	SetLinearVelocity(GetLinearVelocity() + force * GetInverseMass());
 }
 
 void PhysicsObject::AddForce(const Vector3& addedForce) {
-	force += addedForce;
+	Wake();
+	SetForce(GetForce() + addedForce);
 }
 
 void PhysicsObject::AddForceAtPosition(const Vector3& addedForce, const Vector3& position) {
 	Vector3 localPos = position - transform->GetPosition();
+	Wake();
 
-	force  += addedForce;
-	torque += Vector::Cross(localPos, addedForce);
+	SetForce(GetForce() + addedForce);
+	SetTorque(GetTorque() + Vector::Cross(localPos, addedForce));
 }
 
 void PhysicsObject::AddTorque(const Vector3& addedTorque) {
-	torque += addedTorque;
+	Wake();
+	SetTorque(GetTorque() + addedTorque);
 }
 
 void PhysicsObject::ClearForces() {
-	force				= Vector3();
-	torque				= Vector3();
+	SetForce(Vector3());
+	SetTorque(Vector3());
+}
+
+void PhysicsObject::SetForce(const Vector3& f) {
+	if (store) {
+		store->SetForce(storeIndex, f);
+	}
+	else {
+		force = f;
+	}
+}
+
+void PhysicsObject::SetTorque(const Vector3& t) {
+	if (store) {
+		store->SetTorque(storeIndex, t);
+	}
+	else {
+		torque = t;
+	}
 }
 
 void PhysicsObject::InitCubeInertia() {
@@ -52,6 +82,8 @@ void PhysicsObject::InitCubeInertia() {
 
 	Vector3 dimsSqr		= fullWidth * fullWidth;
 
+	float inverseMass	= GetInverseMass();
+
 	inverseInertia.x = (12.0f * inverseMass) / (dimsSqr.y + dimsSqr.z);
 	inverseInertia.y = (12.0f * inverseMass) / (dimsSqr.x + dimsSqr.z);
 	inverseInertia.z = (12.0f * inverseMass) / (dimsSqr.x + dimsSqr.y);
@@ -60,7 +92,7 @@ void PhysicsObject::InitCubeInertia() {
 void PhysicsObject::InitSphereInertia() {
 
 	float radius	= Vector::GetMaxElement(transform->GetScale());
-	float i			= 2.5f * inverseMass / (radius*radius);
+	float i			= 2.5f * GetInverseMass() / (radius*radius);
 
 	inverseInertia	= Vector3(i, i, i);
 }
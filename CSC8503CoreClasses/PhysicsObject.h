@@ -1,4 +1,5 @@
 #pragma once
+#include "RigidBodyStore.h"
 using namespace NCL::Maths;
 
 namespace NCL {
@@ -17,27 +18,32 @@ namespace NCL {
 			}
 
 			Vector3 GetLinearVelocity() const {
-				return linearVelocity;
+				return store ? store->GetLinearVelocity(storeIndex) : linearVelocity;
 			}
 
 			Vector3 GetAngularVelocity() const {
-				return angularVelocity;
+				return store ? store->GetAngularVelocity(storeIndex) : angularVelocity;
 			}
 
 			Vector3 GetTorque() const {
-				return torque;
+				return store ? store->GetTorque(storeIndex) : torque;
 			}
 
 			Vector3 GetForce() const {
-				return force;
+				return store ? store->GetForce(storeIndex) : force;
 			}
 
 			void SetInverseMass(float invMass) {
-				inverseMass = invMass;
+				if (store) {
+					store->SetInverseMass(storeIndex, invMass);
+				}
+				else {
+					inverseMass = invMass;
+				}
 			}
 
 			float GetInverseMass() const {
-				return inverseMass;
+				return store ? store->GetInverseMass(storeIndex) : inverseMass;
 			}
 
 			void ApplyAngularImpulse(const Vector3& force);
@@ -53,11 +59,46 @@ namespace NCL {
 			void ClearForces();
 
 			void SetLinearVelocity(const Vector3& v) {
-				linearVelocity = v;
+				Wake();
+				if (store) {
+					store->SetLinearVelocity(storeIndex, v);
+				}
+				else {
+					linearVelocity = v;
+				}
 			}
 
 			void SetAngularVelocity(const Vector3& v) {
-				angularVelocity = v;
+				Wake();
+				if (store) {
+					store->SetAngularVelocity(storeIndex, v);
+				}
+				else {
+					angularVelocity = v;
+				}
+			}
+
+			bool IsAsleep() const {
+				return asleep;
+			}
+
+			//Any force, impulse or velocity change wakes a sleeping body back up
+			void Wake() {
+				if (asleep) {
+					asleep		= false;
+					sleepTimer	= 0.0f;
+				}
+			}
+
+			//Stops the body dead, until something wakes it
+			void PutToSleep();
+
+			float GetSleepTimer() const {
+				return sleepTimer;
+			}
+
+			void SetSleepTimer(float t) {
+				sleepTimer = t;
 			}
 
 			void InitCubeInertia();
@@ -70,6 +111,11 @@ namespace NCL {
 			}
 
 		protected:
+			friend class RigidBodyStore;
+
+			void SetForce(const Vector3& f);
+			void SetTorque(const Vector3& t);
+
 			const CollisionVolume* volume;
 			Transform*		transform;
 
@@ -86,6 +132,13 @@ namespace NCL {
 			Vector3 torque;
 			Vector3 inverseInertia;
 			Matrix3 inverseInertiaTensor;
+
+			bool	asleep		= false;
+			float	sleepTimer	= 0.0f; //How long the body has been still for
+
+			//While in a store, the velocities, forces and inverse mass live there instead
+			RigidBodyStore* store		= nullptr;
+			int				storeIndex	= -1;
 		};
 	}
 }
@@ -8,12 +8,12 @@
 #include "PositionConstraint.h"
 
 #include "Debug.h"
-#include "Window.h"
+#include "Profiler.h"
 #include <functional>
 using namespace NCL;
 using namespace CSC8503;
 
-PhysicsSystem::PhysicsSystem(GameWorld& g) : gameWorld(g)	{
+PhysicsSystem::PhysicsSystem(GameWorld& g) : gameWorld(g), quadTree(Vector2(1024, 1024), 7, 6)	{
 	applyGravity	= false;
 	useBroadPhase	= false;	
 	dTOffset		= 0.0f;
@@ -22,6 +22,50 @@ PhysicsSystem::PhysicsSystem(GameWorld& g) : gameWorld(g)	{
 }
 
 PhysicsSystem::~PhysicsSystem()	{
+	delete jobSystem;
+}
+
+void PhysicsSystem::SetThreadCount(int count) {
+	if (count == GetThreadCount()) {
+		return;
+	}
+	delete jobSystem;
+	jobSystem = count > 1 ? new JobSystem(count) : nullptr;
+}
+
+namespace {
+	const int narrowphaseBatchSize	= 256;
+	const int integrationBatchSize	= 512;
+
+	//Runs func over [0, count) on the job system if we have one, or inline if not
+	template<typename F>
+	void RunBatches(JobSystem* jobs, int count, int batchSize, F&& func) {
+		if (jobs) {
+			jobs->ParallelFor(count, batchSize, func);
+		}
+		else if (count > 0) {
+			func(0, count, 0);
+		}
+	}
+
+	//Static or sleeping, so this body won't move unless something wakes it
+	bool IsResting(GameObject* o) {
+		PhysicsObject* phys = o->GetPhysicsObject();
+		return !phys || phys->GetInverseMass() == 0.0f || phys->IsAsleep();
+	}
+
+	//If neither body can move, there's no point testing them against each other
+	bool IsRestingPair(GameObject* a, GameObject* b) {
+		return IsResting(a) && IsResting(b);
+	}
+
+	//Pairs are ordered by world ID rather than by address, so that the order
+	//objects are resolved in doesn't change from run to run
+	void SetPairObjects(CollisionDetection::CollisionInfo& info, GameObject* x, GameObject* y) {
+		bool swap = x->GetWorldID() > y->GetWorldID();
+		info.a = swap ? y : x;
+		info.b = swap ? x : y;
+	}
 }
 
 void PhysicsSystem::SetGravity(const Vector3& g) {
@@ -39,7 +83,11 @@ any collisions they are in.
 
 */
 void PhysicsSystem::Clear() {
-	allCollisions.clear();
+	allCollisions.Clear();
+	broadphaseCollisionsVec.clear();
+	ClearBroadphase();
+	bodyStore.Clear();
+	bodyStoreWorldState = -1;
 }
 
 /*
@@ -48,10 +96,6 @@ This is the core of the physics engine update
 
 */
 
-bool useSimpleContainer = false;
-
-int constraintIterationCount = 10;
-
 //This is the fixed timestep we'd LIKE to have
 const int   idealHZ = 120;
 const float idealDT = 1.0f / idealHZ;
@@ -65,24 +109,35 @@ being at a low rate.
 int realHZ		= idealHZ;
 float realDT	= idealDT;
 
-void PhysicsSystem::Update(float dt) {
-	if (Window::GetKeyboard()->KeyPressed(KeyCodes::B)) {
-		useBroadPhase = !useBroadPhase;
-		std::cout << "Setting broadphase to " << useBroadPhase << std::endl;
-	}
-	if (Window::GetKeyboard()->KeyPressed(KeyCodes::N)) {
-		useSimpleContainer = !useSimpleContainer;
-		std::cout << "Setting broad container to " << useSimpleContainer << std::endl;
+void PhysicsSystem::UseBodyStore(bool state) {
+	useBodyStore = state;
+	if (!useBodyStore) {
+		bodyStore.Clear();
+		bodyStoreWorldState = -1;
 	}
-	if (Window::GetKeyboard()->KeyPressed(KeyCodes::I)) {
-		constraintIterationCount--;
-		std::cout << "Setting constraint iterations to " << constraintIterationCount << std::endl;
+}
+
+void PhysicsSystem::UseSleeping(bool state) {
+	useSleeping = state;
+	if (!useSleeping) {
+		gameWorld.OperateOnContents([](GameObject* o) {
+			if (o->GetPhysicsObject()) {
+				o->GetPhysicsObject()->Wake();
+			}
+		});
 	}
-	if (Window::GetKeyboard()->KeyPressed(KeyCodes::O)) {
-		constraintIterationCount++;
-		std::cout << "Setting constraint iterations to " << constraintIterationCount << std::endl;
+}
+
+void PhysicsSystem::UseAdaptiveTimestep(bool state) {
+	adaptiveTimestep = state;
+	if (!adaptiveTimestep) {
+		realHZ = idealHZ;
+		realDT = idealDT;
 	}
+}
 
+void PhysicsSystem::Update(float dt) {
+	PROFILE_SCOPE("Physics::Update");
 	dTOffset += dt; //We accumulate time delta here - there might be remainders from previous frame!
 
 	GameTimer t;
@@ -92,15 +147,25 @@ void PhysicsSystem::Update(float dt) {
 		UpdateObjectAABBs();
 	}
 	int iteratorCount = 0;
-	while (dTOffset > realDT) {
+	GameTimer phaseTimer;
+	while (dTOffset >= realDT) { //>= so a frame exactly one step long still gets its step
+		phaseTimer.Tick();
 		IntegrateAccel(realDT); //Update accelerations from external forces
+		phaseTimer.Tick();
+		phaseTimings.integrateAccel += phaseTimer.GetTimeDeltaMSec();
+
 		if (useBroadPhase) {
 			BroadPhase();
+			phaseTimer.Tick();
+			phaseTimings.broadPhase += phaseTimer.GetTimeDeltaMSec();
+
 			NarrowPhase();
 		}
 		else {
 			BasicCollisionDetection();
 		}
+		phaseTimer.Tick();
+		phaseTimings.narrowPhase += phaseTimer.GetTimeDeltaMSec();
 
 		//This is our simple iterative solver - 
 		//we just run things multiple times, slowly moving things forward
@@ -109,20 +174,38 @@ void PhysicsSystem::Update(float dt) {
 		for (int i = 0; i < constraintIterationCount; ++i) {
 			UpdateConstraints(constraintDt);
 		}
+		phaseTimer.Tick();
+		phaseTimings.updateConstraints += phaseTimer.GetTimeDeltaMSec();
+
 		IntegrateVelocity(realDT); //update positions from new velocity changes
+		UpdateSleeping(realDT);
+		phaseTimer.Tick();
+		phaseTimings.integrateVelocity += phaseTimer.GetTimeDeltaMSec();
 
 		dTOffset -= realDT;
 		iteratorCount++;
+		phaseTimings.fixedSteps++;
 	}
-
 	ClearForces();	//Once we've finished with the forces, reset them to zero
 
-	UpdateCollisionList(); //Remove any old collisions
+	if (useBodyStore) { //The integrators left the matrices alone, so catch them up now
+		RunBatches(jobSystem, bodyStore.Size(), integrationBatchSize, [&](int begin, int end, int /*threadIndex*/) {
+			bodyStore.RefreshMatrices(begin, end);
+		});
+	}
 
+	phaseTimer.Tick();
+	UpdateCollisionList(); //Remove any old collisions
+	phaseTimer.Tick();
+	phaseTimings.updateCollisionList += phaseTimer.GetTimeDeltaMSec();
 
 	t.Tick();
 	float updateTime = t.GetTimeDeltaSeconds();
 
+	if (!adaptiveTimestep) {
+		return;
+	}
+
 	//Uh oh, physics is taking too long...
 	if (updateTime > realDT) {
 		realHZ /= 2;
@@ -146,40 +229,56 @@ void PhysicsSystem::Update(float dt) {
 
 /*
 Later on we're going to need to keep track of collisions
-across multiple frames, so we store them in a set.
+across multiple frames, so we store them in a hashed pair cache, keyed
+by the world IDs of the two objects.
 
 The first time they are added, we tell the objects they are colliding.
-The frame they are to be removed, we tell them they're no longer colliding.
+Every frame they're found touching again, their frame stamp gets refreshed,
+and once they've gone numCollisionFrames frames without touching, we tell
+them they're no longer colliding.
 
 From this simple mechanism, we we build up gameplay interactions inside the
 OnCollisionBegin / OnCollisionEnd functions (removing health when hit by a 
 rocket launcher, gaining a point when the player hits the gold coin, and so on).
 */
 void PhysicsSystem::UpdateCollisionList() {
-	for (std::set<CollisionDetection::CollisionInfo>::iterator i = allCollisions.begin();
-		i != allCollisions.end(); ) {
-		if ((*i).framesLeft == numCollisionFrames) {
-			i->a->OnCollisionBegin(i->b);
-			i->b->OnCollisionBegin(i->a);
-		}
-		CollisionDetection::CollisionInfo& in = const_cast<CollisionDetection::CollisionInfo&>(*i);
-		in.framesLeft--;
-		if ((*i).framesLeft < 0) {
-			i->a->OnCollisionEnd(i->b);
-			i->b->OnCollisionEnd(i->a);
-			i = allCollisions.erase(i);
+	PROFILE_SCOPE("Physics::UpdateCollisionList");
+	endedCollisions.clear();
+	allCollisions.ForEach([&](CollisionPairCache::Entry& e) {
+		if (!e.begun) {
+			e.info.a->OnCollisionBegin(e.info.b);
+			e.info.b->OnCollisionBegin(e.info.a);
+			e.begun = true;
 		}
-		else {
-			++i;
+		if (collisionFrame - e.lastFrame >= numCollisionFrames) {
+			e.info.a->OnCollisionEnd(e.info.b);
+			e.info.b->OnCollisionEnd(e.info.a);
+			endedCollisions.push_back(e.key);
 		}
+	});
+	//Removal shuffles entries around, so it can't happen mid-iteration
+	for (uint64_t key : endedCollisions) {
+		allCollisions.Remove(key);
 	}
+	collisionFrame++;
 }
 
+void PhysicsSystem::AddCollision(const CollisionDetection::CollisionInfo& info) {
+	bool isNew = false;
+	CollisionPairCache::Entry& e = allCollisions.Insert(CollisionPairCache::MakeKey(info.a, info.b), isNew);
+	e.info		= info;
+	e.lastFrame = collisionFrame;
+
+	if (useSleeping) {
+		stepContacts.emplace_back(info.a->GetWorldID(), info.b->GetWorldID());
+	}
+}
 
 
 
 
 void PhysicsSystem::UpdateObjectAABBs() {
+	PROFILE_SCOPE("Physics::UpdateObjectAABBs");
 	std::vector<GameObject*>::const_iterator first;
 	std::vector<GameObject*>::const_iterator last;
 	gameWorld.GetObjectIterators(first, last);
@@ -198,6 +297,7 @@ a particular pair will only be added once, so objects colliding for
 multiple frames won't flood the set with duplicates.
 */
 void PhysicsSystem::BasicCollisionDetection() {
+	PROFILE_SCOPE("Physics::BasicCollisionDetection");
 	std::vector<GameObject*>::const_iterator first;
 	std::vector<GameObject*>::const_iterator last;
 	gameWorld.GetObjectIterators(first, last);
@@ -210,12 +310,16 @@ void PhysicsSystem::BasicCollisionDetection() {
 			if ((*j)->GetPhysicsObject() == nullptr) {
 				continue;
 			}
+			if (IsRestingPair(*i, *j)) {
+				KeepRestingContact(*i, *j);
+				continue;
+			}
 			CollisionDetection::CollisionInfo info;
 			if (CollisionDetection::ObjectIntersection(*i, *j, info)) {
 				//std::cout << "Collision between " << (*i)->GetName() << " and " << (*j)->GetName() << std::endl;
 				ImpulseResolveCollision(*info.a, *info.b, info.point);
 				info.framesLeft = numCollisionFrames;
-				allCollisions.insert(info);
+				AddCollision(info);
 			}
 		}
 	}
@@ -298,10 +402,173 @@ and a narrowphase collision detection method. In the broad phase, we
 split the world up using an acceleration structure, so that we can only
 compare the collisions that we absolutely need to. 
 
+The acceleration structure persists between steps - only objects that have
+moved outside of their 'fat' bounds get re-inserted, and static objects sit
+in their own tree, so we never generate pairs between two of them.
+
+Only awake bodies query the trees. A pair of sleeping bodies can't collide,
+so any pair worth testing has at least one awake body in it to find it. When
+most bodies are awake, the dynamic tree is instead walked against itself in
+one pass, skipping the pairs where both bodies are asleep.
+
 */
 void PhysicsSystem::BroadPhase() {
-	broadphaseCollisions.clear();
-	QuadTree<GameObject*> tree(Vector2(1024, 1024), 7, 6);
+	PROFILE_SCOPE("Physics::BroadPhase");
+	broadphaseCollisionsVec.clear();
+	if (useSimpleContainer) {
+		QuadTreeBroadPhase();
+		return;
+	}
+	SyncBroadphaseProxies();
+
+	CollisionDetection::CollisionInfo info;
+	//With most bodies awake it's cheaper to walk the dynamic tree against itself than query it once per body
+	bool walkPairs = activeBodies.size() * 2 >= (size_t)dynamicTree.GetProxyCount();
+	if (walkPairs) {
+		dynamicTree.QueryPairs([&](int, GameObject* a, int, GameObject* b) {
+			if (!a->GetPhysicsObject()->IsAsleep() || !b->GetPhysicsObject()->IsAsleep()) {
+				SetPairObjects(info, a, b);
+				broadphaseCollisionsVec.push_back(info);
+			}
+		});
+	}
+	for (GameObject* o : activeBodies) {
+		const BroadphaseProxy& p = broadphaseProxies[o->GetWorldID()];
+		if (!p.object || p.isStatic) {
+			continue;
+		}
+		if (!walkPairs) {
+			dynamicTree.QueryProxy(p.proxy, [&](int otherProxy, GameObject* other) {
+				//Awake pairs are found from both ends, so are only kept once. Sleeping bodies don't query, so their pairs are always kept
+				if (otherProxy > p.proxy || other->GetPhysicsObject()->IsAsleep()) {
+					SetPairObjects(info, p.object, other);
+					broadphaseCollisionsVec.push_back(info);
+				}
+				return true;
+			});
+		}
+		//The proxy handle belongs to the dynamic tree, so query the static tree by bounds
+		Vector3 fatMin;
+		Vector3 fatMax;
+		dynamicTree.GetFatBounds(p.proxy, fatMin, fatMax);
+		staticTree.Query(fatMin, fatMax, [&](int /*otherProxy*/, GameObject* other) {
+			SetPairObjects(info, p.object, other);
+			broadphaseCollisionsVec.push_back(info);
+			return true;
+		});
+	}
+}
+
+/*
+Brings the broadphase trees up to date with the world. If objects have been
+added or removed since the last step we resync the proxy list, and every
+object gets its fat bounds checked against its current position.
+
+Otherwise, only bodies that can have moved since the last step get checked -
+the awake, dynamic ones, plus any that were moved and then put to sleep at
+the end of the last step. Statics are left alone until the next resync, so
+one moved by hand won't be noticed until the world next changes.
+*/
+void PhysicsSystem::SyncBroadphaseProxies() {
+	if (broadphaseWorldState == gameWorld.GetWorldStateID()) {
+		for (GameObject* o : activeBodies) {
+			SyncBroadphaseProxy(o);
+		}
+		for (GameObject* o : broadphaseSleepers) {
+			SyncBroadphaseProxy(o);
+		}
+		broadphaseSleepers.clear();
+		return;
+	}
+	std::vector<GameObject*>::const_iterator first;
+	std::vector<GameObject*>::const_iterator last;
+	gameWorld.GetObjectIterators(first, last);
+
+	broadphaseSleepers.clear(); //Might include objects that have since been removed
+	broadphaseSyncStamp++;
+	for (auto i = first; i != last; ++i) {
+		int id = (*i)->GetWorldID();
+		if (id >= (int)broadphaseProxies.size()) {
+			broadphaseProxies.resize(id + 1);
+		}
+		if (broadphaseProxies[id].object != *i) {
+			RemoveBroadphaseProxy(id);
+			AddBroadphaseProxy(*i);
+		}
+		broadphaseProxies[id].syncStamp = broadphaseSyncStamp;
+	}
+	for (int id = 0; id < (int)broadphaseProxies.size(); ++id) {
+		if (broadphaseProxies[id].syncStamp != broadphaseSyncStamp) {
+			RemoveBroadphaseProxy(id);
+		}
+	}
+	broadphaseWorldState = gameWorld.GetWorldStateID();
+
+	for (auto i = first; i != last; ++i) {
+		SyncBroadphaseProxy(*i);
+	}
+}
+
+//Only re-inserts the object if it's left its fat bounds, or moved between the static and dynamic trees
+void PhysicsSystem::SyncBroadphaseProxy(GameObject* object) {
+	BroadphaseProxy& p = broadphaseProxies[object->GetWorldID()];
+	if (!p.object) {
+		return;
+	}
+	PhysicsObject* phys = object->GetPhysicsObject();
+	bool isStatic = !phys || phys->GetInverseMass() == 0.0f;
+
+	Vector3 halfSizes;
+	object->GetBroadphaseAABB(halfSizes);
+	Vector3 pos = object->GetTransform().GetPosition();
+
+	if (isStatic != p.isStatic) { //Mass has changed, so swap trees
+		(p.isStatic ? staticTree : dynamicTree).Remove(p.proxy);
+		p.isStatic	= isStatic;
+		p.proxy		= (p.isStatic ? staticTree : dynamicTree).Insert(object, pos, halfSizes);
+	}
+	else {
+		(p.isStatic ? staticTree : dynamicTree).Move(p.proxy, pos, halfSizes);
+	}
+}
+
+void PhysicsSystem::AddBroadphaseProxy(GameObject* object) {
+	Vector3 halfSizes;
+	if (!object->GetBroadphaseAABB(halfSizes)) {
+		return;
+	}
+	PhysicsObject* phys = object->GetPhysicsObject();
+
+	BroadphaseProxy& p = broadphaseProxies[object->GetWorldID()];
+	p.object	= object;
+	p.isStatic	= !phys || phys->GetInverseMass() == 0.0f;
+	p.proxy		= (p.isStatic ? staticTree : dynamicTree).Insert(object, object->GetTransform().GetPosition(), halfSizes);
+}
+
+void PhysicsSystem::RemoveBroadphaseProxy(int worldID) {
+	BroadphaseProxy& p = broadphaseProxies[worldID];
+	if (p.object) {
+		(p.isStatic ? staticTree : dynamicTree).Remove(p.proxy);
+	}
+	p = BroadphaseProxy();
+}
+
+void PhysicsSystem::ClearBroadphase() {
+	staticTree.Clear();
+	dynamicTree.Clear();
+	broadphaseProxies.clear();
+	broadphaseSleepers.clear();
+	broadphaseWorldState = -1;
+}
+
+/*
+The original broadphase, which refills a QuadTree every step. Kept around
+as the 'simple container' so the two can be compared. The tree is reset
+rather than rebuilt, so its memory is reused between steps.
+*/
+void PhysicsSystem::QuadTreeBroadPhase() {
+	quadTree.Reset();
+	broadphasePairs.Clear();
 
 	std::vector<GameObject*>::const_iterator first;
 	std::vector<GameObject*>::const_iterator last;
@@ -313,18 +580,21 @@ void PhysicsSystem::BroadPhase() {
 			continue;
 		}
 		Vector3 pos = (*i)->GetTransform().GetPosition();
-		tree.Insert(*i, pos, halfSizes);
+		quadTree.Insert(*i, pos, halfSizes);
 	}
-	tree.OperateOnContents([&](std::list<QuadTreeEntry<GameObject*>>& data) {
+	quadTree.OperateOnContents([&](QuadTreeEntryRange<GameObject*>& data) {
 		CollisionDetection::CollisionInfo info;
 		for (auto i = data.begin(); i != data.end(); ++i) {
 			for (auto j = std::next(i); j != data.end(); ++j) {
 
 				// is this pair of items already in the broadphase set?
 				// if so, we don't need to add it again
-				info.a = std::min((*i).object, (*j).object);
-				info.b = std::max((*i).object, (*j).object);
-				broadphaseCollisions.insert(info);
+				bool isNew = false;
+				broadphasePairs.Insert(CollisionPairCache::MakeKey((*i).object, (*j).object), isNew);
+				if (isNew) {
+					SetPairObjects(info, (*i).object, (*j).object);
+					broadphaseCollisionsVec.push_back(info);
+				}
 
 			}
 		}
@@ -335,14 +605,89 @@ void PhysicsSystem::BroadPhase() {
 
 The broadphase will now only give us likely collisions, so we can now go through them,
 and work out if they are truly colliding, and if so, add them into the main collision list
+
+With multiple threads, the pair tests are run in parallel batches, each writing
+its contacts into its own buffer. The buffers are then resolved in batch order,
+so the result doesn't depend on which thread ran which batch. As the tests now
+all see the positions from before any contact was resolved, this won't match
+the single threaded results exactly, but it will always match itself.
+
+The batched narrowphase (only built with USE_BATCHED_NARROWPHASE) works the
+same way, but first gathers up each batch's sphere and AABB pairs and tests
+them several at a time with SIMD. Those tests give exactly the same contacts
+as the per-pair ones, so turning it on doesn't change the results of the
+multithreaded path at all.
 */
 void PhysicsSystem::NarrowPhase() {
-	for (std::set<CollisionDetection::CollisionInfo>::iterator i = broadphaseCollisions.begin(); i != broadphaseCollisions.end(); ++i) {
-		CollisionDetection::CollisionInfo info = *i;
-		if (CollisionDetection::ObjectIntersection(info.a, info.b, info)) {
-			info.framesLeft = numCollisionFrames;
+	PROFILE_SCOPE("Physics::NarrowPhase");
+	if (!jobSystem && !useBatchedNarrowPhase) {
+		for (const CollisionDetection::CollisionInfo& pair : broadphaseCollisionsVec) {
+			if (IsRestingPair(pair.a, pair.b)) {
+				KeepRestingContact(pair.a, pair.b);
+				continue;
+			}
+			CollisionDetection::CollisionInfo info = pair;
+			if (CollisionDetection::ObjectIntersection(info.a, info.b, info)) {
+				info.framesLeft = numCollisionFrames;
+				ImpulseResolveCollision(*info.a, *info.b, info.point);
+				AddCollision(info);// insert into main cache
+			}
+		}
+		return;
+	}
+	int pairCount	= (int)broadphaseCollisionsVec.size();
+	int batchCount	= (pairCount + narrowphaseBatchSize - 1) / narrowphaseBatchSize;
+	if ((int)narrowphaseBatches.size() < batchCount) {
+		narrowphaseBatches.resize(batchCount);
+	}
+	for (int i = 0; i < batchCount; ++i) {
+		narrowphaseBatches[i].contacts.clear();
+	}
+
+	RunBatches(jobSystem, pairCount, narrowphaseBatchSize, [&](int begin, int end, int /*threadIndex*/) {
+		NarrowphaseBatch& batch = narrowphaseBatches[begin / narrowphaseBatchSize];
+#ifdef USE_BATCHED_NARROWPHASE
+		if (useBatchedNarrowPhase) {
+			batch.simdPairs.Clear();
+			batch.simdIndices.clear();
+			for (int i = begin; i < end; ++i) {
+				const CollisionDetection::CollisionInfo& pair = broadphaseCollisionsVec[i];
+				bool added = !IsRestingPair(pair.a, pair.b) && batch.simdPairs.Add(pair.a, pair.b);
+				batch.simdIndices.push_back(added ? batch.simdPairs.Size() - 1 : -1);
+			}
+			batch.simdPairs.Test();
+		}
+#endif
+		for (int i = begin; i < end; ++i) {
+			CollisionDetection::CollisionInfo info = broadphaseCollisionsVec[i];
+			if (IsRestingPair(info.a, info.b)) {
+				continue;
+			}
+#ifdef USE_BATCHED_NARROWPHASE
+			int simdIndex = useBatchedNarrowPhase ? batch.simdIndices[i - begin] : -1;
+			bool colliding = simdIndex >= 0 ?
+				batch.simdPairs.GetResult(simdIndex, info) :
+				CollisionDetection::ObjectIntersection(info.a, info.b, info);
+#else
+			bool colliding = CollisionDetection::ObjectIntersection(info.a, info.b, info);
+#endif
+
+			if (colliding) {
+				info.framesLeft = numCollisionFrames;
+				batch.contacts.push_back(info);
+			}
+		}
+	});
+
+	for (const CollisionDetection::CollisionInfo& pair : broadphaseCollisionsVec) {
+		if (IsRestingPair(pair.a, pair.b)) {
+			KeepRestingContact(pair.a, pair.b);
+		}
+	}
+	for (int i = 0; i < batchCount; ++i) {
+		for (CollisionDetection::CollisionInfo& info : narrowphaseBatches[i].contacts) {
 			ImpulseResolveCollision(*info.a, *info.b, info.point);
-			allCollisions.insert(info);// insert into main set
+			AddCollision(info);
 		}
 	}
 }
@@ -355,49 +700,56 @@ without worrying about repeated forces accumulating etc.
 This function will update both linear and angular acceleration,
 based on any forces that have been accumulated in the objects during
 the course of the previous game frame.
+
+Every object is integrated independently, so the objects are split
+into batches which can run on any thread.
 */
 void PhysicsSystem::IntegrateAccel(float dt) {
-	std::vector<GameObject*>::const_iterator first;
-	std::vector<GameObject*>::const_iterator last;
-	gameWorld.GetObjectIterators(first, last);
-
-	for (auto i = first; i != last; ++i) {
-		PhysicsObject* object = (*i)->GetPhysicsObject();
-		if (object == nullptr) {
-			continue; // no physics object for this game object
-		}
+	PROFILE_SCOPE("Physics::IntegrateAccel");
+	UpdateActiveBodies();
+	if (useBodyStore) {
+		SyncBodyStore();
+		RunBatches(jobSystem, bodyStore.Size(), integrationBatchSize, [&](int begin, int end, int /*threadIndex*/) {
+			bodyStore.IntegrateAccel(begin, end, dt, gravity, applyGravity);
+		});
+		return;
+	}
+	RunBatches(jobSystem, (int)activeBodies.size(), integrationBatchSize, [&](int begin, int end, int /*threadIndex*/) {
+		for (auto i = activeBodies.begin() + begin; i != activeBodies.begin() + end; ++i) {
+			PhysicsObject* object = (*i)->GetPhysicsObject();
 
-		float inversemass = object->GetInverseMass();
+			float inversemass = object->GetInverseMass();
 
-		Vector3 linearVel = object->GetLinearVelocity();
-		Vector3 force = object->GetForce();
-		Vector3 accel = force * inversemass;
+			Vector3 linearVel = object->GetLinearVelocity();
+			Vector3 force = object->GetForce();
+			Vector3 accel = force * inversemass;
 
-		/*if (applyGravity && (inversemass > 0 && (*i)->getCollisionLayer() != CollisionLayer::Camera)) {
-			accel += gravity; // don't move if infinite mass or object is camera
-		}*/
+			/*if (applyGravity && (inversemass > 0 && (*i)->getCollisionLayer() != CollisionLayer::Camera)) {
+				accel += gravity; // don't move if infinite mass or object is camera
+			}*/
 
-		if ((*i)->getCollisionLayer() != CollisionLayer::Camera) {
+			if ((*i)->getCollisionLayer() != CollisionLayer::Camera) {
 
-			if (applyGravity && inversemass > 0) {
-				accel += gravity; // don't move if infinite mass
+				if (applyGravity && inversemass > 0) {
+					accel += gravity; // don't move if infinite mass
+				}
 			}
-		}
 
-		linearVel += accel * dt; // integrate acceleration to get new velocity
-		object->SetLinearVelocity(linearVel);
+			linearVel += accel * dt; // integrate acceleration to get new velocity
+			object->SetLinearVelocity(linearVel);
 
-		//angular stuff
-		Vector3 torque = object->GetTorque();
-		Vector3 angularVel = object->GetAngularVelocity();
+			//angular stuff
+			Vector3 torque = object->GetTorque();
+			Vector3 angularVel = object->GetAngularVelocity();
 
-		object->UpdateInertiaTensor(); // update tensor vs orientation
+			object->UpdateInertiaTensor(); // update tensor vs orientation
 
-		Vector3 angularAccel = object->GetInertiaTensor() * torque;
+			Vector3 angularAccel = object->GetInertiaTensor() * torque;
 
-		angularVel += angularAccel * dt; // integrate angular acceleration to get new velocity
-		object->SetAngularVelocity(angularVel);
-	}
+			angularVel += angularAccel * dt; // integrate angular acceleration to get new velocity
+			object->SetAngularVelocity(angularVel);
+		}
+	});
 }
 
 /*
@@ -407,57 +759,194 @@ throughout a physics update, to slowly move the objects through
 the world, looking for collisions.
 */
 void PhysicsSystem::IntegrateVelocity(float dt) {
+	PROFILE_SCOPE("Physics::IntegrateVelocity");
+	if (useBodyStore) {
+		SyncBodyStore();
+		RunBatches(jobSystem, bodyStore.Size(), integrationBatchSize, [&](int begin, int end, int /*threadIndex*/) {
+			bodyStore.IntegrateVelocity(begin, end, dt);
+		});
+		return;
+	}
+	float frameLinearDamping = 1.0f - (0.4f * dt);
+
+	RunBatches(jobSystem, (int)activeBodies.size(), integrationBatchSize, [&](int begin, int end, int /*threadIndex*/) {
+		for (auto i = activeBodies.begin() + begin; i != activeBodies.begin() + end; ++i) {
+			PhysicsObject* object = (*i)->GetPhysicsObject();
+
+			Transform& transform = (*i)->GetTransform();
+			// Position Stuff
+			Vector3 position = transform.GetPosition();
+			Vector3 linearVel = object->GetLinearVelocity();
+			position += linearVel * dt;
+			transform.SetPosition(position);
+			// linear damping
+			linearVel = linearVel * frameLinearDamping;
+			object->SetLinearVelocity(linearVel);
+
+			// Orientation Stuff
+			Quaternion orientation = transform.GetOrientation();
+			Vector3 angularVel = object->GetAngularVelocity();
+
+			orientation = orientation + Quaternion(angularVel * dt * 0.5f, 0.0f) * orientation;
+			orientation.Normalise();
+
+			transform.SetOrientation(orientation);
+
+			//Damp the angular velocity
+			float frameAngularDamping = 1.0f - (0.4f * dt);
+			angularVel = angularVel * frameAngularDamping;
+			object->SetAngularVelocity(angularVel);
+		}
+	});
+}
+
+/*
+Once we're finished with a physics update, we have to
+clear out any accumulated forces, ready to receive new
+ones in the next 'game' frame.
+*/
+void PhysicsSystem::ClearForces() {
+	if (useBodyStore) {
+		SyncBodyStore();
+		bodyStore.ClearForces(0, bodyStore.Size());
+		return;
+	}
+	gameWorld.OperateOnContents(
+		[](GameObject* o) {
+			o->GetPhysicsObject()->ClearForces();
+		}
+	);
+}
+
+
+/*
+Works out which bodies need integrating this step. Static bodies never move,
+so are never integrated, and sleeping bodies are left alone until woken.
+*/
+void PhysicsSystem::UpdateActiveBodies() {
 	std::vector<GameObject*>::const_iterator first;
 	std::vector<GameObject*>::const_iterator last;
 	gameWorld.GetObjectIterators(first, last);
-	
-	float frameLinearDamping = 1.0f - (0.4f * dt);
 
+	activeBodies.clear();
+	bodyCounts = PhysicsBodyCounts();
 	for (auto i = first; i != last; ++i) {
 		PhysicsObject* object = (*i)->GetPhysicsObject();
 		if (object == nullptr) {
-			continue; // no physics object for this game object
+			continue;
+		}
+		if (object->GetInverseMass() == 0.0f) {
+			bodyCounts.statics++;
 		}
+		else if (object->IsAsleep()) {
+			bodyCounts.asleep++;
+		}
+		else {
+			bodyCounts.awake++;
+			activeBodies.push_back(*i);
+		}
+	}
+}
 
-		Transform& transform = (*i)->GetTransform();
-		// Position Stuff
-		Vector3 position = transform.GetPosition();
-		Vector3 linearVel = object->GetLinearVelocity();
-		position += linearVel * dt;
-		transform.SetPosition(position);
-		// linear damping
-		linearVel = linearVel * frameLinearDamping;
-		object->SetLinearVelocity(linearVel);
+/*
+Every body that was integrated this step either adds to its sleep timer, if
+it's moving slowly enough, or has it reset. Bodies that touched each other
+this step are then joined into islands, and an island only goes to sleep
+once every body in it has been still for long enough - so a stack of boxes
+goes to sleep together, rather than the bottom box sleeping while the rest
+of the stack is still settling on top of it.
+*/
+void PhysicsSystem::UpdateSleeping(float dt) {
+	PROFILE_SCOPE("Physics::UpdateSleeping");
+	if (!useSleeping) {
+		stepContacts.clear();
+		return;
+	}
+	islandStampCounter++;
+	float linearSq	= sleepLinearThreshold * sleepLinearThreshold;
+	float angularSq = sleepAngularThreshold * sleepAngularThreshold;
+
+	for (GameObject* o : activeBodies) {
+		int id = o->GetWorldID();
+		if (id >= (int)islandParent.size()) {
+			islandParent.resize(id + 1);
+			islandTimer.resize(id + 1);
+			islandStamp.resize(id + 1, 0);
+		}
+		islandParent[id]	= id;
+		islandStamp[id]		= islandStampCounter;
 
-		// Orientation Stuff
-		Quaternion orientation = transform.GetOrientation();
-		Vector3 angularVel = object->GetAngularVelocity();
+		PhysicsObject* phys = o->GetPhysicsObject();
+		bool still =	Vector::LengthSquared(phys->GetLinearVelocity()) < linearSq &&
+						Vector::LengthSquared(phys->GetAngularVelocity()) < angularSq;
+		phys->SetSleepTimer(still ? phys->GetSleepTimer() + dt : 0.0f);
+	}
 
-		orientation = orientation + Quaternion(angularVel * dt * 0.5f, 0.0f) * orientation;
-		orientation.Normalise();
+	//Only bodies integrated this step can be in an island - anything woken
+	//part way through the step joins in on the next one
+	auto inIsland = [&](int id) {
+		return id < (int)islandStamp.size() && islandStamp[id] == islandStampCounter;
+	};
+	for (const std::pair<int, int>& c : stepContacts) {
+		if (inIsland(c.first) && inIsland(c.second)) {
+			islandParent[FindIsland(c.first)] = FindIsland(c.second);
+		}
+	}
+	stepContacts.clear();
 
-		transform.SetOrientation(orientation);
+	//Each island can only sleep as soon as its most recently moving body can
+	for (GameObject* o : activeBodies) {
+		islandTimer[FindIsland(o->GetWorldID())] = FLT_MAX;
+	}
+	for (GameObject* o : activeBodies) {
+		float& timer = islandTimer[FindIsland(o->GetWorldID())];
+		timer = std::min(timer, o->GetPhysicsObject()->GetSleepTimer());
+	}
+	bool treeBroadphase = useBroadPhase && !useSimpleContainer;
+	for (GameObject* o : activeBodies) {
+		if (islandTimer[FindIsland(o->GetWorldID())] >= timeToSleep) {
+			o->GetPhysicsObject()->PutToSleep();
+			if (treeBroadphase) {
+				broadphaseSleepers.push_back(o); //It moved this step, but won't be active next step
+			}
+		}
+	}
+}
 
-		//Damp the angular velocity
-		float frameAngularDamping = 1.0f - (0.4f * dt);
-		angularVel = angularVel * frameAngularDamping;
-		object->SetAngularVelocity(angularVel);
+int PhysicsSystem::FindIsland(int worldID) {
+	while (islandParent[worldID] != worldID) {
+		islandParent[worldID] = islandParent[islandParent[worldID]]; //Path halving keeps the trees flat
+		worldID = islandParent[worldID];
 	}
+	return worldID;
 }
 
 /*
-Once we're finished with a physics update, we have to
-clear out any accumulated forces, ready to receive new
-ones in the next 'game' frame.
+A sleeping body's contacts aren't tested, so to stop them from ending while
+it's still sat there, any contact it was already in is kept alive.
 */
-void PhysicsSystem::ClearForces() {
-	gameWorld.OperateOnContents(
-		[](GameObject* o) {
-			o->GetPhysicsObject()->ClearForces();
-		}
-	);
+void PhysicsSystem::KeepRestingContact(GameObject* a, GameObject* b) {
+	bool aAsleep = a->GetPhysicsObject() && a->GetPhysicsObject()->IsAsleep();
+	bool bAsleep = b->GetPhysicsObject() && b->GetPhysicsObject()->IsAsleep();
+	if (!aAsleep && !bAsleep) {
+		return;
+	}
+	if (CollisionPairCache::Entry* e = allCollisions.Find(CollisionPairCache::MakeKey(a, b))) {
+		e->lastFrame = collisionFrame;
+	}
 }
 
+//Only needs to do anything when objects have been added to or removed from the world
+void PhysicsSystem::SyncBodyStore() {
+	if (bodyStoreWorldState == gameWorld.GetWorldStateID()) {
+		return;
+	}
+	std::vector<GameObject*>::const_iterator first;
+	std::vector<GameObject*>::const_iterator last;
+	gameWorld.GetObjectIterators(first, last);
+	bodyStore.Sync(first, last);
+	bodyStoreWorldState = gameWorld.GetWorldStateID();
+}
 
 /*
 
@@ -467,6 +956,7 @@ us to model springs and ropes etc.
 
 */
 void PhysicsSystem::UpdateConstraints(float dt) {
+	PROFILE_SCOPE("Physics::UpdateConstraints");
 	std::vector<Constraint*>::const_iterator first;
 	std::vector<Constraint*>::const_iterator last;
 	gameWorld.GetConstraintIterators(first, last);
@@ -478,27 +968,23 @@ void PhysicsSystem::UpdateConstraints(float dt) {
 
 template <class T>
 bool PhysicsSystem::isCollidingWLayer(T* obj, CollisionLayer layer) {
-	for (const auto& collision : allCollisions) {
-
-
-		if ((collision.a)->getCollisionLayer() == layer && (collision.b) == obj ||
-			(collision.b)->getCollisionLayer() == layer && (collision.a) == obj) {
-			return true;
-		}
-	}
-	return false;
+	return objCollidingWLayer(obj, layer) != nullptr;
 }
 
 template <class T>
 GameObject* PhysicsSystem::objCollidingWLayer(T* obj, CollisionLayer layer) {
-	for (const auto& collision : allCollisions) {
+	GameObject* found = nullptr;
+	allCollisions.ForEach([&](const CollisionPairCache::Entry& e) {
+		const CollisionDetection::CollisionInfo& collision = e.info;
+		if (found) {
+			return;
+		}
 		if ((collision.a)->getCollisionLayer() == layer && (collision.b) == obj) {
-			return collision.a;
+			found = collision.a;
 		}
 		else if ((collision.b)->getCollisionLayer() == layer && (collision.a) == obj) {
-			return collision.b;
+			found = collision.b;
 		}
-	}
-
-	return nullptr;
+	});
+	return found;
 }
@@ -1,8 +1,41 @@
 #pragma once
 #include "GameWorld.h"
+#include "AABBTree.h"
+#include "PooledQuadTree.h"
+#include "CollisionPairCache.h"
+#include "JobSystem.h"
+#include "RigidBodyStore.h"
+#ifdef USE_BATCHED_NARROWPHASE
+#include "BatchCollision.h"
+#endif
 
 namespace NCL {
 	namespace CSC8503 {
+		/*
+		Accumulated wall-clock time (in milliseconds) spent in each stage of
+		the fixed-step loop since the last ResetPhaseTimings call.
+		*/
+		struct PhysicsPhaseTimings {
+			double integrateAccel		= 0.0;
+			double broadPhase			= 0.0;
+			double narrowPhase			= 0.0;
+			double updateConstraints	= 0.0;
+			double integrateVelocity	= 0.0;
+			double updateCollisionList	= 0.0;
+
+			int fixedSteps = 0;
+		};
+
+		/*
+		How many bodies were in each state at the start of the last fixed step.
+		Static bodies (inverse mass 0) are never integrated at all.
+		*/
+		struct PhysicsBodyCounts {
+			int awake	= 0;
+			int asleep	= 0;
+			int statics = 0;
+		};
+
 		class PhysicsSystem	{
 		public:
 			PhysicsSystem(GameWorld& g);
@@ -22,13 +55,129 @@ namespace NCL {
 
 			void SetGravity(const Vector3& g);
 
+			//The broadphase trees aren't kept up to date while they're not in use, so switching back to them resyncs everything
+			void UseBroadPhase(bool state) {
+				useBroadPhase			= state;
+				broadphaseWorldState	= -1;
+			}
+
+			bool IsUsingBroadPhase() const {
+				return useBroadPhase;
+			}
+
+			void UseSimpleContainer(bool state) {
+				useSimpleContainer		= state;
+				broadphaseWorldState	= -1;
+			}
+
+			bool IsUsingSimpleContainer() const {
+				return useSimpleContainer;
+			}
+
+			void SetConstraintIterationCount(int count) {
+				constraintIterationCount = count;
+			}
+
+			int GetConstraintIterationCount() const {
+				return constraintIterationCount;
+			}
+
+			//Narrowphase and integration are spread across this many threads.
+			//With 1 thread, everything runs exactly as it does single threaded.
+			void SetThreadCount(int count);
+
+			int GetThreadCount() const {
+				return jobSystem ? jobSystem->GetThreadCount() : 1;
+			}
+
+			//Moves body state into a structure-of-arrays store for integration,
+			//and only rebuilds transform matrices once per update
+			void UseBodyStore(bool state);
+
+			bool IsUsingBodyStore() const {
+				return useBodyStore;
+			}
+
+			/*
+			With sleeping on, islands of touching bodies that have all stayed
+			below the velocity thresholds for timeToSleep seconds are put to
+			sleep. Sleeping bodies aren't integrated, and pairs with no awake
+			body in them aren't tested, until a contact, force or impulse wakes
+			them again.
+			*/
+			void UseSleeping(bool state);
+
+			bool IsUsingSleeping() const {
+				return useSleeping;
+			}
+
+			void SetSleepThresholds(float linearSpeed, float angularSpeed) {
+				sleepLinearThreshold	= linearSpeed;
+				sleepAngularThreshold	= angularSpeed;
+			}
+
+			void SetTimeToSleep(float seconds) {
+				timeToSleep = seconds;
+			}
+
+			/*
+			Tests sphere and AABB pairs in SIMD batches rather than one at a
+			time. Like the multithreaded narrowphase, every pair is tested
+			before any of them are resolved, so this gives the same results
+			as running with more than 1 thread, rather than the serial path.
+
+			Copying each pair out of its GameObjects and into a batch costs
+			more than the SIMD tests save, so it's slower overall than testing
+			pairs one at a time. It's only built in with the
+			USE_BATCHED_NARROWPHASE CMake option, and does nothing without it.
+			*/
+			void UseBatchedNarrowPhase(bool state) {
+#ifdef USE_BATCHED_NARROWPHASE
+				useBatchedNarrowPhase = state;
+#else
+				(void)state;
+#endif
+			}
+
+			bool IsUsingBatchedNarrowPhase() const {
+				return useBatchedNarrowPhase;
+			}
+
+			const PhysicsBodyCounts& GetBodyCounts() const {
+				return bodyCounts;
+			}
+
+			//When disabled, the step rate stays at the ideal rate regardless of
+			//how long an update takes, so results are repeatable between runs
+			void UseAdaptiveTimestep(bool state);
+
+			const PhysicsPhaseTimings& GetPhaseTimings() const {
+				return phaseTimings;
+			}
+
+			void ResetPhaseTimings() {
+				phaseTimings = PhysicsPhaseTimings();
+			}
 
 		protected:
 			void BasicCollisionDetection();
 			void BroadPhase();
+			void QuadTreeBroadPhase();
 			void NarrowPhase();
 
+			void SyncBroadphaseProxies();
+			void AddBroadphaseProxy(GameObject* object);
+			void RemoveBroadphaseProxy(int worldID);
+			void SyncBroadphaseProxy(GameObject* object);
+			void ClearBroadphase();
+
 			void ClearForces();
+			void SyncBodyStore();
+
+			void UpdateActiveBodies();
+			void KeepRestingContact(GameObject* a, GameObject* b);
+			void UpdateSleeping(float dt);
+			int	 FindIsland(int worldID);
 
 			void IntegrateAccel(float dt);
 			void IntegrateVelocity(float dt);
@@ -37,6 +186,7 @@ namespace NCL {
 
 
 			void UpdateCollisionList();
+			void AddCollision(const CollisionDetection::CollisionInfo& info);
 			void UpdateObjectAABBs();
 
 			void ImpulseResolveCollision(GameObject& a , GameObject&b, CollisionDetection::ContactPoint& p) const;
@@ -59,12 +209,77 @@ namespace NCL {
 			float	dTOffset;
 			float	globalDamping;
 
-			std::set<CollisionDetection::CollisionInfo> allCollisions;
-			std::set<CollisionDetection::CollisionInfo> broadphaseCollisions;
+			CollisionPairCache allCollisions;
+			CollisionPairCache broadphasePairs; //Only used to remove duplicate QuadTree pairs
 			std::vector<CollisionDetection::CollisionInfo> broadphaseCollisionsVec;
+			std::vector<uint64_t> endedCollisions;
+			int collisionFrame		= 0;
 			bool useBroadPhase		= true;
+			bool useSimpleContainer	= false;
+			bool adaptiveTimestep	= true;
+			int constraintIterationCount = 10;
 			int notGroundedFrameCount = 0;
 			int numCollisionFrames	= 5;
+
+			PhysicsPhaseTimings phaseTimings;
+
+			bool			useBodyStore		= false;
+			RigidBodyStore	bodyStore;
+			int				bodyStoreWorldState = -1;
+
+			/*
+			Resting contacts are resolved with restitution, so a body sat on the
+			floor never fully stops - it keeps bouncing by a few steps' worth of
+			gravity (around 0.3 at 120Hz). The thresholds have to sit above that,
+			or nothing resting ever gets to sleep.
+			*/
+			bool	useSleeping				= false;
+			float	sleepLinearThreshold	= 0.5f;
+			float	sleepAngularThreshold	= 0.5f;
+			float	timeToSleep				= 0.5f;
+
+			PhysicsBodyCounts			bodyCounts;
+			std::vector<GameObject*>	activeBodies;	//Awake, non-static bodies this step
+			std::vector<std::pair<int, int>> stepContacts;	//World IDs of every pair that touched this step
+
+			//Union-find over world IDs, used to group touching bodies into islands
+			std::vector<int>	islandParent;
+			std::vector<float>	islandTimer;
+			std::vector<int>	islandStamp;
+			int					islandStampCounter = 0;
+
+			JobSystem* jobSystem = nullptr;
+
+			//Each narrowphase batch's working memory, kept between steps to reuse it
+			struct NarrowphaseBatch {
+				std::vector<CollisionDetection::CollisionInfo> contacts;
+#ifdef USE_BATCHED_NARROWPHASE
+				ObjectPairBatch		simdPairs;
+				std::vector<int>	simdIndices; //Index into simdPairs, or -1 for the per-pair test
+#endif
+			};
+			std::vector<NarrowphaseBatch> narrowphaseBatches;
+			bool useBatchedNarrowPhase = false;
+
+			/*
+			The persistent broadphase keeps static (inverse mass 0) and dynamic
+			bodies in separate trees, so static vs static pairs are never
+			generated. Proxies are indexed by world ID.
+			*/
+			struct BroadphaseProxy {
+				GameObject* object		= nullptr;
+				int			proxy		= -1;
+				bool		isStatic	= false;
+				int			syncStamp	= 0;
+			};
+			AABBTree<GameObject*>			staticTree;
+			AABBTree<GameObject*>			dynamicTree;
+			std::vector<BroadphaseProxy>	broadphaseProxies;
+			std::vector<GameObject*>		broadphaseSleepers;	//Put to sleep last step, so need one last check
+			int								broadphaseWorldState = -1;
+			int								broadphaseSyncStamp = 0;
+
+			PooledQuadTree<GameObject*>		quadTree;
 		};
 	}
 }
@@ -0,0 +1,316 @@
+#pragma once
+#include "QuadTree.h"
+#include "Ray.h"
+
+namespace NCL {
+	using namespace NCL::Maths;
+	namespace CSC8503 {
+		template<class T>
+		struct QuadTreeEntryRange {
+			QuadTreeEntry<T>* first;
+			QuadTreeEntry<T>* last;
+
+			QuadTreeEntry<T>* begin() const { return first; }
+			QuadTreeEntry<T>* end()	const { return last; }
+			size_t size() const { return last - first; }
+		};
+
+		/*
+		A QuadTree with the same Insert / OperateOnContents interface as the
+		original, but laid out for speed rather than simplicity:
+
+		- Nodes live in one array, and a split node's 4 children are
+		  stored next to each other, referenced by the index of the first.
+		- Every inserted object is stored once. Leaves refer to it by index,
+		  and before the tree is read, the leaf references are packed into
+		  one array so each leaf's contents are a contiguous range.
+		- Reset() empties the tree but keeps all of its memory, so a tree
+		  can be refilled every frame without touching the heap.
+		*/
+		template<class T>
+		class PooledQuadTree {
+		public:
+			typedef std::function<void(QuadTreeEntryRange<T>&)>	QuadTreeFunc;
+			typedef std::function<void(T&)>						QueryFunc;
+			typedef std::function<void(T&, float)>				RayQueryFunc;
+
+			PooledQuadTree(Vector2 size, int maxDepth = 6, int maxSize = 5) {
+				this->size		= size;
+				this->maxDepth	= maxDepth;
+				this->maxSize	= maxSize;
+				queryCounter	= 0;
+				Reset();
+			}
+			~PooledQuadTree() {
+			}
+
+			void Reset() {
+				nodes.clear();
+				objects.clear();
+				refs.clear();
+				packedEntries.clear();
+				packedObjects.clear();
+
+				nodes.emplace_back(Vector2(), size, maxDepth);
+				packed = true;
+			}
+
+			void Insert(T object, const Vector3& pos, const Vector3& size) {
+				int objectIndex = (int)objects.size();
+				objects.emplace_back(object, pos, size);
+				queryStamps.resize(objects.size(), 0);
+				InsertIntoNode(0, objectIndex);
+				packed = false;
+			}
+
+			void OperateOnContents(QuadTreeFunc func) {
+				Pack();
+				for (const Node& n : nodes) {
+					if (n.firstChild < 0 && n.count > 0) {
+						QuadTreeEntryRange<T> range{ &packedEntries[n.start], &packedEntries[n.start] + n.count };
+						func(range);
+					}
+				}
+			}
+
+			//Calls func once for every object whose box overlaps the given box
+			void QueryAABB(const Vector3& pos, const Vector3& halfSize, QueryFunc func) {
+				Pack();
+				NewQuery();
+				VisitNodes(
+					[&](const Node& n) {
+						return NodeOverlaps(n, pos, halfSize);
+					},
+					[&](int objectIndex) {
+						QuadTreeEntry<T>& e = objects[objectIndex];
+						if (CollisionDetection::AABBTest(pos, e.pos, halfSize, e.size)) {
+							func(e.object);
+						}
+					}
+				);
+			}
+
+			//Calls func once for every object whose box lies (at least partly) within the sphere
+			void QueryRadius(const Vector3& centre, float radius, QueryFunc func) {
+				Pack();
+				NewQuery();
+				float radiusSq = radius * radius;
+				VisitNodes(
+					[&](const Node& n) {
+						return NodeOverlaps(n, centre, Vector3(radius, radius, radius));
+					},
+					[&](int objectIndex) {
+						QuadTreeEntry<T>& e = objects[objectIndex];
+						Vector3 closest = Vector::Clamp(centre, e.pos - e.size, e.pos + e.size);
+						if (Vector::LengthSquared(closest - centre) <= radiusSq) {
+							func(e.object);
+						}
+					}
+				);
+			}
+
+			//Calls func with the entry distance of every object box the ray hits within maxDistance
+			void QueryRay(const Ray& r, float maxDistance, RayQueryFunc func) {
+				Pack();
+				NewQuery();
+				Vector3 rayPos = r.GetPosition();
+				Vector3 rayDir = r.GetDirection();
+				Vector3 invDir(
+					rayDir.x != 0.0f ? 1.0f / rayDir.x : FLT_MAX,
+					rayDir.y != 0.0f ? 1.0f / rayDir.y : FLT_MAX,
+					rayDir.z != 0.0f ? 1.0f / rayDir.z : FLT_MAX
+				);
+				float t = 0.0f;
+				VisitNodes(
+					[&](const Node& n) {
+						Vector3 nodePos(n.position.x, 0.0f, n.position.y);
+						Vector3 nodeSize(n.size.x, 1000.0f, n.size.y);
+						return RaySlabTest(rayPos, invDir, nodePos - nodeSize, nodePos + nodeSize, maxDistance, t);
+					},
+					[&](int objectIndex) {
+						QuadTreeEntry<T>& e = objects[objectIndex];
+						if (RaySlabTest(rayPos, invDir, e.pos - e.size, e.pos + e.size, maxDistance, t)) {
+							func(e.object, t);
+						}
+					}
+				);
+			}
+
+			size_t GetNodeCount() const {
+				return nodes.size();
+			}
+
+			size_t GetObjectCount() const {
+				return objects.size();
+			}
+
+		protected:
+			struct Node {
+				Vector2 position;
+				Vector2 size;
+				int		depthLeft;
+				int		firstChild	= -1; //The 4 children are stored consecutively
+				int		head		= -1; //Linked list of refs, used while inserting
+				int		start		= 0;  //Packed range, valid after Pack()
+				int		count		= 0;
+
+				Node(Vector2 pos, Vector2 size, int depthLeft) {
+					this->position	= pos;
+					this->size		= size;
+					this->depthLeft = depthLeft;
+				}
+			};
+
+			struct Ref {
+				int object;
+				int next;
+			};
+
+			bool NodeOverlaps(const Node& n, const Vector3& pos, const Vector3& halfSize) const {
+				return CollisionDetection::AABBTest(pos, Vector3(n.position.x, 0, n.position.y), halfSize, Vector3(n.size.x, 1000.0f, n.size.y));
+			}
+
+			void InsertIntoNode(int nodeIndex, int objectIndex) {
+				const QuadTreeEntry<T>& e = objects[objectIndex];
+				if (!NodeOverlaps(nodes[nodeIndex], e.pos, e.size)) {
+					return;
+				}
+				if (nodes[nodeIndex].firstChild >= 0) {
+					int firstChild = nodes[nodeIndex].firstChild;
+					for (int i = 0; i < 4; ++i) {
+						InsertIntoNode(firstChild + i, objectIndex);
+					}
+					return;
+				}
+				refs.push_back({ objectIndex, nodes[nodeIndex].head });
+				nodes[nodeIndex].head = (int)refs.size() - 1;
+				nodes[nodeIndex].count++;
+
+				if (nodes[nodeIndex].count > maxSize && nodes[nodeIndex].depthLeft > 0) {
+					Split(nodeIndex);
+				}
+			}
+
+			void Split(int nodeIndex) {
+				Vector2 halfSize	= nodes[nodeIndex].size / 2.0f;
+				Vector2 position	= nodes[nodeIndex].position;
+				int depthLeft		= nodes[nodeIndex].depthLeft - 1;
+				int firstChild		= (int)nodes.size();
+
+				//Careful - emplacing can move the node array, so no references are held here
+				nodes.emplace_back(position + Vector2(-halfSize.x, halfSize.y), halfSize, depthLeft);
+				nodes.emplace_back(position + Vector2(halfSize.x, halfSize.y), halfSize, depthLeft);
+				nodes.emplace_back(position + Vector2(-halfSize.x, -halfSize.y), halfSize, depthLeft);
+				nodes.emplace_back(position + Vector2(halfSize.x, -halfSize.y), halfSize, depthLeft);
+
+				int head = nodes[nodeIndex].head;
+				nodes[nodeIndex].firstChild = firstChild;
+				nodes[nodeIndex].head		= -1;
+				nodes[nodeIndex].count		= 0;
+
+				//Distribute contents amongst the new children. Old refs are simply
+				//abandoned, they'll be reclaimed on the next Reset
+				for (int r = head; r >= 0; r = refs[r].next) {
+					for (int i = 0; i < 4; ++i) {
+						InsertIntoNode(firstChild + i, refs[r].object);
+					}
+				}
+			}
+
+			//Flattens every leaf's linked list into one contiguous range
+			void Pack() {
+				if (packed) {
+					return;
+				}
+				packedEntries.clear();
+				packedObjects.clear();
+				for (Node& n : nodes) {
+					n.start = (int)packedObjects.size();
+					if (n.firstChild >= 0) {
+						n.count = 0;
+						continue;
+					}
+					for (int r = n.head; r >= 0; r = refs[r].next) {
+						packedObjects.push_back(refs[r].object);
+						packedEntries.push_back(objects[refs[r].object]);
+					}
+				}
+				packed = true;
+			}
+
+			void NewQuery() {
+				queryCounter++;
+				if (queryCounter == 0) { //Wrapped around, so old stamps could look current
+					std::fill(queryStamps.begin(), queryStamps.end(), 0);
+					queryCounter = 1;
+				}
+			}
+
+			//Walks all nodes that pass nodeTest, handing each object to objectFunc
+			//once per query, even if it was stored in several leaves
+			template<typename NodeTest, typename ObjectFunc>
+			void VisitNodes(NodeTest&& nodeTest, ObjectFunc&& objectFunc) {
+				nodeStack.clear();
+				nodeStack.push_back(0);
+				while (!nodeStack.empty()) {
+					int index = nodeStack.back();
+					nodeStack.pop_back();
+
+					const Node& n = nodes[index];
+					if (!nodeTest(n)) {
+						continue;
+					}
+					if (n.firstChild >= 0) {
+						for (int i = 0; i < 4; ++i) {
+							nodeStack.push_back(n.firstChild + i);
+						}
+						continue;
+					}
+					for (int i = n.start; i < n.start + n.count; ++i) {
+						int objectIndex = packedObjects[i];
+						if (queryStamps[objectIndex] == queryCounter) {
+							continue;
+						}
+						queryStamps[objectIndex] = queryCounter;
+						objectFunc(objectIndex);
+					}
+				}
+			}
+
+			static bool RaySlabTest(const Vector3& rayPos, const Vector3& invDir, const Vector3& boxMin, const Vector3& boxMax, float maxDistance, float& tEntry) {
+				float tMin = 0.0f;
+				float tMax = maxDistance;
+				for (int i = 0; i < 3; ++i) {
+					float t0 = (boxMin[i] - rayPos[i]) * invDir[i];
+					float t1 = (boxMax[i] - rayPos[i]) * invDir[i];
+					if (t0 > t1) {
+						std::swap(t0, t1);
+					}
+					tMin = std::max(tMin, t0);
+					tMax = std::min(tMax, t1);
+					if (tMin > tMax) {
+						return false;
+					}
+				}
+				tEntry = tMin;
+				return true;
+			}
+
+			std::vector<Node>				nodes;
+			std::vector<QuadTreeEntry<T>>	objects;
+			std::vector<Ref>				refs;
+
+			std::vector<QuadTreeEntry<T>>	packedEntries;
+			std::vector<int>				packedObjects;
+			bool							packed;
+
+			std::vector<uint32_t>			queryStamps;
+			uint32_t						queryCounter;
+			std::vector<int>				nodeStack;
+
+			Vector2 size;
+			int		maxDepth;
+			int		maxSize;
+		};
+	}
+}
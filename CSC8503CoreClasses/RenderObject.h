@@ -69,14 +69,7 @@ namespace NCL {
 			}
 
 			float GetMaxHeight() const {
-				float maxHeight = std::numeric_limits<float>::lowest();
-				const auto& positions = mesh->GetPositionData();
-				for (const auto& pos : positions) {
-					if (pos.y > maxHeight) {
-						maxHeight = pos.y;
-					}
-				}
-				return maxHeight;
+				return mesh->GetBoundsMax().y;
 			}
 
 			void SetBendAmount(float* bendAmount) {
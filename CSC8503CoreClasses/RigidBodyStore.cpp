@@ -0,0 +1,234 @@
+#include "RigidBodyStore.h"
+#include "GameObject.h"
+#include "PhysicsObject.h"
+#include "Transform.h"
+
+using namespace NCL;
+using namespace CSC8503;
+
+RigidBodyStore::RigidBodyStore() {
+	syncStamp = 0;
+}
+
+RigidBodyStore::~RigidBodyStore() {
+	Clear();
+}
+
+void RigidBodyStore::Sync(std::vector<GameObject*>::const_iterator first, std::vector<GameObject*>::const_iterator last) {
+	syncStamp++;
+	for (auto i = first; i != last; ++i) {
+		PhysicsObject* phys = (*i)->GetPhysicsObject();
+		if (!phys) {
+			continue;
+		}
+		if (phys->store != this) {
+			Add(*i);
+		}
+		syncStamps[phys->storeIndex] = syncStamp;
+	}
+	//Backwards, so that the swapped in bodies have already been checked
+	for (int i = Size() - 1; i >= 0; --i) {
+		if (syncStamps[i] != syncStamp) {
+			Remove(i);
+		}
+	}
+}
+
+int RigidBodyStore::Add(GameObject* object) {
+	PhysicsObject* phys = object->GetPhysicsObject();
+	int index = Size();
+	Resize(index + 1);
+
+	objects[index]		= object;
+	syncStamps[index]	= syncStamp;
+
+	SetLinearVelocity(index, phys->linearVelocity);
+	SetAngularVelocity(index, phys->angularVelocity);
+	SetForce(index, phys->force);
+	SetTorque(index, phys->torque);
+	SetInverseMass(index, phys->inverseMass);
+
+	phys->store		 = this;
+	phys->storeIndex = index;
+	return index;
+}
+
+/*
+Bodies are removed by moving the last body into the gap, so the arrays
+stay tightly packed. The moved body's PhysicsObject gets told its new index.
+*/
+void RigidBodyStore::Remove(int index) {
+	Detach(index);
+
+	int lastIndex = Size() - 1;
+	if (index != lastIndex) {
+		objects[index]		= objects[lastIndex];
+		syncStamps[index]	= syncStamps[lastIndex];
+
+		SetLinearVelocity(index, GetLinearVelocity(lastIndex));
+		SetAngularVelocity(index, GetAngularVelocity(lastIndex));
+		SetForce(index, GetForce(lastIndex));
+		SetTorque(index, GetTorque(lastIndex));
+		SetInverseMass(index, GetInverseMass(lastIndex));
+
+		objects[index]->GetPhysicsObject()->storeIndex = index;
+	}
+	Resize(lastIndex);
+}
+
+void RigidBodyStore::Clear() {
+	for (int i = 0; i < Size(); ++i) {
+		Detach(i);
+	}
+	Resize(0);
+}
+
+//Copies a body's state back into its PhysicsObject, which goes back to using its own members
+void RigidBodyStore::Detach(int index) {
+	PhysicsObject* phys = objects[index]->GetPhysicsObject();
+	if (!phys || phys->store != this) {
+		return;
+	}
+	phys->linearVelocity	= GetLinearVelocity(index);
+	phys->angularVelocity	= GetAngularVelocity(index);
+	phys->force				= GetForce(index);
+	phys->torque			= GetTorque(index);
+	phys->inverseMass		= GetInverseMass(index);
+
+	phys->store		 = nullptr;
+	phys->storeIndex = -1;
+}
+
+void RigidBodyStore::Resize(size_t size) {
+	objects.resize(size);
+	syncStamps.resize(size);
+	gravityMask.resize(size);
+	activeMask.resize(size);
+
+	for (std::vector<float>* v : {	&posX, &posY, &posZ, &rotX, &rotY, &rotZ, &rotW,
+									&linVelX, &linVelY, &linVelZ, &angVelX, &angVelY, &angVelZ,
+									&forceX, &forceY, &forceZ, &torqueX, &torqueY, &torqueZ,
+									&inverseMass }) {
+		v->resize(size);
+	}
+}
+
+/*
+The same sums as PhysicsSystem::IntegrateAccel, but with the linear part
+done a component at a time across the whole range. The angular part needs
+each body's inertia tensor, which depends on its orientation, so that
+still goes through the PhysicsObject, and works out who gets gravity
+while it's there.
+
+Static and sleeping bodies are marked inactive here, and are left
+untouched by both kernels for the rest of the step.
+*/
+void RigidBodyStore::IntegrateAccel(int begin, int end, float dt, const Vector3& gravity, bool applyGravity) {
+	for (int i = begin; i < end; ++i) {
+		PhysicsObject* phys = objects[i]->GetPhysicsObject();
+		activeMask[i] = inverseMass[i] > 0 && !phys->IsAsleep();
+		if (!activeMask[i]) {
+			continue;
+		}
+		gravityMask[i] = applyGravity && objects[i]->getCollisionLayer() != CollisionLayer::Camera;
+
+		phys->UpdateInertiaTensor(); // update tensor vs orientation
+		Vector3 angularAccel = phys->GetInertiaTensor() * GetTorque(i);
+		SetAngularVelocity(i, GetAngularVelocity(i) + angularAccel * dt);
+	}
+
+	float* vx = linVelX.data();
+	float* vy = linVelY.data();
+	float* vz = linVelZ.data();
+	const float* fx = forceX.data();
+	const float* fy = forceY.data();
+	const float* fz = forceZ.data();
+	const float* im = inverseMass.data();
+	const uint8_t* g = gravityMask.data();
+	const uint8_t* a = activeMask.data();
+
+	for (int i = begin; i < end; ++i) {
+		float ax = fx[i] * im[i];
+		float ay = fy[i] * im[i];
+		float az = fz[i] * im[i];
+		ax = g[i] ? ax + gravity.x : ax;
+		ay = g[i] ? ay + gravity.y : ay;
+		az = g[i] ? az + gravity.z : az;
+		vx[i] = a[i] ? vx[i] + ax * dt : vx[i];
+		vy[i] = a[i] ? vy[i] + ay * dt : vy[i];
+		vz[i] = a[i] ? vz[i] + az * dt : vz[i];
+	}
+}
+
+void RigidBodyStore::IntegrateVelocity(int begin, int end, float dt) {
+	const uint8_t* a = activeMask.data();
+	for (int i = begin; i < end; ++i) {
+		if (!a[i]) {
+			continue;
+		}
+		Transform& t = objects[i]->GetTransform();
+		Vector3		p = t.GetPosition();
+		Quaternion	q = t.GetOrientation();
+		posX[i] = p.x; posY[i] = p.y; posZ[i] = p.z;
+		rotX[i] = q.x; rotY[i] = q.y; rotZ[i] = q.z; rotW[i] = q.w;
+	}
+
+	float damping = 1.0f - (0.4f * dt);
+
+	float* px = posX.data();
+	float* py = posY.data();
+	float* pz = posZ.data();
+	float* vx = linVelX.data();
+	float* vy = linVelY.data();
+	float* vz = linVelZ.data();
+	for (int i = begin; i < end; ++i) {
+		px[i] += vx[i] * dt;
+		py[i] += vy[i] * dt;
+		pz[i] += vz[i] * dt;
+		vx[i] = a[i] ? vx[i] * damping : vx[i];
+		vy[i] = a[i] ? vy[i] * damping : vy[i];
+		vz[i] = a[i] ? vz[i] * damping : vz[i];
+	}
+
+	for (int i = begin; i < end; ++i) {
+		if (!a[i]) {
+			continue;
+		}
+		Quaternion orientation(rotX[i], rotY[i], rotZ[i], rotW[i]);
+		Vector3 angularVel = GetAngularVelocity(i);
+
+		orientation = orientation + Quaternion(angularVel * dt * 0.5f, 0.0f) * orientation;
+		orientation.Normalise();
+
+		rotX[i] = orientation.x; rotY[i] = orientation.y; rotZ[i] = orientation.z; rotW[i] = orientation.w;
+		SetAngularVelocity(i, angularVel * damping);
+	}
+
+	for (int i = begin; i < end; ++i) {
+		if (!a[i]) {
+			continue;
+		}
+		objects[i]->GetTransform().SetWorldState(
+			Vector3(posX[i], posY[i], posZ[i]),
+			Quaternion(rotX[i], rotY[i], rotZ[i], rotW[i])
+		);
+	}
+}
+
+void RigidBodyStore::ClearForces(int begin, int end) {
+	std::fill(forceX.begin() + begin, forceX.begin() + end, 0.0f);
+	std::fill(forceY.begin() + begin, forceY.begin() + end, 0.0f);
+	std::fill(forceZ.begin() + begin, forceZ.begin() + end, 0.0f);
+	std::fill(torqueX.begin() + begin, torqueX.begin() + end, 0.0f);
+	std::fill(torqueY.begin() + begin, torqueY.begin() + end, 0.0f);
+	std::fill(torqueZ.begin() + begin, torqueZ.begin() + end, 0.0f);
+}
+
+void RigidBodyStore::RefreshMatrices(int begin, int end) {
+	for (int i = begin; i < end; ++i) {
+		if (!activeMask[i]) {
+			continue; //Hasn't been moved by the integrator
+		}
+		objects[i]->GetTransform().UpdateMatrix();
+	}
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+namespace NCL {
+	using namespace NCL::Maths;
+	namespace CSC8503 {
+		class GameObject;
+		class PhysicsObject;
+		class Transform;
+
+		/*
+		A structure-of-arrays home for rigid body state.
+
+		Once a PhysicsObject has been added, its velocities, forces and inverse
+		mass live here rather than in the object itself, with each component
+		in its own contiguous array, so the integrators can stream through
+		them rather than hopping between heap allocated objects.
+
+		Positions and orientations still belong to each object's Transform, as
+		collision detection and the game read them from there. They are copied
+		in before integrating velocity, and written back afterwards without
+		rebuilding the transform's matrix - RefreshMatrices does that once the
+		whole physics update is done.
+		*/
+		class RigidBodyStore {
+		public:
+			RigidBodyStore();
+			~RigidBodyStore();
+
+			//Adds every physics object in the range that isn't stored yet, and
+			//removes any stored object that is no longer in the range
+			void Sync(std::vector<GameObject*>::const_iterator first, std::vector<GameObject*>::const_iterator last);
+
+			int		Add(GameObject* object);
+			void	Remove(int index);
+
+			//Hands every body's state back to its PhysicsObject
+			void	Clear();
+
+			int Size() const {
+				return (int)objects.size();
+			}
+
+			/*
+			The kernels all work on the body range [begin, end), so they can be
+			split into batches and run across several threads.
+			*/
+			void IntegrateAccel(int begin, int end, float dt, const Vector3& gravity, bool applyGravity);
+			void IntegrateVelocity(int begin, int end, float dt);
+			void ClearForces(int begin, int end);
+			void RefreshMatrices(int begin, int end);
+
+			Vector3 GetLinearVelocity(int i) const {
+				return Vector3(linVelX[i], linVelY[i], linVelZ[i]);
+			}
+			void SetLinearVelocity(int i, const Vector3& v) {
+				linVelX[i] = v.x; linVelY[i] = v.y; linVelZ[i] = v.z;
+			}
+
+			Vector3 GetAngularVelocity(int i) const {
+				return Vector3(angVelX[i], angVelY[i], angVelZ[i]);
+			}
+			void SetAngularVelocity(int i, const Vector3& v) {
+				angVelX[i] = v.x; angVelY[i] = v.y; angVelZ[i] = v.z;
+			}
+
+			Vector3 GetForce(int i) const {
+				return Vector3(forceX[i], forceY[i], forceZ[i]);
+			}
+			void SetForce(int i, const Vector3& f) {
+				forceX[i] = f.x; forceY[i] = f.y; forceZ[i] = f.z;
+			}
+
+			Vector3 GetTorque(int i) const {
+				return Vector3(torqueX[i], torqueY[i], torqueZ[i]);
+			}
+			void SetTorque(int i, const Vector3& t) {
+				torqueX[i] = t.x; torqueY[i] = t.y; torqueZ[i] = t.z;
+			}
+
+			float GetInverseMass(int i) const {
+				return inverseMass[i];
+			}
+			void SetInverseMass(int i, float m) {
+				inverseMass[i] = m;
+			}
+
+		protected:
+			void Resize(size_t size);
+			void Detach(int index);
+
+			std::vector<GameObject*>	objects;
+			std::vector<int>			syncStamps;
+			int							syncStamp;
+
+			std::vector<float> posX, posY, posZ;
+			std::vector<float> rotX, rotY, rotZ, rotW;
+
+			std::vector<float> linVelX, linVelY, linVelZ;
+			std::vector<float> angVelX, angVelY, angVelZ;
+			std::vector<float> forceX,	forceY,	forceZ;
+			std::vector<float> torqueX, torqueY, torqueZ;
+
+			std::vector<float> inverseMass;
+			std::vector<uint8_t> gravityMask;
+			std::vector<uint8_t> activeMask;
+		};
+	}
+}
@@ -15,6 +15,7 @@ void Transform::UpdateMatrix() {
 		Matrix::Translation(position) *
 		Quaternion::RotationMatrix<Matrix4>(orientation) *
 		Matrix::Scale(scale);
+	version++;
 }
 
 Transform& Transform::SetPosition(const Vector3& worldPos) {
@@ -18,6 +18,14 @@ namespace NCL {
 			Transform& SetScale(const Vector3& worldScale);
 			Transform& SetOrientation(const Quaternion& newOr);
 
+			//Sets position and orientation without rebuilding the matrix, for
+			//when many updates happen in a row - call UpdateMatrix once done
+			void SetWorldState(const Vector3& worldPos, const Quaternion& newOr) {
+				position	= worldPos;
+				orientation = newOr;
+				version++;
+			}
+
 			Vector3 GetPosition() const {
 				return position;
 			}
@@ -34,12 +42,20 @@ namespace NCL {
 				return matrix;
 			}
 			void UpdateMatrix();
+
+			//Goes up every time the transform changes, so anything caching
+			//something built from it can tell whether it needs rebuilding
+			unsigned int GetVersion() const {
+				return version;
+			}
 		protected:
 			Matrix4		matrix;
 			Quaternion	orientation;
 			Vector3		position;
 
 			Vector3		scale;
+
+			unsigned int version = 0;
 		};
 	}
 }
@@ -26,6 +26,11 @@ namespace NCL::Maths {
 			}
 			return true;
 		}
+
+		//Left, right, top, bottom, near, far - each with its normal facing into the frustum
+		const Plane& GetPlane(int p) const {
+			return planes[p];
+		}
 	protected:
 		Plane planes[6];
 	};
@@ -0,0 +1,89 @@
+#include "MappedFile.h"
+#include <iostream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace NCL;
+
+#ifdef _WIN32
+bool MappedFile::Open(const std::string& filename) {
+	Close();
+	HANDLE f = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (f == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(f, &fileSize) || fileSize.QuadPart == 0) {
+		CloseHandle(f);
+		return false;
+	}
+	HANDLE m = CreateFileMappingA(f, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!m) {
+		CloseHandle(f);
+		return false;
+	}
+	void* view = MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0);
+	if (!view) {
+		CloseHandle(m);
+		CloseHandle(f);
+		return false;
+	}
+	file	= f;
+	mapping = m;
+	data	= (const char*)view;
+	size	= (size_t)fileSize.QuadPart;
+	return true;
+}
+
+void MappedFile::Close() {
+	if (data) {
+		UnmapViewOfFile(data);
+	}
+	if (mapping) {
+		CloseHandle(mapping);
+	}
+	if (file) {
+		CloseHandle(file);
+	}
+	data	= nullptr;
+	size	= 0;
+	mapping = nullptr;
+	file	= nullptr;
+}
+#else
+bool MappedFile::Open(const std::string& filename) {
+	Close();
+	int f = open(filename.c_str(), O_RDONLY);
+	if (f < 0) {
+		return false;
+	}
+	struct stat info;
+	if (fstat(f, &info) != 0 || info.st_size == 0) {
+		close(f);
+		return false;
+	}
+	void* view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, f, 0);
+	close(f);	//The mapping keeps the file open by itself
+	if (view == MAP_FAILED) {
+		return false;
+	}
+	data = (const char*)view;
+	size = (size_t)info.st_size;
+	return true;
+}
+
+void MappedFile::Close() {
+	if (data) {
+		munmap((void*)data, size);
+	}
+	data = nullptr;
+	size = 0;
+}
+#endif
@@ -0,0 +1,52 @@
+#pragma once
+#include <string>
+#include <cstddef>
+
+namespace NCL {
+	/*
+	A file mapped read only into memory, so its contents can be read
+	straight from the pages the OS loads it into, rather than being read
+	into a buffer first. Only pages that actually get touched are loaded.
+
+	The data is only valid until the file is closed, so anything that
+	needs to outlive it has to be copied out.
+	*/
+	class MappedFile {
+	public:
+		MappedFile() {}
+		MappedFile(const std::string& filename) {
+			Open(filename);
+		}
+		~MappedFile() {
+			Close();
+		}
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		//Fails on empty files too, as there's nothing to map
+		bool Open(const std::string& filename);
+		void Close();
+
+		bool IsOpen() const {
+			return data != nullptr;
+		}
+
+		//Page aligned, when open
+		const char* GetData() const {
+			return data;
+		}
+
+		size_t GetSize() const {
+			return size;
+		}
+
+	protected:
+		const char*	data	= nullptr;
+		size_t		size	= 0;
+#ifdef _WIN32
+		void*		file	= nullptr;
+		void*		mapping	= nullptr;
+#endif
+	};
+}
@@ -83,7 +83,18 @@ int Mesh::GetIndexForJoint(const std::string& name) const {
 }
 
 void Mesh::SetVertexPositions(const std::vector<Vector3>& newVerts) {
-	positions = newVerts;
+	SetVertexPositions(std::span<const Vector3>(newVerts));
+}
+
+void Mesh::SetVertexPositions(std::span<const Vector3> newVerts) {
+	positions.assign(newVerts.begin(), newVerts.end());
+
+	boundsMin = positions.empty() ? Vector3() : positions[0];
+	boundsMax = boundsMin;
+	for (const Vector3& p : positions) {
+		boundsMin = Vector::Min(boundsMin, p);
+		boundsMax = Vector::Max(boundsMax, p);
+	}
 }
 
 void Mesh::SetVertexTextureCoords(const std::vector<Vector2>& newTex) {
@@ -114,6 +125,34 @@ void Mesh::SetVertexSkinIndices(const std::vector<Vector4i>& newSkinIndices) {
 	skinIndices = newSkinIndices;
 }
 
+void Mesh::SetVertexTextureCoords(std::span<const Vector2> newTex) {
+	texCoords.assign(newTex.begin(), newTex.end());
+}
+
+void Mesh::SetVertexColours(std::span<const Vector4> newColours) {
+	colours.assign(newColours.begin(), newColours.end());
+}
+
+void Mesh::SetVertexNormals(std::span<const Vector3> newNorms) {
+	normals.assign(newNorms.begin(), newNorms.end());
+}
+
+void Mesh::SetVertexTangents(std::span<const Vector4> newTans) {
+	tangents.assign(newTans.begin(), newTans.end());
+}
+
+void Mesh::SetVertexIndices(std::span<const unsigned int> newIndices) {
+	indices.assign(newIndices.begin(), newIndices.end());
+}
+
+void Mesh::SetVertexSkinWeights(std::span<const Vector4> newSkinWeights) {
+	skinWeights.assign(newSkinWeights.begin(), newSkinWeights.end());
+}
+
+void Mesh::SetVertexSkinIndices(std::span<const Vector4i> newSkinIndices) {
+	skinIndices.assign(newSkinIndices.begin(), newSkinIndices.end());
+}
+
 void Mesh::SetDebugName(const std::string& newName) {
 	debugName = newName;
 }
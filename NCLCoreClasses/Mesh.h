@@ -8,6 +8,7 @@ https://research.ncl.ac.uk/game/
 */
 #pragma once
 #include <cstdint>
+#include <span>
 #include "Vector.h"
 #include "Matrix.h"
 
@@ -150,6 +151,16 @@ namespace NCL::Rendering {
 		void SetSubMeshes(const std::vector < SubMesh>& meshes);
 		void SetSubMeshNames(const std::vector < std::string>& newnames);
 
+		const std::vector<SubMesh>& GetSubMeshes() const {
+			return subMeshes;
+		}
+		const std::vector<std::string>& GetSubMeshNames() const {
+			return subMeshNames;
+		}
+		const std::vector<std::string>& GetJointNames() const {
+			return jointNames;
+		}
+
 
 		void SetJointNames(const std::vector < std::string > & newnames);
 		void SetJointParents(const std::vector<int>& newParents);
@@ -176,6 +187,10 @@ namespace NCL::Rendering {
 
 		const std::vector<unsigned int>& GetIndexData()			const { return indices;		}
 
+		//Worked out whenever the positions are set, so nothing has to go through every vertex to find them
+		const Vector3& GetBoundsMin() const { return boundsMin; }
+		const Vector3& GetBoundsMax() const { return boundsMax; }
+
 		void SetVertexPositions(const std::vector<Vector3>& newVerts);
 		void SetVertexTextureCoords(const std::vector<Vector2>& newTex);
 
@@ -187,6 +202,16 @@ namespace NCL::Rendering {
 		void SetVertexSkinWeights(const std::vector<Vector4>& newSkinWeights);
 		void SetVertexSkinIndices(const std::vector<Vector4i>& newSkinIndices);
 
+		//Copied straight out of wherever they point, such as a memory mapped file, with nothing in between
+		void SetVertexPositions(std::span<const Vector3> newVerts);
+		void SetVertexTextureCoords(std::span<const Vector2> newTex);
+		void SetVertexColours(std::span<const Vector4> newColours);
+		void SetVertexNormals(std::span<const Vector3> newNorms);
+		void SetVertexTangents(std::span<const Vector4> newTans);
+		void SetVertexIndices(std::span<const unsigned int> newIndices);
+		void SetVertexSkinWeights(std::span<const Vector4> newSkinWeights);
+		void SetVertexSkinIndices(std::span<const Vector4i> newSkinIndices);
+
 		void SetDebugName(const std::string& debugName);
 
 		virtual void UploadToGPU(Rendering::RendererBase* renderer = nullptr) = 0;
@@ -209,6 +234,8 @@ namespace NCL::Rendering {
 		uint32_t					assetID;
 
 		std::vector<Vector3>		positions;
+		Vector3						boundsMin;
+		Vector3						boundsMax;
 		std::vector<Vector2>		texCoords;
 		std::vector<Vector4>		colours;
 		std::vector<Vector3>		normals;
@@ -7,13 +7,285 @@
 #include "Maths.h"
 
 #include "Mesh.h"
+#include "MappedFile.h"
+
+#include <filesystem>
+#include <cstring>
 
 using namespace NCL;
 using namespace Rendering;
 using namespace Maths;
 
+namespace {
+	/*
+	A .mshb is a header, then a table of chunks, then each chunk's data,
+	every one starting on a binaryAlignment boundary. The chunks are the
+	same types as the text format's, but with their data laid out exactly
+	as Mesh keeps it, so once the file's mapped in, each one is a single
+	copy straight into the Mesh. It's all little endian, as it's written
+	straight from memory.
+
+	Names (of joints and sub meshes) are each a uint32_t length, then that
+	many characters, one after the other.
+	*/
+	const char		binaryMagic[4]	= { 'M', 'S', 'H', 'B' };
+	const uint32_t	binaryVersion	= 1;
+	const size_t	binaryAlignment = 16;
+
+	struct BinaryHeader {
+		char		magic[4];
+		uint32_t	version;
+		uint32_t	numMeshes;
+		uint32_t	numVertices;
+		uint32_t	numIndices;
+		uint32_t	numChunks;
+		uint32_t	primitiveType;
+		uint32_t	padding;
+	};
+
+	struct BinaryChunk {
+		uint32_t	type;	//One of MshLoader's GeometryChunkTypes
+		uint32_t	count;	//Elements, not bytes
+		uint64_t	offset;	//From the start of the file
+		uint64_t	size;	//Bytes
+	};
+
+	static_assert(sizeof(Vector2) == 8 && sizeof(Vector3) == 12 && sizeof(Vector4) == 16 && sizeof(Vector4i) == 16, "Vertex data has to be tightly packed to be used straight from a .mshb");
+	static_assert(sizeof(Matrix4) == 64 && sizeof(SubMesh) == 12, "Rig data has to be tightly packed to be used straight from a .mshb");
+
+	size_t AlignUp(size_t offset) {
+		return (offset + binaryAlignment - 1) & ~(binaryAlignment - 1);
+	}
+
+	template<typename T>
+	std::span<const T> ChunkData(const char* file, const BinaryChunk& chunk) {
+		return std::span<const T>((const T*)(file + chunk.offset), chunk.count);
+	}
+
+	template<typename T>
+	std::vector<T> ChunkVector(const char* file, const BinaryChunk& chunk) {
+		std::span<const T> data = ChunkData<T>(file, chunk);
+		return std::vector<T>(data.begin(), data.end());
+	}
+
+	std::vector<std::string> ChunkNames(const char* file, const BinaryChunk& chunk) {
+		std::vector<std::string> names;
+		const char* at	= file + chunk.offset;
+		const char* end = at + chunk.size;
+		for (uint32_t i = 0; i < chunk.count && at + sizeof(uint32_t) <= end; ++i) {
+			uint32_t length = 0;
+			memcpy(&length, at, sizeof(uint32_t));
+			at += sizeof(uint32_t);
+			length = (uint32_t)std::min<size_t>(length, end - at);
+			names.emplace_back(at, length);
+			at += length;
+		}
+		return names;
+	}
+
+	//Builds up the chunk data, with offsets from the start of the data, until it's written out
+	struct BinaryChunkWriter {
+		std::vector<BinaryChunk>	chunks;
+		std::vector<char>			data;
+
+		void Add(uint32_t type, uint32_t count, const void* bytes, size_t size) {
+			if (count == 0) {
+				return;
+			}
+			data.resize(AlignUp(data.size()));
+			chunks.push_back({ type, count, data.size(), size });
+			data.insert(data.end(), (const char*)bytes, (const char*)bytes + size);
+		}
+
+		template<typename T>
+		void Add(uint32_t type, const std::vector<T>& elements) {
+			Add(type, (uint32_t)elements.size(), elements.data(), elements.size() * sizeof(T));
+		}
+
+		void AddNames(uint32_t type, const std::vector<std::string>& names) {
+			std::vector<char> packed;
+			for (const std::string& name : names) {
+				uint32_t length = (uint32_t)name.size();
+				packed.insert(packed.end(), (const char*)&length, (const char*)&length + sizeof(uint32_t));
+				packed.insert(packed.end(), name.begin(), name.end());
+			}
+			Add(type, (uint32_t)names.size(), packed.data(), packed.size());
+		}
+	};
+}
+
 bool MshLoader::LoadMesh(const std::string& filename, Mesh& destinationMesh) {
-	std::ifstream file(Assets::MESHDIR + filename);
+	namespace fs = std::filesystem;
+	std::string textPath	= Assets::MESHDIR + filename;
+	std::string binaryPath	= BinaryMeshPath(textPath);
+
+	std::error_code error;
+	if (fs::exists(binaryPath, error)) {
+		if (fs::exists(textPath, error) && fs::last_write_time(textPath, error) > fs::last_write_time(binaryPath, error)) {
+			std::cout << __FUNCTION__ << " " << binaryPath << " is older than its text mesh, loading the text instead\n";
+		}
+		else if (LoadBinaryMesh(binaryPath, destinationMesh)) {
+			return true;
+		}
+	}
+	return LoadTextMesh(textPath, destinationMesh);
+}
+
+std::string MshLoader::BinaryMeshPath(const std::string& path) {
+	return std::filesystem::path(path).replace_extension(".mshb").string();
+}
+
+bool MshLoader::LoadBinaryMesh(const std::string& path, Mesh& destinationMesh) {
+	MappedFile file(path);
+	if (!file.IsOpen()) {
+		std::cout << __FUNCTION__ << " can't map " << path << "\n";
+		return false;
+	}
+	const char* data = file.GetData();
+	size_t		size = file.GetSize();
+
+	if (size < sizeof(BinaryHeader) || memcmp(data, binaryMagic, sizeof(binaryMagic)) != 0) {
+		std::cout << __FUNCTION__ << " " << path << " is not a binary Mesh file!\n";
+		return false;
+	}
+	const BinaryHeader* header = (const BinaryHeader*)data;
+	if (header->version != binaryVersion) {
+		std::cout << __FUNCTION__ << " " << path << " has incompatible version!\n";
+		return false;
+	}
+	if (sizeof(BinaryHeader) + (size_t)header->numChunks * sizeof(BinaryChunk) > size) {
+		std::cout << __FUNCTION__ << " " << path << " is cut short!\n";
+		return false;
+	}
+	std::span<const BinaryChunk> chunks((const BinaryChunk*)(data + sizeof(BinaryHeader)), header->numChunks);
+
+	//Everything's checked before any of it goes in the Mesh, so a bad file can still fall back on the text.
+	//That includes the header's counts, as a vertex attribute that's the wrong length would read off the end of it
+	uint32_t positionCount	= 0;
+	uint32_t indexCount		= 0;
+	uint32_t subMeshCount	= 0;
+	for (const BinaryChunk& chunk : chunks) {
+		bool badCount = false;
+		switch ((GeometryChunkTypes)chunk.type) {
+			case GeometryChunkTypes::VPositions:		positionCount	= chunk.count; break;
+			case GeometryChunkTypes::Indices:			indexCount		= chunk.count; break;
+			case GeometryChunkTypes::SubMeshes:			subMeshCount	= chunk.count; break;
+			case GeometryChunkTypes::VColors:
+			case GeometryChunkTypes::VNormals:
+			case GeometryChunkTypes::VTangents:
+			case GeometryChunkTypes::VTex0:
+			case GeometryChunkTypes::VWeightValues:
+			case GeometryChunkTypes::VWeightIndices:	badCount = chunk.count != header->numVertices; break;
+			default: break;
+		}
+		if (badCount) {
+			std::cout << __FUNCTION__ << " " << path << " has a vertex attribute that doesn't match its vertex count!\n";
+			return false;
+		}
+
+		size_t elementSize = 0;
+		switch ((GeometryChunkTypes)chunk.type) {
+			case GeometryChunkTypes::VTex0:				elementSize = sizeof(Vector2);		break;
+			case GeometryChunkTypes::VPositions:
+			case GeometryChunkTypes::VNormals:			elementSize = sizeof(Vector3);		break;
+			case GeometryChunkTypes::VColors:
+			case GeometryChunkTypes::VTangents:
+			case GeometryChunkTypes::VWeightValues:		elementSize = sizeof(Vector4);		break;
+			case GeometryChunkTypes::VWeightIndices:	elementSize = sizeof(Vector4i);		break;
+			case GeometryChunkTypes::Indices:			elementSize = sizeof(unsigned int);	break;
+			case GeometryChunkTypes::JointParents:		elementSize = sizeof(int);			break;
+			case GeometryChunkTypes::BindPose:
+			case GeometryChunkTypes::BindPoseInv:		elementSize = sizeof(Matrix4);		break;
+			case GeometryChunkTypes::SubMeshes:			elementSize = sizeof(SubMesh);		break;
+			default: break;	//Names, or anything the loader skips
+		}
+		bool badSize = elementSize && chunk.size != (uint64_t)chunk.count * elementSize;
+		if (chunk.offset % binaryAlignment || chunk.offset > size || chunk.size > size - chunk.offset || badSize) {
+			std::cout << __FUNCTION__ << " " << path << " has a broken chunk table!\n";
+			return false;
+		}
+	}
+	if (positionCount != header->numVertices || indexCount != header->numIndices || subMeshCount != header->numMeshes) {
+		std::cout << __FUNCTION__ << " " << path << " has a header that doesn't match its chunks!\n";
+		return false;
+	}
+
+	for (const BinaryChunk& chunk : chunks) {
+		switch ((GeometryChunkTypes)chunk.type) {
+			case GeometryChunkTypes::VPositions:		destinationMesh.SetVertexPositions(ChunkData<Vector3>(data, chunk));			break;
+			case GeometryChunkTypes::VColors:			destinationMesh.SetVertexColours(ChunkData<Vector4>(data, chunk));			break;
+			case GeometryChunkTypes::VNormals:			destinationMesh.SetVertexNormals(ChunkData<Vector3>(data, chunk));			break;
+			case GeometryChunkTypes::VTangents:			destinationMesh.SetVertexTangents(ChunkData<Vector4>(data, chunk));			break;
+			case GeometryChunkTypes::VTex0:				destinationMesh.SetVertexTextureCoords(ChunkData<Vector2>(data, chunk));		break;
+			case GeometryChunkTypes::Indices:			destinationMesh.SetVertexIndices(ChunkData<unsigned int>(data, chunk));		break;
+			case GeometryChunkTypes::VWeightValues:		destinationMesh.SetVertexSkinWeights(ChunkData<Vector4>(data, chunk));		break;
+			case GeometryChunkTypes::VWeightIndices:	destinationMesh.SetVertexSkinIndices(ChunkData<Vector4i>(data, chunk));		break;
+			case GeometryChunkTypes::JointNames:		destinationMesh.SetJointNames(ChunkNames(data, chunk));						break;
+			case GeometryChunkTypes::JointParents:		destinationMesh.SetJointParents(ChunkVector<int>(data, chunk));				break;
+			case GeometryChunkTypes::BindPose:			destinationMesh.SetBindPose(ChunkVector<Matrix4>(data, chunk));				break;
+			case GeometryChunkTypes::BindPoseInv:		destinationMesh.SetInverseBindPose(ChunkVector<Matrix4>(data, chunk));		break;
+			case GeometryChunkTypes::SubMeshes:			destinationMesh.SetSubMeshes(ChunkVector<SubMesh>(data, chunk));			break;
+			case GeometryChunkTypes::SubMeshNames:		destinationMesh.SetSubMeshNames(ChunkNames(data, chunk));					break;
+			default: break;
+		}
+	}
+
+	if (!destinationMesh.GetBindPose().empty() && destinationMesh.GetInverseBindPose().empty()) {
+		destinationMesh.CalculateInverseBindPose();
+	}
+
+	destinationMesh.SetPrimitiveType((GeometryPrimitive::Type)header->primitiveType);
+
+	return true;
+}
+
+bool MshLoader::WriteBinaryMesh(const std::string& path, const Mesh& mesh) {
+	BinaryChunkWriter writer;
+	writer.Add((uint32_t)GeometryChunkTypes::VPositions,		mesh.GetPositionData());
+	writer.Add((uint32_t)GeometryChunkTypes::VColors,			mesh.GetColourData());
+	writer.Add((uint32_t)GeometryChunkTypes::VNormals,			mesh.GetNormalData());
+	writer.Add((uint32_t)GeometryChunkTypes::VTangents,			mesh.GetTangentData());
+	writer.Add((uint32_t)GeometryChunkTypes::VTex0,				mesh.GetTextureCoordData());
+	writer.Add((uint32_t)GeometryChunkTypes::Indices,			mesh.GetIndexData());
+	writer.Add((uint32_t)GeometryChunkTypes::VWeightValues,		mesh.GetSkinWeightData());
+	writer.Add((uint32_t)GeometryChunkTypes::VWeightIndices,	mesh.GetSkinIndexData());
+	writer.AddNames((uint32_t)GeometryChunkTypes::JointNames,	mesh.GetJointNames());
+	writer.Add((uint32_t)GeometryChunkTypes::JointParents,		mesh.GetJointParents());
+	writer.Add((uint32_t)GeometryChunkTypes::BindPose,			mesh.GetBindPose());
+	writer.Add((uint32_t)GeometryChunkTypes::BindPoseInv,		mesh.GetInverseBindPose());
+	writer.Add((uint32_t)GeometryChunkTypes::SubMeshes,			mesh.GetSubMeshes());
+	writer.AddNames((uint32_t)GeometryChunkTypes::SubMeshNames,	mesh.GetSubMeshNames());
+
+	BinaryHeader header = {};
+	memcpy(header.magic, binaryMagic, sizeof(binaryMagic));
+	header.version			= binaryVersion;
+	header.numMeshes		= (uint32_t)mesh.GetSubMeshCount();
+	header.numVertices		= (uint32_t)mesh.GetVertexCount();
+	header.numIndices		= (uint32_t)mesh.GetIndexCount();
+	header.numChunks		= (uint32_t)writer.chunks.size();
+	header.primitiveType	= mesh.GetPrimitiveType();
+
+	size_t tableEnd		= sizeof(BinaryHeader) + writer.chunks.size() * sizeof(BinaryChunk);
+	size_t dataStart	= AlignUp(tableEnd);
+	for (BinaryChunk& chunk : writer.chunks) {
+		chunk.offset += dataStart;
+	}
+
+	std::ofstream file(path, std::ios::out | std::ios::binary);
+	if (!file) {
+		std::cout << __FUNCTION__ << " can't open " << path << " for writing!\n";
+		return false;
+	}
+	const char padding[binaryAlignment] = {};
+	file.write((const char*)&header, sizeof(BinaryHeader));
+	file.write((const char*)writer.chunks.data(), writer.chunks.size() * sizeof(BinaryChunk));
+	file.write(padding, dataStart - tableEnd);
+	file.write(writer.data.data(), writer.data.size());
+	return (bool)file;
+}
+
+bool MshLoader::LoadTextMesh(const std::string& path, Mesh& destinationMesh) {
+	std::ifstream file(path);
 
 	std::string filetype;
 	int fileVersion;
@@ -43,8 +43,21 @@ namespace NCL::Rendering {
 	};
 
 	public:		
+		/*
+		Loads filename from the mesh folder - from its binary .mshb, if
+		there is one at least as new as the text .msh, or else from the
+		text itself.
+		*/
 		static bool LoadMesh(const std::string& filename, Mesh& destinationMesh);
 
+		//These take whole paths, rather than names in the mesh folder
+		static bool LoadTextMesh(const std::string& path, Mesh& destinationMesh);
+		static bool LoadBinaryMesh(const std::string& path, Mesh& destinationMesh);
+		static bool WriteBinaryMesh(const std::string& path, const Mesh& mesh);
+
+		//Where the binary version of a .msh goes - the same place, with .mshb on the end instead
+		static std::string BinaryMeshPath(const std::string& path);
+
 	protected:
 		static void* ReadVertexData(GeometryChunkData dataType, GeometryChunkTypes chunkType, int numVertices);
 		static void ReadTextInts(std::ifstream& file, vector<Maths::Vector2i>& element, int numVertices);
@@ -0,0 +1,256 @@
+#include "Profiler.h"
+#include <mutex>
+#include <unordered_map>
+#include <string_view>
+#include <iomanip>
+#include <cmath>
+
+using namespace NCL;
+
+std::atomic<bool>				Profiler::enabled = true;
+thread_local ProfileZone*		ProfileZone::current = nullptr;
+
+namespace {
+	/*
+	Single producer, single consumer - only the thread that owns the ring
+	ever moves head, and only EndFrame ever moves tail, so neither side has
+	to lock. Both keep counting up forever, and get wrapped on the way in.
+	*/
+	struct ThreadRing {
+		std::vector<Profiler::ZoneEvent>	zones;
+		std::atomic<uint64_t>				head	= 0;
+		std::atomic<uint64_t>				tail	= 0;
+		std::atomic<uint64_t>				dropped	= 0;
+		uint32_t							threadID;
+
+		ThreadRing(uint32_t id) : zones(Profiler::ringSize), threadID(id) {}
+	};
+
+	//Every frame a zone name ran in, oldest overwritten first
+	struct ZoneHistory {
+		std::vector<float>	totalMS;
+		std::vector<float>	selfMS;
+		size_t				next		= 0;
+
+		uint64_t			frameTotal	= 0;	//So far this frame, in nanoseconds
+		uint64_t			frameSelf	= 0;
+		uint32_t			frameCalls	= 0;
+
+		uint32_t			lastCalls	= 0;
+		uint32_t			depth		= 0;
+	};
+
+	struct TraceZone {
+		Profiler::ZoneEvent	zone;
+		uint32_t			threadID;
+	};
+
+	std::mutex								ringMutex;	//Guards the list of rings, never what goes into them
+	std::vector<std::unique_ptr<ThreadRing>>	rings;
+	thread_local ThreadRing*				threadRing = nullptr;
+
+	//Everything below is only touched by whichever thread calls EndFrame
+	std::unordered_map<std::string_view, ZoneHistory>	histories;
+	uint64_t				frameCount			= 0;
+	std::vector<TraceZone>	trace;
+	int						captureFramesLeft	= 0;
+	std::string				captureFile;
+
+	ThreadRing* GetThreadRing() {
+		if (!threadRing) {
+			std::lock_guard<std::mutex> lock(ringMutex);
+			rings.push_back(std::make_unique<ThreadRing>((uint32_t)rings.size()));
+			threadRing = rings.back().get();
+		}
+		return threadRing;
+	}
+
+	float ToMS(uint64_t nanoseconds) {
+		return nanoseconds / 1000000.0f;
+	}
+
+	//Nearest rank, out of an already sorted list
+	float Percentile(const std::vector<float>& sorted, float p) {
+		size_t rank = (size_t)std::ceil(p * sorted.size());
+		return sorted[std::clamp(rank, (size_t)1, sorted.size()) - 1];
+	}
+
+	void WriteJSONString(std::ostream& out, const char* text) {
+		out << '"';
+		for (const char* c = text; *c; ++c) {
+			if (*c == '"' || *c == '\\') {
+				out << '\\';
+			}
+			out << *c;
+		}
+		out << '"';
+	}
+}
+
+void Profiler::Record(const ZoneEvent& zone) {
+	ThreadRing* ring = GetThreadRing();
+	uint64_t head = ring->head.load(std::memory_order_relaxed);
+	if (head - ring->tail.load(std::memory_order_acquire) >= ringSize) {
+		ring->dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	ring->zones[head & (ringSize - 1)] = zone;
+	ring->head.store(head + 1, std::memory_order_release);
+}
+
+void Profiler::EndFrame() {
+	bool capturing = captureFramesLeft > 0;
+	{
+		std::lock_guard<std::mutex> lock(ringMutex);
+		for (auto& ring : rings) {
+			uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+			uint64_t head = ring->head.load(std::memory_order_acquire);
+			for (; tail < head; ++tail) {
+				const ZoneEvent& zone = ring->zones[tail & (ringSize - 1)];
+				ZoneHistory& h = histories[zone.name];
+				h.frameTotal	+= zone.duration;
+				h.frameSelf		+= zone.duration - std::min(zone.childTime, zone.duration);
+				h.frameCalls++;
+				h.depth = zone.depth;
+				if (capturing) {
+					trace.push_back({ zone, ring->threadID });
+				}
+			}
+			ring->tail.store(head, std::memory_order_release);
+		}
+	}
+
+	for (auto& [name, h] : histories) {
+		if (h.frameCalls == 0) {
+			continue;
+		}
+		if (h.totalMS.size() < (size_t)historyFrames) {
+			h.totalMS.push_back(ToMS(h.frameTotal));
+			h.selfMS.push_back(ToMS(h.frameSelf));
+		}
+		else {
+			h.totalMS[h.next]	= ToMS(h.frameTotal);
+			h.selfMS[h.next]	= ToMS(h.frameSelf);
+		}
+		h.next			= (h.next + 1) % historyFrames;
+		h.lastCalls		= h.frameCalls;
+		h.frameTotal	= 0;
+		h.frameSelf		= 0;
+		h.frameCalls	= 0;
+	}
+	frameCount++;
+
+	if (capturing && --captureFramesLeft == 0) {
+		if (WriteChromeTrace(captureFile)) {
+			std::cout << "Profiler: wrote " << trace.size() << " zones to " << captureFile << std::endl;
+		}
+		trace.clear();
+	}
+}
+
+uint64_t Profiler::GetFrameCount() {
+	return frameCount;
+}
+
+std::vector<Profiler::ZoneStats> Profiler::GetStats() {
+	std::vector<ZoneStats> stats;
+	std::vector<float> sorted;
+	for (const auto& [name, h] : histories) {
+		if (h.totalMS.empty()) {
+			continue;
+		}
+		ZoneStats s;
+		s.name		= std::string(name);
+		s.depth		= h.depth;
+		s.calls		= h.lastCalls;
+		s.frames	= (int)h.totalMS.size();
+		s.lastMS	= h.totalMS[(h.next + h.totalMS.size() - 1) % h.totalMS.size()];
+
+		sorted = h.totalMS;
+		std::sort(sorted.begin(), sorted.end());
+		float total = 0.0f;
+		for (float ms : sorted) {
+			total += ms;
+		}
+		float self = 0.0f;
+		for (float ms : h.selfMS) {
+			self += ms;
+		}
+		s.minMS		= sorted.front();
+		s.avgMS		= total / sorted.size();
+		s.p95MS		= Percentile(sorted, 0.95f);
+		s.p99MS		= Percentile(sorted, 0.99f);
+		s.selfAvgMS = self / sorted.size();
+		stats.push_back(s);
+	}
+	std::sort(stats.begin(), stats.end(), [](const ZoneStats& a, const ZoneStats& b) {
+		return a.avgMS > b.avgMS;
+	});
+	return stats;
+}
+
+void Profiler::PrintStats(std::ostream& out) {
+	out << "-------Profiler (" << frameCount << " frames, " << GetDroppedZones() << " zones dropped)--------" << std::endl;
+	out << std::left << std::setw(28) << "Zone" << std::right
+		<< std::setw(6) << "Depth" << std::setw(7) << "Calls"
+		<< std::setw(9) << "Last" << std::setw(9) << "Min" << std::setw(9) << "Avg"
+		<< std::setw(9) << "P95" << std::setw(9) << "P99" << std::setw(9) << "Self" << std::endl;
+
+	out << std::fixed << std::setprecision(3);
+	for (const ZoneStats& s : GetStats()) {
+		out << std::left << std::setw(28) << s.name << std::right
+			<< std::setw(6) << s.depth << std::setw(7) << s.calls
+			<< std::setw(9) << s.lastMS << std::setw(9) << s.minMS << std::setw(9) << s.avgMS
+			<< std::setw(9) << s.p95MS << std::setw(9) << s.p99MS << std::setw(9) << s.selfAvgMS << std::endl;
+	}
+	out << std::defaultfloat;
+}
+
+uint64_t Profiler::GetDroppedZones() {
+	std::lock_guard<std::mutex> lock(ringMutex);
+	uint64_t dropped = 0;
+	for (auto& ring : rings) {
+		dropped += ring->dropped.load(std::memory_order_relaxed);
+	}
+	return dropped;
+}
+
+void Profiler::CaptureFrames(int frameCount, const std::string& filename) {
+	trace.clear();
+	captureFramesLeft	= std::max(frameCount, 1);
+	captureFile			= filename;
+}
+
+bool Profiler::IsCapturing() {
+	return captureFramesLeft > 0;
+}
+
+/*
+Complete ("X") events, with timestamps in microseconds from the first
+zone captured, and one row per thread.
+*/
+bool Profiler::WriteChromeTrace(const std::string& filename) {
+	std::ofstream file(filename);
+	if (!file) {
+		std::cout << __FUNCTION__ << ": Can't open " << filename << " for writing!" << std::endl;
+		return false;
+	}
+	uint64_t origin = trace.empty() ? 0 : trace.front().zone.start;
+	for (const TraceZone& t : trace) {
+		origin = std::min(origin, t.zone.start);
+	}
+
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	file << std::fixed << std::setprecision(3);
+	for (size_t i = 0; i < trace.size(); ++i) {
+		const TraceZone& t = trace[i];
+		file << "{\"name\":";
+		WriteJSONString(file, t.zone.name);
+		file << ",\"cat\":\"zone\",\"ph\":\"X\",\"pid\":0,\"tid\":" << t.threadID
+			<< ",\"ts\":" << (t.zone.start - origin) / 1000.0
+			<< ",\"dur\":" << t.zone.duration / 1000.0 << "}"
+			<< (i + 1 < trace.size() ? ",\n" : "\n");
+	}
+	file << "]}\n";
+	return true;
+}
@@ -0,0 +1,146 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+
+namespace NCL {
+	/*
+	Times named zones of code, from any thread, with PROFILE_SCOPE:
+
+		void PhysicsSystem::BroadPhase() {
+			PROFILE_SCOPE("BroadPhase");
+			...
+		}
+
+	A zone runs until the end of the scope it was made in, and zones made
+	inside another zone are nested in it. Finished zones go into a ring
+	buffer belonging to the thread that ran them, so recording one never
+	takes a lock - only the first zone on a new thread does, to hand the
+	profiler its ring. If a ring fills up before EndFrame empties it, the
+	zones that don't fit are dropped and counted, rather than waiting.
+
+	EndFrame gathers every thread's zones up, once a frame. Each zone name
+	gets its total time (and the time spent outside its nested zones) for
+	every frame it was in, and GetStats turns the last historyFrames of
+	those into min / avg / p95 / p99.
+
+	CaptureFrames keeps every zone of the next few frames, and writes them
+	out as a Chrome trace (the JSON chrome://tracing and Perfetto read).
+
+	Zone names have to outlive the profiler - string literals, in practice.
+	*/
+	class Profiler {
+	public:
+		//One run of one zone - times are in nanoseconds, on the steady clock
+		struct ZoneEvent {
+			const char*	name;
+			uint64_t	start;
+			uint64_t	duration;
+			uint64_t	childTime;	//Spent in the zones nested inside this one
+			uint32_t	depth;		//0 for a zone with nothing around it
+		};
+
+		//One zone name's frames, from the last historyFrames that it ran in
+		struct ZoneStats {
+			std::string	name;
+			uint32_t	depth		= 0;	//As of the last time it ran
+			uint32_t	calls		= 0;	//Last frame it ran in
+			int			frames		= 0;
+			float		lastMS		= 0.0f;
+			float		minMS		= 0.0f;
+			float		avgMS		= 0.0f;
+			float		p95MS		= 0.0f;
+			float		p99MS		= 0.0f;
+			float		selfAvgMS	= 0.0f;	//Not counting its nested zones
+		};
+
+		static const int	historyFrames	= 300;
+		static const size_t	ringSize		= 1 << 14;	//Zones per thread between EndFrames
+
+		static uint64_t Now() {
+			return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		//A disabled profiler doesn't record any new zones, though any already running still finish
+		static void SetEnabled(bool state) {
+			enabled.store(state, std::memory_order_relaxed);
+		}
+
+		static bool IsEnabled() {
+			return enabled.load(std::memory_order_relaxed);
+		}
+
+		//Call once a frame, from one thread, outside of any zone
+		static void EndFrame();
+
+		static uint64_t GetFrameCount();
+
+		//Slowest on average first
+		static std::vector<ZoneStats> GetStats();
+
+		static void PrintStats(std::ostream& out);
+
+		//Zones that didn't fit in their thread's ring, ever
+		static uint64_t GetDroppedZones();
+
+		//Keeps every zone from the next frameCount frames, then writes them to filename as a Chrome trace
+		static void CaptureFrames(int frameCount, const std::string& filename);
+
+		static bool IsCapturing();
+
+		static bool WriteChromeTrace(const std::string& filename);
+
+		//Only for ProfileZone
+		static void Record(const ZoneEvent& zone);
+
+	protected:
+		static std::atomic<bool> enabled;
+	};
+
+	class ProfileZone {
+	public:
+		ProfileZone(const char* zoneName) {
+			if (!Profiler::IsEnabled()) {
+				return;
+			}
+			name	= zoneName;
+			parent	= current;
+			depth	= parent ? parent->depth + 1 : 0;
+			current = this;
+			start	= Profiler::Now();
+		}
+
+		~ProfileZone() {
+			if (!name) {
+				return;
+			}
+			uint64_t duration = Profiler::Now() - start;
+			current = parent;
+			if (parent) {
+				parent->childTime += duration;
+			}
+			Profiler::Record({ name, start, duration, childTime, depth });
+		}
+
+		ProfileZone(const ProfileZone&) = delete;
+		ProfileZone& operator=(const ProfileZone&) = delete;
+
+	protected:
+		const char*		name		= nullptr;
+		ProfileZone*	parent		= nullptr;
+		uint64_t		start		= 0;
+		uint64_t		childTime	= 0;
+		uint32_t		depth		= 0;
+
+		static thread_local ProfileZone* current;
+	};
+}
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+//Defining NCL_NO_PROFILING compiles every zone out completely
+#ifdef NCL_NO_PROFILING
+#define PROFILE_SCOPE(name)
+#else
+#define PROFILE_SCOPE(name) NCL::ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#endif
@@ -8,6 +8,7 @@ https://research.ncl.ac.uk/game/
 */
 #pragma once
 #include "Window.h"
+#include "Profiler.h"
 
 namespace NCL::Rendering {
 	enum class VerticalSyncState {
@@ -30,6 +31,7 @@ namespace NCL::Rendering {
 		std::chrono::steady_clock::time_point previousTime;
 
 		void Render(float dt) {
+			PROFILE_SCOPE("Renderer::Render");
 
 			auto currentTime = clock::now();
 			std::chrono::duration<float> elapsedTime = currentTime - previousTime;
@@ -45,6 +47,9 @@ namespace NCL::Rendering {
 			BeginFrame();
 			RenderFrame(dt);
 			EndFrame();
+
+			//With vsync on, this is where any time left over in the frame goes
+			PROFILE_SCOPE("Renderer::SwapBuffers");
 			SwapBuffers();
 		}
 
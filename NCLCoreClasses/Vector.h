@@ -327,5 +327,23 @@ namespace NCL::Maths {
             }
             return output;
         }
+
+        template <typename T, uint32_t n>
+        constexpr VectorTemplate<T, n>        Min(const VectorTemplate<T, n>& a, const VectorTemplate<T, n>& b) {
+            VectorTemplate<T, n> output;
+            for (int i = 0; i < n; ++i) {
+                output.array[i] = std::min(a.array[i], b.array[i]);
+            }
+            return output;
+        }
+
+        template <typename T, uint32_t n>
+        constexpr VectorTemplate<T, n>        Max(const VectorTemplate<T, n>& a, const VectorTemplate<T, n>& b) {
+            VectorTemplate<T, n> output;
+            for (int i = 0; i < n; ++i) {
+                output.array[i] = std::max(a.array[i], b.array[i]);
+            }
+            return output;
+        }
     }
 }
\ No newline at end of file
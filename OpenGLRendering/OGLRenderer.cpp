@@ -167,7 +167,7 @@ void OGLRenderer::BindTextureToShader(const OGLTexture& t, const std::string& un
 		return;//Debug message time!
 	}
 	
-	GLuint slot = glGetUniformLocation(activeShader->GetProgramID(), uniform.c_str());
+	GLint slot = activeShader->GetUniformLocation(uniform);
 
 	if (slot < 0) {
 
@@ -7,6 +7,7 @@ License: MIT (see LICENSE file at the top of the source tree)
 */////////////////////////////////////////////////////////////////////////////
 #include "OGLShader.h"
 #include "Assets.h"
+#include <algorithm>
 
 using namespace NCL;
 using namespace NCL::Rendering;
@@ -23,6 +24,8 @@ GLuint shaderTypes[(int)ShaderStages::MAX_SIZE] = {
 
 };
 
+std::map<std::string, GLuint> OGLShader::uniformBlockBindings;
+
 string shaderNames[(int)ShaderStages::MAX_SIZE] = {
 	"Vertex",
 	"Fragment",
@@ -88,7 +91,71 @@ void OGLShader::ReloadShader() {
 	}
 	else {
 		std::cout << "Shader loaded!" << "\n";
+		ReflectUniforms();
+	}
+}
+
+void	OGLShader::ReflectUniforms() {
+	uniformLocations.clear();
+
+	GLint uniformCount	= 0;
+	GLint maxNameLength	= 0;
+	glGetProgramiv(programID, GL_ACTIVE_UNIFORMS, &uniformCount);
+	glGetProgramiv(programID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+	std::string name(std::max(maxNameLength, 1), ' ');
+	for (GLint i = 0; i < uniformCount; ++i) {
+		GLsizei length	= 0;
+		GLint	size	= 0;
+		GLenum	type	= 0;
+		glGetActiveUniform(programID, i, (GLsizei)name.size(), &length, &size, &type, name.data());
+
+		std::string uniformName = name.substr(0, length);
+		GLint location = glGetUniformLocation(programID, uniformName.c_str());
+		if (location < 0) {
+			continue; //Uniform block members don't have locations of their own
+		}
+		uniformLocations.emplace_back(uniformName, location);
+
+		size_t arrayStart = uniformName.rfind("[0]");
+		if (arrayStart != string::npos && arrayStart + 3 == uniformName.size()) {
+			uniformLocations.emplace_back(uniformName.substr(0, arrayStart), location);
+		}
 	}
+	std::sort(uniformLocations.begin(), uniformLocations.end());
+
+	GLint blockCount = 0;
+	glGetProgramiv(programID, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
+	for (GLint i = 0; i < blockCount; ++i) {
+		GLint nameLength = 0;
+		glGetActiveUniformBlockiv(programID, i, GL_UNIFORM_BLOCK_NAME_LENGTH, &nameLength);
+
+		std::string blockName(std::max(nameLength, 1), ' ');
+		GLsizei length = 0;
+		glGetActiveUniformBlockName(programID, i, (GLsizei)blockName.size(), &length, blockName.data());
+		blockName.resize(length);
+
+		auto binding = uniformBlockBindings.find(blockName);
+		if (binding != uniformBlockBindings.end()) {
+			glUniformBlockBinding(programID, i, binding->second);
+		}
+	}
+}
+
+GLint	OGLShader::GetUniformLocation(std::string_view name) const {
+	auto i = std::lower_bound(uniformLocations.begin(), uniformLocations.end(), name,
+		[](const std::pair<std::string, GLint>& a, std::string_view b) {
+			return std::string_view(a.first) < b;
+		}
+	);
+	if (i == uniformLocations.end() || i->first != name) {
+		return -1;
+	}
+	return i->second;
+}
+
+void	OGLShader::SetUniformBlockBinding(const std::string& blockName, GLuint binding) {
+	uniformBlockBindings[blockName] = binding;
 }
 
 void	OGLShader::DeleteIDs() {
@@ -103,6 +170,7 @@ void	OGLShader::DeleteIDs() {
 	}
 	glDeleteProgram(programID);
 	programID = 0;
+	uniformLocations.clear();
 }
 
 void	OGLShader::PrintCompileLog(GLuint object) {
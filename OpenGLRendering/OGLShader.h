@@ -8,6 +8,8 @@ License: MIT (see LICENSE file at the top of the source tree)
 #pragma once
 #include "Shader.h"
 #include "glad\gl.h"
+#include <map>
+#include <string_view>
 
 namespace NCL::Rendering {
 	using UniqueOGLShader = std::unique_ptr<class OGLShader>;
@@ -27,14 +29,36 @@ namespace NCL::Rendering {
 		int GetProgramID() const {
 			return programID;
 		}	
+
+		/*
+		Every active uniform's location is looked up once, when the program
+		links, so this never has to go to the driver - it's -1 for anything
+		the program doesn't have, just like glGetUniformLocation. Arrays can
+		be found with or without their [0].
+		*/
+		GLint GetUniformLocation(std::string_view name) const;
 			
 		static void	PrintCompileLog(GLuint object);
 		static void	PrintLinkLog(GLuint program);
 
 		static bool Preprocessor(std::string& shaderFile);
 
+		/*
+		Any program with a uniform block of this name gets it pointed at the
+		given binding when it links, so blocks can be shared between shaders
+		without each one needing GLSL 4.2's layout(binding). Only affects
+		shaders that are loaded (or reloaded) afterwards.
+		*/
+		static void SetUniformBlockBinding(const std::string& blockName, GLuint binding);
+
 	protected:
 		void	DeleteIDs();
+		void	ReflectUniforms();
+
+		//Sorted by name
+		std::vector<std::pair<std::string, GLint>> uniformLocations;
+
+		static std::map<std::string, GLuint> uniformBlockBindings;
 
 		GLuint	programID;
 		GLuint	shaderIDs[(int)ShaderStages::MAX_SIZE];